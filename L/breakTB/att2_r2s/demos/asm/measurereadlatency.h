@@ -10,6 +10,7 @@
 #ifndef DEMOS_ASM_MEASUREREADLATENCY_H_
 #define DEMOS_ASM_MEASUREREADLATENCY_H_
 
+#include <cstddef>
 #include <cstdint>
 
 // Reads a byte from *address and returns a measure of how long it took by
@@ -25,4 +26,14 @@
 // measuring the read.
 extern "C" uint64_t MeasureReadLatency(const void* address);
 
+// Measures the read latency of `count` addresses, in order, and stores the
+// latency of addresses[i] to latencies[i].
+//
+// Each read is timed with exactly the same instruction sequence as in
+// MeasureReadLatency, so results are directly comparable. Batching only saves
+// the call, return and argument setup between reads, which otherwise make up
+// a noticeable part of a full probe pass.
+extern "C" void MeasureReadLatencyBatch(const void* const* addresses,
+                                        uint64_t* latencies, size_t count);
+
 #endif  // DEMOS_ASM_MEASUREREADLATENCY_H_
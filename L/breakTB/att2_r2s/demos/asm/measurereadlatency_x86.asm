@@ -38,4 +38,43 @@ _MeasureReadLatency:
   pop ebp
   ret
 
+; See measurereadlatency_x86.S for the commented and formatted version.
+public _MeasureReadLatencyBatch
+_MeasureReadLatencyBatch:
+  push ebp
+  mov ebp, esp
+  push ebx
+  push esi
+  push edi
+  mov ecx, dword ptr [ebp+16]
+  test ecx, ecx
+  jz MeasureReadLatencyBatchDone
+MeasureReadLatencyBatchLoop:
+  mov ebx, dword ptr [ebp+8]
+  mov ebx, dword ptr [ebx]
+  mfence
+  lfence
+  rdtsc
+  mov edi, eax
+  mov esi, edx
+  lfence
+  mov al, byte ptr [ebx]
+  lfence
+  rdtsc
+  sub eax, edi
+  sbb edx, esi
+  mov ebx, dword ptr [ebp+12]
+  mov dword ptr [ebx], eax
+  mov dword ptr [ebx+4], edx
+  add dword ptr [ebp+8], 4
+  add dword ptr [ebp+12], 8
+  dec ecx
+  jnz MeasureReadLatencyBatchLoop
+MeasureReadLatencyBatchDone:
+  pop edi
+  pop esi
+  pop ebx
+  pop ebp
+  ret
+
 end
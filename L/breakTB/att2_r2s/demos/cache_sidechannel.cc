@@ -7,47 +7,40 @@
  * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
  */
 
-#include <list>
-#include <vector>
-
 #include "asm/measurereadlatency.h"
 #include "cache_sidechannel.h"
 #include "instr.h"
+#include "trace.h"
 #include "utils.h"
 
-// Returns the indices of the biggest and second-biggest values in the range.
-template <typename RangeT>
-static std::pair<size_t, size_t> TwoTwoIndices(const RangeT &range) {
-  std::pair<size_t, size_t> result = {256, 256};  // first and second biggest
-  for (size_t i = 0; i < range.size(); ++i) {
-    if (range[i] > range[result.first]) {
-      result.second = result.first;
-      result.first = i;
-    } else if (range[i] > range[result.second]) {
-      result.second = i;
-    }
+template <typename OracleEntry>
+BasicCacheSideChannel<OracleEntry>::BasicCacheSideChannel() {
+  for (size_t i = 0; i < 256; ++i) {
+    probe_addresses_[i] = &GetOracle()[MixedIndex(i)];
   }
-  return result;
 }
 
-const std::array<BigByte, 256> &CacheSideChannel::GetOracle() const {
+template <typename OracleEntry>
+const std::array<OracleEntry, 256> &
+BasicCacheSideChannel<OracleEntry>::GetOracle() const {
   return padded_oracle_array_->oracles_;
 }
 
-void CacheSideChannel::FlushOracle() const {
+template <typename OracleEntry>
+void BasicCacheSideChannel<OracleEntry>::FlushOracle() const {
+  SAFESIDE_TRACE_SPAN(TracePhase::kFlush);
   // Flush out entries from the timing array. Now, if they are loaded during
   // speculative execution, that will warm the cache for that entry, which
   // can be detected later via timing analysis.
-  for (BigByte &b : padded_oracle_array_->oracles_) {
-    FlushDataCacheLineNoBarrier(&b);
-  }
-  MemoryAndSpeculationBarrier();
+  // The flushes go out in probing order as one batch with a single barrier.
+  FlushLines(probe_addresses_);
 }
 
-std::pair<bool, char> CacheSideChannel::RecomputeScores(
+template <typename OracleEntry>
+std::pair<bool, char> BasicCacheSideChannel<OracleEntry>::RecomputeScores(
     char safe_offset_char) {
+  ++runs_;
   std::array<uint64_t, 256> latencies = {};
-  size_t best_val = 0, runner_up_val = 0;
 
   // Here's the timing side channel: find which char was loaded by measuring
   // latency. Indexing into oracle causes the relevant region of
@@ -58,24 +51,34 @@ std::pair<bool, char> CacheSideChannel::RecomputeScores(
   // Note: if the character at safe_offset_char is the same as the character we
   // want to know at i, the data from this run will be useless, but later runs
   // will use a different safe_offset_char.
+  //
+  // With the native timer, the whole pass is a single call into the batched
+  // kernel. Either way, the entries are visited in the pseudo-random probing
+  // order and the latencies are put back in character order afterwards.
+  std::array<uint64_t, 256> probe_latencies;
+  {
+    SAFESIDE_TRACE_SPAN(TracePhase::kMeasure);
+    if (timer_ == &NativeTimerBackend()) {
+      MeasureReadLatencyBatch(probe_addresses_.data(), probe_latencies.data(),
+                              256);
+    } else {
+      for (size_t i = 0; i < 256; ++i) {
+        probe_latencies[i] = timer_->MeasureReadLatency(probe_addresses_[i]);
+      }
+    }
+  }
+
+  SAFESIDE_TRACE_SPAN(TracePhase::kScore);
   for (size_t i = 0; i < 256; ++i) {
-    // Some CPUs (e.g. AMD Ryzen 5 PRO 2400G) prefetch cache lines, rendering
-    // them all equally fast. Therefore it is necessary to confuse them by
-    // accessing the offsets in a pseudo-random order.
-    size_t mixed_i = ((i * 167) + 13) & 0xFF;
-    latencies[mixed_i] = MeasureReadLatency(&GetOracle()[mixed_i]);
+    latencies[MixedIndex(i)] = probe_latencies[i];
   }
 
-  std::list<uint64_t> sorted_latencies_list(latencies.begin(), latencies.end());
-  // We have to use the std::list::sort implementation, because invocations of
+  // The default scorer sorts with std::list::sort, because invocations of
   // std::sort, std::stable_sort, std::nth_element and std::partial_sort when
   // compiled with optimizations intervene with the neural network based AMD
   // memory disambiguation dynamic predictor and the Spectre v4 example fails
-  // on AMD Ryzen 5 PRO 2400G.
-  sorted_latencies_list.sort();
-  std::vector<uint64_t> sorted_latencies(sorted_latencies_list.begin(),
-                                         sorted_latencies_list.end());
-  uint64_t median_latency = sorted_latencies[128];
+  // on AMD Ryzen 5 PRO 2400G. See scorer.h for the other engines.
+  uint64_t median_latency = scorer_->MedianLatency(latencies);
 
   // The difference between a cache-hit and cache-miss times is significantly
   // different across platforms. Therefore we must first compute its estimate
@@ -102,15 +105,27 @@ std::pair<bool, char> CacheSideChannel::RecomputeScores(
     }
   }
 
-  std::tie(best_val, runner_up_val) = TwoTwoIndices(scores_);
-  return std::make_pair((scores_[best_val] > 2 * scores_[runner_up_val] + 40),
-                        best_val);
+  Verdict verdict = decision_rule_.Evaluate(scores_);
+  confidence_ = verdict.confidence;
+  return std::make_pair(verdict.converged, verdict.value);
 }
 
-std::pair<bool, char> CacheSideChannel::AddHitAndRecomputeScores() {
+template <typename OracleEntry>
+std::pair<bool, char>
+BasicCacheSideChannel<OracleEntry>::AddHitAndRecomputeScores() {
   static size_t additional_offset_counter = 0;
-  size_t mixed_i = ((additional_offset_counter * 167) + 13) & 0xFF;
+  size_t mixed_i = MixedIndex(additional_offset_counter);
   ForceRead(GetOracle().data() + mixed_i);
   additional_offset_counter = (additional_offset_counter + 1) % 256;
   return RecomputeScores(static_cast<char>(mixed_i));
 }
+
+template <typename OracleEntry>
+void BasicCacheSideChannel<OracleEntry>::ResetScores() {
+  scores_.fill(0);
+  confidence_ = 0;
+  runs_ = 0;
+}
+
+template class BasicCacheSideChannel<BigByte>;
+template class BasicCacheSideChannel<ColoredBigByte>;
@@ -12,6 +12,13 @@
 
 #include <array>
 #include <memory>
+#include <utility>
+
+#include "decision_rule.h"
+#include "hardware_constants.h"
+#include "oracle_pool.h"
+#include "scorer.h"
+#include "timer_backend.h"
 
 // Represents a cache-line in the oracle for each possible ASCII code.
 // We can use this for a timing attack: if the CPU has loaded a given cache
@@ -47,16 +54,30 @@ struct BigByte {
   std::array<unsigned char, 4096> padding_ = {};
 };
 
+// BigByte puts every oracle entry at offset 0 of its own page, so all 256
+// entries map to the same L1 cache set and evict each other while the oracle
+// is probed. ColoredBigByte adds one cache line to the stride, the same trick
+// TimingArray::Element uses: entries still never share a page, but
+// consecutive entries fall into consecutive cache sets.
+struct ColoredBigByte {
+  // Initialized for the same reason as BigByte::padding_.
+  std::array<unsigned char, sizeof(BigByte) + kCacheLineBytes> padding_ = {};
+};
+
 // The first and last value might be adjacent to other elements on the heap,
 // so we only add padding from both side and use only the other elements, which
 // are guaranteed to be on different cache lines, and even different pages,
 // than any other value.
-struct PaddedOracleArray {
-  BigByte pad_left;
-  std::array<BigByte, 256> oracles_;
-  BigByte pad_right;
+template <typename OracleEntry>
+struct BasicPaddedOracleArray {
+  OracleEntry pad_left;
+  std::array<OracleEntry, 256> oracles_;
+  OracleEntry pad_right;
 };
 
+using PaddedOracleArray = BasicPaddedOracleArray<BigByte>;
+using ColoredPaddedOracleArray = BasicPaddedOracleArray<ColoredBigByte>;
+
 // Provides an oracle of allocated memory indexed by 256 character ASCII
 // codes in order to capture speculative cache loads.
 //
@@ -72,33 +93,92 @@ struct PaddedOracleArray {
 // client and recomputation of scores) repeats until one of the characters
 // accumulates a high enough score.
 //
-class CacheSideChannel {
+// To leak several bytes, keep one instance and call ResetScores() before each
+// byte. The oracle comes from OraclePool, so it is already faulted in.
+//
+// `OracleEntry` selects the memory layout of the oracle, see BigByte and
+// ColoredBigByte. In both layouts the entry for character `c` is at
+// `GetOracle().data() + c`; only the stride differs. Flushing and probing
+// visit the entries in a pseudo-random order (see MixedIndex).
+//
+// The implementation is explicitly instantiated for BigByte and
+// ColoredBigByte in cache_sidechannel.cc.
+template <typename OracleEntry>
+class BasicCacheSideChannel {
  public:
-  CacheSideChannel() = default;
+  BasicCacheSideChannel();
 
   // Not copyable or movable.
-  CacheSideChannel(const CacheSideChannel&) = delete;
-  CacheSideChannel& operator=(const CacheSideChannel&) = delete;
+  BasicCacheSideChannel(const BasicCacheSideChannel&) = delete;
+  BasicCacheSideChannel& operator=(const BasicCacheSideChannel&) = delete;
 
   // Provides the oracle for speculative memory accesses.
-  const std::array<BigByte, 256> &GetOracle() const;
+  const std::array<OracleEntry, 256> &GetOracle() const;
   // Flushes all indexes in the oracle from the cache.
   void FlushOracle() const;
   // Finds which character was accessed speculatively and increases its score.
   // If one of the characters got a high enough score, returns true and that
   // character. Otherwise it returns false and any character that has the
-  // highest score.
+  // highest score. "High enough" is decided by the decision rule.
   std::pair<bool, char> RecomputeScores(char safe_offset_char);
   // Adds an artifical cache-hit and recompute scores. Useful for demonstration
   // that do not have natural architectural cache-hits.
   std::pair<bool, char> AddHitAndRecomputeScores();
+  // Forgets all scores so that the instance can be used to leak another byte.
+  void ResetScores();
+
+  // Selects the engine that computes the median latency of each probe pass.
+  // The scorer must outlive this object. Defaults to `DefaultScorer()`.
+  void set_scorer(const Scorer &scorer) { scorer_ = &scorer; }
+
+  // Selects the timer used to probe the oracle. The backend must be available
+  // and outlive this object. Defaults to `DefaultTimerBackend()`. Only the
+  // native backend probes with the batched kernel.
+  void set_timer_backend(const TimerBackend &timer) { timer_ = &timer; }
+
+  // Selects when RecomputeScores reports convergence. Defaults to
+  // `DefaultDecisionRule()` at construction time.
+  void set_decision_rule(const DecisionRule &rule) { decision_rule_ = rule; }
+
+  // Posterior probability that the character returned by the last
+  // RecomputeScores call is the leaked one. See DecisionRule.
+  double confidence() const { return confidence_; }
+
+  // Number of RecomputeScores calls since the last ResetScores, i.e. the runs
+  // it took to leak the current byte.
+  int runs() const { return runs_; }
+
+  // Hit counts of the current byte, indexed by character. Only the first 256
+  // entries are scores.
+  const std::array<int, 257> &scores() const { return scores_; }
 
  private:
+  using PaddedArray = BasicPaddedOracleArray<OracleEntry>;
+
+  // Maps the i-th step of a pass over the oracle to the index it visits.
+  // Some CPUs (e.g. AMD Ryzen 5 PRO 2400G) prefetch cache lines, rendering
+  // them all equally fast. Therefore it is necessary to confuse them by
+  // accessing the offsets in a pseudo-random order.
+  static size_t MixedIndex(size_t i) { return ((i * 167) + 13) & 0xFF; }
+
   // Oracle array cannot be allocated for stack because MSVC stack size is 1MB,
   // so it would immediately overflow.
-  std::unique_ptr<PaddedOracleArray> padded_oracle_array_ =
-      std::unique_ptr<PaddedOracleArray>(new PaddedOracleArray);
+  std::unique_ptr<PaddedArray, OracleArrayReleaser<PaddedArray>>
+      padded_oracle_array_{OraclePool<PaddedArray>::Global().Acquire()};
+  // Addresses of the oracle entries in probing order, i.e. the i-th entry is
+  // the one for character MixedIndex(i).
+  std::array<const void *, 256> probe_addresses_;
   std::array<int, 257> scores_ = {};
+  const Scorer *scorer_ = &DefaultScorer();
+  const TimerBackend *timer_ = &DefaultTimerBackend();
+  DecisionRule decision_rule_ = DefaultDecisionRule();
+  double confidence_ = 0;
+  int runs_ = 0;
 };
 
+// Page-aligned oracle used by the demos.
+using CacheSideChannel = BasicCacheSideChannel<BigByte>;
+// Oracle with cache-set coloring, see ColoredBigByte.
+using ColoredCacheSideChannel = BasicCacheSideChannel<ColoredBigByte>;
+
 #endif  // DEMOS_CACHE_SIDECHANNEL_H_
@@ -0,0 +1,208 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#include "calibration_cache.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "compiler_specifics.h"
+#include "cpu_features.h"
+
+#if SAFESIDE_LINUX
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#if SAFESIDE_X64 || SAFESIDE_IA32
+// Vendor, display family/model and stepping from leaves 0 and 1, plus the
+// core type from leaf 0x1A on hybrid parts (e.g. "P" and "E" cores report
+// 0x40 and 0x20 respectively).
+std::string CpuidSignature() {
+  uint32_t regs[4];
+  Cpuid(0, 0, regs);
+  uint32_t max_leaf = regs[0];
+  char vendor[13];
+  // The vendor string is spelled out in EBX, EDX, ECX.
+  for (int i = 0; i < 4; ++i) {
+    vendor[i] = static_cast<char>(regs[1] >> (8 * i));
+    vendor[4 + i] = static_cast<char>(regs[3] >> (8 * i));
+    vendor[8 + i] = static_cast<char>(regs[2] >> (8 * i));
+  }
+  vendor[12] = '\0';
+
+  Cpuid(1, 0, regs);
+  uint32_t stepping = regs[0] & 0xF;
+  uint32_t model = (regs[0] >> 4) & 0xF;
+  uint32_t family = (regs[0] >> 8) & 0xF;
+  if (family == 0x6 || family == 0xF) {
+    model |= ((regs[0] >> 16) & 0xF) << 4;
+  }
+  if (family == 0xF) {
+    family += (regs[0] >> 20) & 0xFF;
+  }
+
+  uint32_t core_type = 0;
+  if (max_leaf >= 7) {
+    Cpuid(7, 0, regs);
+    bool hybrid = (regs[3] >> 15) & 1;
+    if (hybrid && max_leaf >= 0x1A) {
+      Cpuid(0x1A, 0, regs);
+      core_type = regs[0] >> 24;
+    }
+  }
+
+  char buffer[96];
+  snprintf(buffer, sizeof(buffer), "%s-%x-%x-%x-core%x", vendor, family,
+           model, stepping, core_type);
+  return buffer;
+}
+#endif
+
+#if SAFESIDE_LINUX
+// Reads the first line of a sysfs file, without the trailing newline.
+std::string ReadSysfsLine(const std::string &path) {
+  std::ifstream in(path);
+  std::string line;
+  std::getline(in, line);
+  return line;
+}
+
+int CurrentCpu() {
+  int cpu = sched_getcpu();
+  return cpu < 0 ? 0 : cpu;
+}
+#endif
+
+std::string Microcode() {
+#if SAFESIDE_LINUX
+  std::string version = ReadSysfsLine("/sys/devices/system/cpu/cpu" +
+                                      std::to_string(CurrentCpu()) +
+                                      "/microcode/version");
+  if (!version.empty()) {
+    return version;
+  }
+#endif
+  return "unknown";
+}
+
+std::string CacheFilePath() {
+  const char *path = getenv("SAFESIDE_CALIBRATION_CACHE");
+  if (path != nullptr) {
+    return path;
+  }
+  const char *dir = getenv("XDG_CACHE_HOME");
+  if (dir != nullptr && *dir != '\0') {
+    return std::string(dir) + "/safeside_calibration.txt";
+  }
+  const char *home = getenv("HOME");
+  if (home != nullptr && *home != '\0') {
+    return std::string(home) + "/.cache/safeside_calibration.txt";
+  }
+  return "";
+}
+
+struct Entry {
+  std::string key;
+  std::string name;
+  uint64_t value;
+};
+
+std::vector<Entry> ReadEntries(const std::string &path) {
+  std::vector<Entry> entries;
+  std::ifstream in(path);
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream fields(line);
+    Entry entry;
+    if (fields >> entry.key >> entry.name >> entry.value) {
+      entries.push_back(entry);
+    }
+  }
+  return entries;
+}
+
+}  // namespace
+
+std::string CurrentCpuCalibrationKey() {
+  std::string signature;
+#if SAFESIDE_X64 || SAFESIDE_IA32
+  signature = CpuidSignature();
+#elif SAFESIDE_LINUX && SAFESIDE_ARM64
+  // MIDR_EL1 carries implementer, part number and revision, and differs
+  // between the big and little cores of a heterogeneous system.
+  signature = "midr" + ReadSysfsLine("/sys/devices/system/cpu/cpu" +
+                                     std::to_string(CurrentCpu()) +
+                                     "/regs/identification/midr_el1");
+#else
+  signature = "generic";
+#endif
+  return signature + "-ucode" + Microcode();
+}
+
+bool LoadCalibration(const std::string &name, uint64_t *value) {
+  std::string path = CacheFilePath();
+  if (path.empty()) {
+    return false;
+  }
+  std::string key = CurrentCpuCalibrationKey();
+  for (const Entry &entry : ReadEntries(path)) {
+    if (entry.key == key && entry.name == name) {
+      *value = entry.value;
+      return true;
+    }
+  }
+  return false;
+}
+
+void StoreCalibration(const std::string &name, uint64_t value) {
+  std::string path = CacheFilePath();
+  if (path.empty()) {
+    return;
+  }
+  std::string key = CurrentCpuCalibrationKey();
+  std::vector<Entry> entries = ReadEntries(path);
+  bool replaced = false;
+  for (Entry &entry : entries) {
+    if (entry.key == key && entry.name == name) {
+      entry.value = value;
+      replaced = true;
+    }
+  }
+  if (!replaced) {
+    entries.push_back({key, name, value});
+  }
+
+  // Write a private copy and rename it over the original, so that concurrently
+  // starting demos never see a half-written file.
+  std::string temporary = path + ".tmp";
+#if SAFESIDE_LINUX
+  temporary += std::to_string(getpid());
+#endif
+  {
+    std::ofstream out(temporary, std::ios::trunc);
+    for (const Entry &entry : entries) {
+      out << entry.key << ' ' << entry.name << ' ' << entry.value << '\n';
+    }
+    if (!out) {
+      out.close();
+      std::remove(temporary.c_str());
+      return;
+    }
+  }
+  if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+    std::remove(temporary.c_str());
+  }
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#ifndef DEMOS_CALIBRATION_CACHE_H_
+#define DEMOS_CALIBRATION_CACHE_H_
+
+#include <cstdint>
+#include <string>
+
+// Persists calibrated timing thresholds across processes, so that the ~20
+// demo binaries of a suite run don't each repeat a full calibration.
+//
+// Values are keyed by the identity of the CPU the calling thread runs on:
+// vendor, family, model and stepping, microcode revision and, on hybrid
+// parts, the core type. A microcode update or a migration to a different kind
+// of core therefore naturally misses the cache.
+//
+// The cache is a small text file, one "<key> <name> <value>" entry per line.
+// Its location is $SAFESIDE_CALIBRATION_CACHE if set (an empty value disables
+// the cache), otherwise safeside_calibration.txt in $XDG_CACHE_HOME or
+// $HOME/.cache. All failures to read or write the file are silent: the caller
+// just calibrates from scratch.
+
+// Returns the key describing the CPU the calling thread currently runs on.
+std::string CurrentCpuCalibrationKey();
+
+// Looks up the value stored under `name` for the current CPU.
+bool LoadCalibration(const std::string &name, uint64_t *value);
+
+// Stores `value` under `name` for the current CPU, replacing any older entry.
+void StoreCalibration(const std::string &name, uint64_t value);
+
+#endif  // DEMOS_CALIBRATION_CACHE_H_
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#include "cpu_features.h"
+
+#if SAFESIDE_X64 || SAFESIDE_IA32
+#  if SAFESIDE_MSVC
+#  include <intrin.h>
+#  elif SAFESIDE_GNUC
+#  include <cpuid.h>
+#  endif
+#endif
+
+#if SAFESIDE_X64 || SAFESIDE_IA32
+void Cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) {
+  regs[0] = regs[1] = regs[2] = regs[3] = 0;
+#  if SAFESIDE_MSVC
+  int max[4];
+  __cpuid(max, leaf & 0x80000000);
+  if (static_cast<uint32_t>(max[0]) >= leaf) {
+    __cpuidex(reinterpret_cast<int *>(regs), leaf, subleaf);
+  }
+#  else
+  if (__get_cpuid_max(leaf & 0x80000000, nullptr) >= leaf) {
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+  }
+#  endif
+}
+#endif
+
+namespace {
+
+CpuFeatures DetectCpuFeatures() {
+  CpuFeatures features = {};
+#if SAFESIDE_X64 || SAFESIDE_IA32
+  uint32_t regs[4];
+  Cpuid(7, 0, regs);
+  features.clflushopt = (regs[1] >> 23) & 1;
+  features.rtm = (regs[1] >> 11) & 1;
+  features.rtm_always_abort = (regs[3] >> 11) & 1;
+  Cpuid(0x80000001, 0, regs);
+  features.rdtscp = (regs[3] >> 27) & 1;
+  Cpuid(0x80000008, 0, regs);
+  features.rdpru = (regs[1] >> 4) & 1;
+#endif
+  return features;
+}
+
+}  // namespace
+
+const CpuFeatures &GetCpuFeatures() {
+  static CpuFeatures features = DetectCpuFeatures();
+  return features;
+}
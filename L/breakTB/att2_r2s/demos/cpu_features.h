@@ -0,0 +1,41 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#ifndef DEMOS_CPU_FEATURES_H_
+#define DEMOS_CPU_FEATURES_H_
+
+#include <cstdint>
+
+#include "compiler_specifics.h"
+
+// Optional instructions the support library can make use of, detected once at
+// runtime. All fields are false on architectures where they don't apply.
+struct CpuFeatures {
+  // CLFLUSHOPT, a weakly ordered CLFLUSH. CPUID.(EAX=7,ECX=0):EBX[23].
+  bool clflushopt;
+  // RDTSCP. CPUID.80000001H:EDX[27].
+  bool rdtscp;
+  // AMD RDPRU. CPUID.80000008H:EBX[4].
+  bool rdpru;
+  // Intel TSX restricted transactional memory. CPUID.(EAX=7,ECX=0):EBX[11].
+  bool rtm;
+  // RTM transactions always abort. CPUID.(EAX=7,ECX=0):EDX[11].
+  bool rtm_always_abort;
+};
+
+const CpuFeatures &GetCpuFeatures();
+
+#if SAFESIDE_X64 || SAFESIDE_IA32
+// Executes CPUID for `leaf` and `subleaf` and stores EAX, EBX, ECX and EDX to
+// regs[0..3]. Stores zeros if the leaf is beyond the maximum basic or extended
+// leaf of the CPU.
+void Cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]);
+#endif
+
+#endif  // DEMOS_CPU_FEATURES_H_
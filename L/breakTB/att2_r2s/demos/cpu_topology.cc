@@ -0,0 +1,153 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#include "cpu_topology.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include "compiler_specifics.h"
+
+#if SAFESIDE_LINUX
+#include <sched.h>
+#endif
+
+namespace {
+
+#if SAFESIDE_LINUX
+const char kCpuRoot[] = "/sys/devices/system/cpu";
+
+std::string ReadSysfsLine(const std::string &path) {
+  std::ifstream in(path);
+  std::string line;
+  std::getline(in, line);
+  return line;
+}
+
+std::string CpuPath(int cpu) {
+  return std::string(kCpuRoot) + "/cpu" + std::to_string(cpu);
+}
+
+// CPUs sharing the L2 cache with `cpu`, or an empty vector if the cache
+// hierarchy isn't exported.
+std::vector<int> L2SharingCpus(int cpu) {
+  for (int index = 0;; ++index) {
+    std::string cache = CpuPath(cpu) + "/cache/index" + std::to_string(index);
+    std::string level = ReadSysfsLine(cache + "/level");
+    if (level.empty()) {
+      return {};
+    }
+    if (level == "2") {
+      return ParseCpuList(ReadSysfsLine(cache + "/shared_cpu_list"));
+    }
+  }
+}
+
+// Union-find over CPU numbers. Merging both the SMT siblings and the L2
+// sharers of every CPU yields the groups even if the two relations aren't
+// nested.
+class CpuGroups {
+ public:
+  int Find(int cpu) {
+    auto it = parent_.find(cpu);
+    if (it == parent_.end()) {
+      parent_[cpu] = cpu;
+      return cpu;
+    }
+    if (it->second == cpu) {
+      return cpu;
+    }
+    int root = Find(it->second);
+    parent_[cpu] = root;
+    return root;
+  }
+
+  void Merge(int a, int b) {
+    int root_a = Find(a);
+    int root_b = Find(b);
+    // Keep the lowest CPU as the root.
+    if (root_a < root_b) {
+      parent_[root_b] = root_a;
+    } else {
+      parent_[root_a] = root_b;
+    }
+  }
+
+ private:
+  std::map<int, int> parent_;
+};
+#endif
+
+}  // namespace
+
+std::vector<int> ParseCpuList(const std::string &list) {
+  std::vector<int> cpus;
+  std::istringstream ranges(list);
+  std::string range;
+  while (std::getline(ranges, range, ',')) {
+    if (range.empty()) {
+      continue;
+    }
+    size_t dash = range.find('-');
+    int first = atoi(range.c_str());
+    int last = dash == std::string::npos ? first
+                                         : atoi(range.c_str() + dash + 1);
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  std::sort(cpus.begin(), cpus.end());
+  cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+  return cpus;
+}
+
+std::vector<int> IndependentCpus() {
+#if SAFESIDE_LINUX
+  cpu_set_t allowed;
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    return {};
+  }
+
+  std::vector<int> online =
+      ParseCpuList(ReadSysfsLine(std::string(kCpuRoot) + "/online"));
+  CpuGroups groups;
+  for (int cpu : online) {
+    groups.Find(cpu);
+    std::vector<int> sharing =
+        ParseCpuList(ReadSysfsLine(CpuPath(cpu) +
+                                   "/topology/thread_siblings_list"));
+    for (int other : L2SharingCpus(cpu)) {
+      sharing.push_back(other);
+    }
+    for (int other : sharing) {
+      groups.Merge(cpu, other);
+    }
+  }
+
+  // The lowest usable CPU of every group. Groups are visited in ascending
+  // order of their CPUs, so the first usable one wins.
+  std::map<int, int> chosen;
+  for (int cpu : online) {
+    if (CPU_ISSET(cpu, &allowed)) {
+      chosen.emplace(groups.Find(cpu), cpu);
+    }
+  }
+  std::vector<int> cpus;
+  for (const auto &group : chosen) {
+    cpus.push_back(group.second);
+  }
+  std::sort(cpus.begin(), cpus.end());
+  return cpus;
+#else
+  return {};
+#endif
+}
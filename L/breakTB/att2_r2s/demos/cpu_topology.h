@@ -0,0 +1,30 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#ifndef DEMOS_CPU_TOPOLOGY_H_
+#define DEMOS_CPU_TOPOLOGY_H_
+
+#include <string>
+#include <vector>
+
+// Parses a kernel CPU list such as "0-3,8,10-11" into sorted CPU numbers.
+std::vector<int> ParseCpuList(const std::string &list);
+
+// Returns one logical CPU for every group of CPUs that share a physical core
+// (SMT siblings) or an L2 cache, so that jobs pinned to different returned
+// CPUs don't compete for branch predictors, L1 or L2. They may still share the
+// LLC. Only online CPUs in the affinity mask of the calling thread are
+// considered, and the lowest CPU of each group is returned, in ascending
+// order.
+//
+// Reads the topology from /sys/devices/system/cpu. Returns an empty vector on
+// other systems or if the topology is unreadable.
+std::vector<int> IndependentCpus();
+
+#endif  // DEMOS_CPU_TOPOLOGY_H_
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#include "decision_rule.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <tuple>
+#include <utility>
+
+namespace {
+
+// Returns the indices of the biggest and second-biggest values in the range.
+template <typename RangeT>
+std::pair<size_t, size_t> TwoTwoIndices(const RangeT &range) {
+  std::pair<size_t, size_t> result = {256, 256};  // first and second biggest
+  for (size_t i = 0; i < range.size(); ++i) {
+    if (range[i] > range[result.first]) {
+      result.second = result.first;
+      result.first = i;
+    } else if (range[i] > range[result.second]) {
+      result.second = i;
+    }
+  }
+  return result;
+}
+
+DecisionRule RuleFromEnvironment() {
+  const char *value = getenv("SAFESIDE_ERROR_BOUND");
+  if (value != nullptr) {
+    double error_bound = strtod(value, nullptr);
+    if (error_bound > 0 && error_bound < 1) {
+      const char *ratio = getenv("SAFESIDE_HIT_LIKELIHOOD_RATIO");
+      if (ratio != nullptr && strtod(ratio, nullptr) > 1) {
+        return DecisionRule::Posterior(error_bound, strtod(ratio, nullptr));
+      }
+      return DecisionRule::Posterior(error_bound);
+    }
+  }
+  return DecisionRule::FixedMargin();
+}
+
+DecisionRule &MutableDefaultDecisionRule() {
+  static DecisionRule rule = RuleFromEnvironment();
+  return rule;
+}
+
+}  // namespace
+
+DecisionRule::DecisionRule(bool posterior, double error_bound,
+                           double hit_likelihood_ratio)
+    : posterior_(posterior),
+      error_bound_(error_bound),
+      log_hit_likelihood_ratio_(std::log(hit_likelihood_ratio)) {}
+
+DecisionRule DecisionRule::FixedMargin() {
+  return DecisionRule(false, 0, kDefaultHitLikelihoodRatio);
+}
+
+DecisionRule DecisionRule::Posterior(double error_bound,
+                                     double hit_likelihood_ratio) {
+  return DecisionRule(true, error_bound, hit_likelihood_ratio);
+}
+
+Verdict DecisionRule::Evaluate(const std::array<int, 257> &scores) const {
+  size_t best, runner_up;
+  std::tie(best, runner_up) = TwoTwoIndices(scores);
+
+  // posterior(best) = 1 / sum_c ratio^(scores[c] - scores[best]). Candidates
+  // trailing the best by more than 40 / log(ratio) hits contribute less than
+  // e^-40 each and skip the exp() call. Until the scores spread out, e.g.
+  // while they are still tied, every candidate pays for one.
+  double normalizer = 0;
+  for (size_t i = 0; i < 256; ++i) {
+    double log_odds = (scores[i] - scores[best]) * log_hit_likelihood_ratio_;
+    if (log_odds > -40) {
+      normalizer += std::exp(log_odds);
+    }
+  }
+  double confidence = 1 / normalizer;
+
+  bool converged;
+  if (posterior_) {
+    converged = 1 - confidence <= error_bound_;
+  } else {
+    converged = scores[best] > 2 * scores[runner_up] + 40;
+  }
+  return {converged, static_cast<char>(best), confidence};
+}
+
+const DecisionRule &DefaultDecisionRule() {
+  return MutableDefaultDecisionRule();
+}
+
+void SetDefaultDecisionRule(const DecisionRule &rule) {
+  MutableDefaultDecisionRule() = rule;
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#ifndef DEMOS_DECISION_RULE_H_
+#define DEMOS_DECISION_RULE_H_
+
+#include <array>
+
+// Result of evaluating the per-character scores after one iteration.
+struct Verdict {
+  // True iff the rule is satisfied that `value` is the leaked byte.
+  bool converged;
+  // Character with the highest score.
+  char value;
+  // Posterior probability that `value` is the leaked byte, see DecisionRule.
+  double confidence;
+};
+
+// Decides when the scores accumulated by CacheSideChannel are conclusive.
+//
+// Both rules report the same confidence value. It is the posterior of the
+// best-scoring character under a simple model of the experiment: every valid
+// sample is one hit, and a hit is `hit_likelihood_ratio` times more likely to
+// land on the leaked byte than on any particular other byte. With a uniform
+// prior over the 256 candidates, the posterior of candidate `c` is then
+// proportional to hit_likelihood_ratio^scores[c].
+//
+// Unless given, the ratio is kDefaultHitLikelihoodRatio. It is fixed rather
+// than estimated from the scores being judged, which would make the first few
+// hits look conclusive. See kDefaultHitLikelihoodRatio for its calibration.
+//
+//   - The fixed-margin rule ignores the confidence and converges once the best
+//     score exceeds twice the runner-up score plus 40.
+//   - The posterior rule converges as soon as 1 - confidence drops to
+//     `error_bound` or below. This is the sequential-test view of the same
+//     experiment: on quiet hosts it needs only a handful of hits, while on
+//     noisy hosts it keeps sampling until the best character pulls ahead of
+//     all competitors.
+//
+// The error bound is a heuristic. It holds only as far as the model does, and
+// real hits are neither independent nor uniform: prefetchers and aliasing
+// favour some bytes over others.
+class DecisionRule {
+ public:
+  // Measured on a quiet and on a memory-loaded host: when the fixed-margin
+  // rule converged, spectre_v4 and spectre_v1_btb_sa had scored about 2100
+  // hits on the leaked bytes and at most 4 on all 255 other bytes together,
+  // a ratio above 10^5. The default stays over three orders of magnitude
+  // below that, which absorbs bursts of correlated false hits and slower
+  // leaks; a lead of 7 hits over every other byte bounds the error by 10^-6.
+  static constexpr double kDefaultHitLikelihoodRatio = 16.0;
+
+  // The historical rule: scores[best] > 2 * scores[runner_up] + 40.
+  static DecisionRule FixedMargin();
+  // Stops once the posterior error probability is at most `error_bound`.
+  // The hit likelihood ratio must be above 1.
+  static DecisionRule Posterior(
+      double error_bound,
+      double hit_likelihood_ratio = kDefaultHitLikelihoodRatio);
+
+  Verdict Evaluate(const std::array<int, 257> &scores) const;
+
+  bool is_posterior() const { return posterior_; }
+  double error_bound() const { return error_bound_; }
+
+ private:
+  DecisionRule(bool posterior, double error_bound,
+               double hit_likelihood_ratio);
+
+  bool posterior_;
+  double error_bound_;
+  double log_hit_likelihood_ratio_;
+};
+
+// Rule that new CacheSideChannel instances start with. Unless set explicitly,
+// it is the posterior rule if the SAFESIDE_ERROR_BOUND environment variable
+// holds a probability in (0, 1), and the fixed-margin rule otherwise. This lets
+// every demo opt in without code changes. SAFESIDE_HIT_LIKELIHOOD_RATIO, if
+// above 1, replaces kDefaultHitLikelihoodRatio.
+const DecisionRule &DefaultDecisionRule();
+void SetDefaultDecisionRule(const DecisionRule &rule);
+
+#endif  // DEMOS_DECISION_RULE_H_
@@ -0,0 +1,28 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#include <cstdlib>
+#include <iostream>
+
+#include "demo_registry.h"
+
+// Entry point of the standalone executable of a registered demo. Runs the one
+// demo linked in and prints what it leaks.
+int main() {
+  const std::vector<Demo> &demos = RegisteredDemos();
+  if (demos.size() != 1) {
+    std::cerr << "Expected exactly one registered demo, found "
+              << demos.size() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  ConsoleDemoContext context;
+  demos[0].run(context);
+  return context.failed() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#include "demo_registry.h"
+
+#include <iostream>
+
+namespace {
+
+// Function-local so that registrations from static initializers in other
+// translation units always find it constructed.
+std::vector<Demo> &MutableRegisteredDemos() {
+  static std::vector<Demo> demos;
+  return demos;
+}
+
+}  // namespace
+
+CacheSideChannel &DemoContext::sidechannel() {
+  if (!sidechannel_) {
+    sidechannel_.reset(new CacheSideChannel);
+  }
+  return *sidechannel_;
+}
+
+TimingArray &DemoContext::timing_array() {
+  if (!timing_array_) {
+    timing_array_.reset(new TimingArray);
+  }
+  return *timing_array_;
+}
+
+ExperimentBudget DemoContext::budget() const {
+  ExperimentBudget budget;
+  budget.max_runs = max_runs_;
+  if (deadline_.count() > 0) {
+    budget.deadline = demo_deadline_;
+  }
+  return budget;
+}
+
+void DemoContext::BeginLeak(const std::string &expected) {
+  demo_deadline_ = std::chrono::steady_clock::now() + deadline_;
+  OnBeginLeak(expected);
+}
+
+bool DemoContext::ReportByte(const ExperimentOutcome &outcome) {
+  OnByte(outcome);
+  return outcome.converged;
+}
+
+void DemoContext::EndLeak() {
+  OnEndLeak();
+}
+
+void ConsoleDemoContext::OnBeginLeak(const std::string & /* expected */) {
+  failed_ = false;
+  std::cout << "Leaking the string: ";
+  std::cout.flush();
+}
+
+void ConsoleDemoContext::OnByte(const ExperimentOutcome &outcome) {
+  if (!outcome.converged) {
+    failed_ = true;
+    std::cerr << "Does not converge " << outcome.value << std::endl;
+    return;
+  }
+  std::cout << outcome.value;
+  std::cout.flush();
+}
+
+void ConsoleDemoContext::OnEndLeak() {
+  if (!failed_) {
+    std::cout << "\nDone!\n";
+  }
+}
+
+const std::vector<Demo> &RegisteredDemos() {
+  return MutableRegisteredDemos();
+}
+
+const Demo *FindDemo(const std::string &name) {
+  for (const Demo &demo : RegisteredDemos()) {
+    if (name == demo.name) {
+      return &demo;
+    }
+  }
+  return nullptr;
+}
+
+DemoRegistration::DemoRegistration(const char *name,
+                                   void (*run)(DemoContext &context)) {
+  MutableRegisteredDemos().push_back({name, run});
+}
+
+bool FlagValue(const std::string &argument, const std::string &name,
+               std::string *value) {
+  std::string prefix = "--" + name + "=";
+  if (argument.compare(0, prefix.size(), prefix) != 0) {
+    return false;
+  }
+  *value = argument.substr(prefix.size());
+  return true;
+}
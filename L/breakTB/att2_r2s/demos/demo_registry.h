@@ -0,0 +1,124 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#ifndef DEMOS_DEMO_REGISTRY_H_
+#define DEMOS_DEMO_REGISTRY_H_
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cache_sidechannel.h"
+#include "experiment.h"
+#include "timing_array.h"
+
+// Registered demos don't define `main` themselves. They register a function
+// that leaks their secret through a DemoContext, and are linked either with
+// demo_main.cc into their own executable, which prints the leaked string as
+// the demos always did, or together with other demos into safeside_runner,
+// which runs any selection of them in one process and reports JSON.
+//
+// Demos linked into the runner share one address space, so everything they
+// define must either have internal linkage or a name unique to the demo. In
+// particular, demos that define the global `afterspeculation` label can't be
+// registered.
+
+// Gives a demo its side-channel state and budget, and collects what it
+// leaked. A demo calls BeginLeak, then ReportByte with the outcome of every
+// byte until one doesn't converge, then EndLeak.
+class DemoContext {
+ public:
+  virtual ~DemoContext() = default;
+
+  // Channel shared by all demos run through this context. LeakByte functions
+  // reset its scores before each byte.
+  CacheSideChannel &sidechannel();
+
+  // TimingArray shared by all demos run through this context. Calibrated on
+  // first use.
+  TimingArray &timing_array();
+
+  // Limits every byte of the following demos to `max_runs` runs. Defaults to
+  // the ExperimentBudget default.
+  void set_max_runs(int max_runs) { max_runs_ = max_runs; }
+  // Limits each of the following demos to `deadline` of wall time, counted
+  // from BeginLeak. Zero, the default, means no deadline.
+  void set_deadline(std::chrono::nanoseconds deadline) {
+    deadline_ = deadline;
+  }
+
+  // Budget for the next byte of the running demo.
+  ExperimentBudget budget() const;
+
+  // Starts a demo that tries to leak `expected`.
+  void BeginLeak(const std::string &expected);
+  // Records the outcome of one byte. Returns false if the byte didn't
+  // converge; the demo should then stop leaking and call EndLeak.
+  bool ReportByte(const ExperimentOutcome &outcome);
+  // Ends the demo.
+  void EndLeak();
+
+ protected:
+  virtual void OnBeginLeak(const std::string &expected) = 0;
+  virtual void OnByte(const ExperimentOutcome &outcome) = 0;
+  virtual void OnEndLeak() = 0;
+
+ private:
+  std::unique_ptr<CacheSideChannel> sidechannel_;
+  std::unique_ptr<TimingArray> timing_array_;
+  int max_runs_ = ExperimentBudget().max_runs;
+  std::chrono::nanoseconds deadline_{0};
+  std::chrono::steady_clock::time_point demo_deadline_;
+};
+
+// Prints the leaked string as "Leaking the string: <bytes>\nDone!\n". If a
+// byte doesn't converge, prints "Does not converge <best guess>" to stderr
+// instead of "Done!".
+class ConsoleDemoContext : public DemoContext {
+ public:
+  // Whether a byte of the last demo didn't converge.
+  bool failed() const { return failed_; }
+
+ protected:
+  void OnBeginLeak(const std::string &expected) override;
+  void OnByte(const ExperimentOutcome &outcome) override;
+  void OnEndLeak() override;
+
+ private:
+  bool failed_ = false;
+};
+
+struct Demo {
+  const char *name;
+  void (*run)(DemoContext &context);
+};
+
+// All demos linked into this executable, in registration order.
+const std::vector<Demo> &RegisteredDemos();
+
+// Returns the demo called `name`, or nullptr if there is none.
+const Demo *FindDemo(const std::string &name);
+
+// If `argument` is "--`name`=VALUE", stores VALUE to `value` and returns
+// true. Parses the flags of the drivers that run registered demos.
+bool FlagValue(const std::string &argument, const std::string &name,
+               std::string *value);
+
+// Adds a demo to the registry from a static initializer.
+class DemoRegistration {
+ public:
+  DemoRegistration(const char *name, void (*run)(DemoContext &context));
+};
+
+// Registers `run`, a `void(DemoContext &)` function, as demo `name`.
+#define SAFESIDE_REGISTER_DEMO(name, run) \
+  static DemoRegistration demo_registration_##name(#name, run)
+
+#endif  // DEMOS_DEMO_REGISTRY_H_
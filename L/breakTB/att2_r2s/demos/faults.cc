@@ -12,6 +12,7 @@
 #include <setjmp.h>
 
 #include <cstring>
+#include <mutex>
 
 namespace {
 
@@ -49,3 +50,49 @@ bool RunWithFaultHandler(int fault_signum, std::function<void()> inner) {
 
   return handled_fault;
 }
+
+namespace {
+
+// Scopes alive per signal, and the action they replaced. Guarded by
+// scopes_mutex.
+std::mutex scopes_mutex;
+int scopes[NSIG];
+struct sigaction previous_actions[NSIG];
+
+}  // namespace
+
+thread_local sigjmp_buf FaultScope::jmpbuf_;
+thread_local volatile sig_atomic_t FaultScope::armed_ = 0;
+
+void FaultScope::Handler(int signal, siginfo_t * /* info */,
+                         void * /* ucontext */) {
+  if (armed_) {
+    // The mask was not changed on entry (SA_NODEFER, empty sa_mask), so there
+    // is nothing to restore.
+    siglongjmp(jmpbuf_, 1);
+  }
+  // Not inside Run, e.g. a genuine crash. With SA_NODEFER the signal is
+  // delivered right away with the default action.
+  struct sigaction sa = {};
+  sa.sa_handler = SIG_DFL;
+  sigaction(signal, &sa, nullptr);
+  raise(signal);
+}
+
+FaultScope::FaultScope(int fault_signum) : fault_signum_(fault_signum) {
+  std::lock_guard<std::mutex> lock(scopes_mutex);
+  if (scopes[fault_signum_]++ == 0) {
+    struct sigaction sa = {};
+    sa.sa_sigaction = Handler;
+    sa.sa_flags = SA_SIGINFO | SA_NODEFER;
+    sigemptyset(&sa.sa_mask);
+    sigaction(fault_signum_, &sa, &previous_actions[fault_signum_]);
+  }
+}
+
+FaultScope::~FaultScope() {
+  std::lock_guard<std::mutex> lock(scopes_mutex);
+  if (--scopes[fault_signum_] == 0) {
+    sigaction(fault_signum_, &previous_actions[fault_signum_], nullptr);
+  }
+}
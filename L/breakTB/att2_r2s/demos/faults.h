@@ -10,6 +10,7 @@
 #ifndef DEMOS_FAULTS_H_
 #define DEMOS_FAULTS_H_
 
+#include <setjmp.h>
 #include <signal.h>
 
 #include <functional>
@@ -23,6 +24,60 @@
 // Not thread-safe. Don't use from more than one thread at a time.
 //
 // Returns true iff a signal was handled.
+//
+// Costs two sigaction calls, a sigprocmask round-trip in sigsetjmp and
+// possibly an allocation for the std::function on every call. Loops that
+// fault on every iteration should use FaultScope instead.
 bool RunWithFaultHandler(int fault_signum, std::function<void()> inner);
 
+// Keeps a handler for `fault_signum` installed for the lifetime of the scope,
+// so that FaultScope::Run costs no system call at all:
+//
+//     FaultScope scope(SIGSEGV);
+//     for (...) {
+//       bool handled_fault = scope.Run([&]() { ... });
+//     }
+//
+// The handler is installed with SA_NODEFER and an empty sa_mask, so the signal
+// mask is the same inside the handler as in `inner`, and Run can jump back
+// with a jump buffer that doesn't save the mask. The jump buffer is
+// thread-local, so threads may Run concurrently, each in its own scopes. Run
+// calls don't nest on one thread.
+//
+// Scopes for the same signal may overlap, also across threads; the first one
+// installs the handler and the last one to end restores the previous action.
+// A fault outside of Run while a scope is alive is handled by the default
+// action of the signal.
+class FaultScope {
+ public:
+  explicit FaultScope(int fault_signum);
+  ~FaultScope();
+
+  FaultScope(const FaultScope &) = delete;
+  FaultScope &operator=(const FaultScope &) = delete;
+
+  // Runs `inner`. If the signal is raised, the execution of `inner` is
+  // aborted. Returns true iff a signal was handled.
+  template <typename Inner>
+  bool Run(Inner &&inner) {
+    if (sigsetjmp(jmpbuf_, 0) == 0) {
+      armed_ = 1;
+      inner();
+      armed_ = 0;
+      return false;
+    }
+    armed_ = 0;
+    return true;
+  }
+
+ private:
+  static void Handler(int signal, siginfo_t *info, void *ucontext);
+
+  int fault_signum_;
+
+  static thread_local sigjmp_buf jmpbuf_;
+  // Whether the thread is inside Run, i.e. whether jmpbuf_ is valid.
+  static thread_local volatile sig_atomic_t armed_;
+};
+
 #endif  // DEMOS_FAULTS_H_
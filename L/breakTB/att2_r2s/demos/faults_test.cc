@@ -13,6 +13,8 @@
 
 #include <iostream>
 
+#include "fault_suppression.h"
+
 // Tests that a SIGSEGV is successfully caught and the handler runs.
 bool TestHandlesSigsegv() {
   bool pass = true;
@@ -56,6 +58,77 @@ bool TestNoFault() {
   return pass;
 }
 
+// Tests that a FaultScope handles the signal on every Run, leaves the signal
+// unblocked and restores the previous action when it ends.
+bool TestFaultScope() {
+  bool pass = true;
+
+  struct sigaction before;
+  sigaction(SIGSEGV, nullptr, &before);
+  {
+    FaultScope scope(SIGSEGV);
+    for (int i = 0; i < 3; ++i) {
+      int runs = 0;
+      bool saw_fault = scope.Run([&]() {
+        ++runs;
+        raise(SIGSEGV);
+      });
+      if (runs != 1 || !saw_fault) {
+        std::cerr << "Didn't see expected fault in scope" << std::endl;
+        pass = false;
+      }
+
+      sigset_t mask;
+      sigprocmask(SIG_SETMASK, nullptr, &mask);
+      if (sigismember(&mask, SIGSEGV)) {
+        std::cerr << "SIGSEGV left blocked" << std::endl;
+        pass = false;
+      }
+    }
+
+    if (scope.Run([]() {})) {
+      std::cerr << "Saw unexpected fault in scope" << std::endl;
+      pass = false;
+    }
+  }
+  struct sigaction after;
+  sigaction(SIGSEGV, nullptr, &after);
+  if (after.sa_handler != before.sa_handler) {
+    std::cerr << "Previous SIGSEGV action not restored" << std::endl;
+    pass = false;
+  }
+
+  return pass;
+}
+
+// Tests that every available fault suppression mechanism survives a null
+// pointer dereference and runs a body that doesn't fault to completion.
+bool TestFaultSuppressors() {
+  bool pass = true;
+
+  for (FaultSuppression suppression :
+       {FaultSuppression::kSignal, FaultSuppression::kTsx}) {
+    if (!FaultSuppressionAvailable(suppression)) {
+      continue;
+    }
+    FaultSuppressor suppressor(SIGSEGV, suppression);
+    static volatile char *volatile null_pointer = nullptr;
+    if (!suppressor.Run([]() { (void)*null_pointer; })) {
+      std::cerr << "Didn't suppress expected fault with "
+                << FaultSuppressionName(suppression) << std::endl;
+      pass = false;
+    }
+    int ran_body = 0;
+    if (suppressor.Run([&]() { ran_body = 1; }) || ran_body != 1) {
+      std::cerr << "Didn't complete body with "
+                << FaultSuppressionName(suppression) << std::endl;
+      pass = false;
+    }
+  }
+
+  return pass;
+}
+
 int main(int argc, char* argv[]) {
   bool pass = true;
 
@@ -65,6 +138,10 @@ int main(int argc, char* argv[]) {
 
   pass = pass && TestNoFault();
 
+  pass = pass && TestFaultScope();
+
+  pass = pass && TestFaultSuppressors();
+
   std::cout << (pass ? "pass" : "fail") << std::endl;
 
   return !pass;
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "cpu_features.h"
+#include "hardware_constants.h"
+#include "instr.h"
+#include "utils.h"
+
+namespace {
+
+// One line per page, plus one line of stride so that the lines are spread
+// over the cache sets like TimingArray's elements.
+constexpr size_t kLines = 256;
+constexpr size_t kStride = kPageBytes + kCacheLineBytes;
+constexpr int kPasses = 2000;
+
+using Clock = std::chrono::steady_clock;
+using Lines = std::array<const void *, kLines>;
+
+// The flush loop as it was before FlushLines: CLFLUSH per line, one barrier.
+void FlushOneByOne(const Lines &lines) {
+  for (const void *line : lines) {
+    FlushDataCacheLineNoBarrier(line);
+  }
+  MemoryAndSpeculationBarrier();
+}
+
+void FlushBatched(const Lines &lines) {
+  FlushLines(lines);
+}
+
+template <typename Flush>
+void Report(const char *name, std::vector<char> &buffer, const Lines &lines,
+            bool dirty, Flush flush) {
+  std::vector<double> pass_ns;
+  for (int n = 0; n < kPasses; ++n) {
+    // Bring every line into the cache, modified if `dirty`.
+    for (size_t i = 0; i < kLines; ++i) {
+      if (dirty) {
+        buffer[i * kStride] = static_cast<char>(n);
+      } else {
+        ForceRead(lines[i]);
+      }
+    }
+    MemoryAndSpeculationBarrier();
+
+    auto start = Clock::now();
+    flush(lines);
+    pass_ns.push_back(
+        std::chrono::duration<double, std::nano>(Clock::now() - start)
+            .count());
+  }
+
+  std::sort(pass_ns.begin(), pass_ns.end());
+  std::cout << std::left << std::setw(16) << name << std::right << std::fixed
+            << std::setprecision(0) << "median " << std::setw(8)
+            << pass_ns[kPasses / 2] << " ns  p95 " << std::setw(8)
+            << pass_ns[kPasses * 95 / 100] << " ns" << std::endl;
+}
+
+}  // namespace
+
+// Measures flushing 256 cached lines, clean and dirty, with one CLFLUSH per
+// line versus one FlushLines batch (CLFLUSHOPT where supported).
+int main() {
+  std::cout << "CLFLUSHOPT "
+            << (GetCpuFeatures().clflushopt ? "supported" : "not supported")
+            << std::endl;
+
+  std::vector<char> buffer(kLines * kStride, 1);
+  Lines lines;
+  for (size_t i = 0; i < kLines; ++i) {
+    lines[i] = &buffer[i * kStride];
+  }
+
+  Report("each/clean", buffer, lines, false, FlushOneByOne);
+  Report("batched/clean", buffer, lines, false, FlushBatched);
+  Report("each/dirty", buffer, lines, true, FlushOneByOne);
+  Report("batched/dirty", buffer, lines, true, FlushBatched);
+}
@@ -10,6 +10,8 @@
 // File containing architecturally dependent features implemented in inline
 // assembler.
 #include "instr.h"
+
+#include "cpu_features.h"
 #include "utils.h"
 
 #if SAFESIDE_X64 || SAFESIDE_IA32
@@ -117,3 +119,40 @@ int ExchangeES(int input) {
   return output;
 }
 #endif
+
+namespace {
+
+using FlushLinesFunction = void (*)(const void *const *, size_t);
+
+void FlushLinesOneByOne(const void *const *addresses, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    FlushDataCacheLineNoBarrier(addresses[i]);
+  }
+}
+
+#if SAFESIDE_X64 || SAFESIDE_IA32
+#if SAFESIDE_GNUC
+__attribute__((target("clflushopt")))
+#endif
+void FlushLinesClflushopt(const void *const *addresses, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    _mm_clflushopt(const_cast<void *>(addresses[i]));
+  }
+}
+#endif
+
+FlushLinesFunction SelectFlushLines() {
+#if SAFESIDE_X64 || SAFESIDE_IA32
+  if (GetCpuFeatures().clflushopt) {
+    return FlushLinesClflushopt;
+  }
+#endif
+  return FlushLinesOneByOne;
+}
+
+}  // namespace
+
+void FlushLinesNoBarrier(const void *const *addresses, size_t count) {
+  static const FlushLinesFunction flush_lines = SelectFlushLines();
+  flush_lines(addresses, count);
+}
@@ -10,6 +10,8 @@
 #ifndef DEMOS_INSTR_H_
 #define DEMOS_INSTR_H_
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 
@@ -49,6 +51,25 @@ inline void FlushDataCacheLine(void *address) {
   MemoryAndSpeculationBarrier();
 }
 
+// Flushes the cache lines containing addresses[0..count) like
+// FlushDataCacheLineNoBarrier. On x86 CPUs with CLFLUSHOPT (see
+// cpu_features.h) the flushes are weakly ordered among each other, so all of
+// them can be in flight at once; elsewhere this is a plain loop over
+// FlushDataCacheLineNoBarrier.
+void FlushLinesNoBarrier(const void *const *addresses, size_t count);
+
+// Flushes a batch of cache lines and waits for all of them with a single
+// trailing barrier.
+inline void FlushLines(const void *const *addresses, size_t count) {
+  FlushLinesNoBarrier(addresses, count);
+  MemoryAndSpeculationBarrier();
+}
+
+template <size_t N>
+inline void FlushLines(const std::array<const void *, N> &addresses) {
+  FlushLines(addresses.data(), N);
+}
+
 #if SAFESIDE_GNUC
 // Unwinds the stack until the given pointer, flushes the stack pointer and
 // returns.
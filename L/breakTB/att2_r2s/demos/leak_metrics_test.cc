@@ -0,0 +1,107 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#include "leak_metrics.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void Expect(bool condition, const char *what) {
+  if (!condition) {
+    std::cout << "Failed: " << what << std::endl;
+    ++failures;
+  }
+}
+
+bool Near(double a, double b) {
+  return std::abs(a - b) < 1e-3;
+}
+
+}  // namespace
+
+// Checks the Wilson interval against reference values, the histogram
+// quantiles and that shards recorded by concurrent threads merge into the
+// same counts a single shard would hold.
+int main(int argc, char* argv[]) {
+  auto interval = WilsonInterval(0, 10);
+  Expect(Near(interval.first, 0) && Near(interval.second, 0.2775),
+         "Wilson interval of 0/10");
+  interval = WilsonInterval(5, 10);
+  Expect(Near(interval.first, 0.2366) && Near(interval.second, 0.7634),
+         "Wilson interval of 5/10");
+  interval = WilsonInterval(0, 0);
+  Expect(interval.first == 0 && interval.second == 1,
+         "Wilson interval without trials");
+
+  Log2Histogram histogram;
+  for (uint64_t value = 1; value <= 100; ++value) {
+    histogram.Add(value);
+  }
+  // The median, 50, is in [32, 64); the maximum, 100, in [64, 128).
+  Expect(histogram.Quantile(0.5) == 63, "histogram median");
+  Expect(histogram.Quantile(1) == 127, "histogram maximum");
+
+  const size_t threads = 4;
+  const int samples_per_thread = 10000;
+  LeakMetrics sharded(threads);
+  LeakMetrics single;
+  std::vector<std::thread> writers;
+  for (size_t t = 0; t < threads; ++t) {
+    writers.emplace_back([&sharded, t] {
+      for (int i = 0; i < samples_per_thread; ++i) {
+        LeakSample sample = {static_cast<size_t>(i % 8),
+                             static_cast<size_t>(i % 16), 'a',
+                             i % 4 == 0 ? 'b' : 'a', true, i % 100 + 1,
+                             1000, 0.9};
+        sharded.shard(t).Record(sample);
+      }
+    });
+  }
+  for (std::thread &writer : writers) {
+    writer.join();
+  }
+  for (size_t t = 0; t < threads; ++t) {
+    for (int i = 0; i < samples_per_thread; ++i) {
+      LeakSample sample = {static_cast<size_t>(i % 8),
+                           static_cast<size_t>(i % 16), 'a',
+                           i % 4 == 0 ? 'b' : 'a', true, i % 100 + 1, 1000,
+                           0.9};
+      single.shard(0).Record(sample);
+    }
+  }
+  sharded.Merge();
+  single.Merge();
+  Expect(sharded.overall().trials == threads * samples_per_thread,
+         "merged trials");
+  Expect(sharded.overall().correct == single.overall().correct,
+         "merged correct count");
+  Expect(Near(sharded.overall().accuracy(), 0.75), "merged accuracy");
+  for (size_t key = 0; key < 8; ++key) {
+    Expect(sharded.key(key).trials == single.key(key).trials &&
+               sharded.key(key).correct == single.key(key).correct,
+           "merged per-key counts");
+  }
+  for (size_t position = 0; position < 16; ++position) {
+    Expect(sharded.position(position).runs.buckets() ==
+               single.position(position).runs.buckets(),
+           "merged per-position histograms");
+  }
+  Expect(sharded.Json("depth") == single.Json("depth"), "JSON export");
+
+  bool pass = failures == 0;
+  std::cout << (pass ? "pass" : "fail") << std::endl;
+  return !pass;
+}
@@ -0,0 +1,16 @@
+/*
+ * Copyright 2019 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#include "local_content.h"
+
+// Both are deliberately mutable globals. Demos rely on the compiler not
+// knowing their values, e.g. to keep code after an unconditional-looking
+// exit() alive.
+const char *public_data = "9999999999999999999999999999999999999999999999999999";
+const char *private_data = "ABCDEFGHIJKL6NOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
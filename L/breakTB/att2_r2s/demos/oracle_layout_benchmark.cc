@@ -0,0 +1,99 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "cache_sidechannel.h"
+#include "utils.h"
+
+namespace {
+
+// Bytes "leaked" per layout. Each one is read architecturally, so the
+// benchmark measures the quality of the channel, not of any speculation.
+constexpr int kBytes = 64;
+constexpr int kMaxRuns = 100000;
+
+using Clock = std::chrono::steady_clock;
+
+struct LayoutResult {
+  std::vector<int> runs_to_converge;
+  int failures = 0;
+  double probe_pass_ns = 0;
+};
+
+template <typename ChannelT>
+LayoutResult Measure() {
+  LayoutResult result;
+  ChannelT sidechannel;
+  sidechannel.set_decision_rule(DecisionRule::FixedMargin());
+  const auto &oracle = sidechannel.GetOracle();
+
+  Clock::duration probe_time = Clock::duration::zero();
+  long passes = 0;
+
+  for (int n = 0; n < kBytes; ++n) {
+    unsigned char secret = static_cast<unsigned char>(n * 37 + 11);
+    sidechannel.ResetScores();
+
+    int run = 0;
+    for (; run < kMaxRuns; ++run) {
+      // Same shape as the demos: one known-safe hit plus the "leaked" one.
+      unsigned char safe = static_cast<unsigned char>(secret + 1 + run % 200);
+      sidechannel.FlushOracle();
+      ForceRead(oracle.data() + safe);
+      ForceRead(oracle.data() + secret);
+
+      auto start = Clock::now();
+      std::pair<bool, char> verdict =
+          sidechannel.RecomputeScores(static_cast<char>(safe));
+      probe_time += Clock::now() - start;
+      ++passes;
+
+      if (verdict.first) {
+        if (static_cast<unsigned char>(verdict.second) != secret) {
+          ++result.failures;
+        }
+        break;
+      }
+    }
+    result.runs_to_converge.push_back(run + 1);
+  }
+
+  result.probe_pass_ns =
+      std::chrono::duration<double, std::nano>(probe_time).count() / passes;
+  return result;
+}
+
+void Report(const char *name, LayoutResult result) {
+  std::vector<int> &runs = result.runs_to_converge;
+  std::sort(runs.begin(), runs.end());
+  double mean = 0;
+  for (int r : runs) {
+    mean += r;
+  }
+  mean /= runs.size();
+  std::cout << std::left << std::setw(14) << name << std::right << std::fixed
+            << std::setprecision(1) << "runs-to-converge mean "
+            << std::setw(7) << mean << " median " << std::setw(5)
+            << runs[runs.size() / 2] << " max " << std::setw(6) << runs.back()
+            << "  wrong " << result.failures << "  probe pass "
+            << std::setw(9) << result.probe_pass_ns << " ns" << std::endl;
+}
+
+}  // namespace
+
+// Compares the page-aligned oracle layout with the cache-set-colored one.
+int main() {
+  Report("page_aligned", Measure<CacheSideChannel>());
+  Report("colored", Measure<ColoredCacheSideChannel>());
+}
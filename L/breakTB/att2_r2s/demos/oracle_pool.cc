@@ -0,0 +1,80 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#include "oracle_pool.h"
+
+#include <new>
+
+#include "cache_sidechannel.h"
+#include "compiler_specifics.h"
+
+#if SAFESIDE_LINUX
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+template <typename ArrayT>
+ArrayT *AllocatePrefaulted() {
+#if SAFESIDE_LINUX
+  // Private writable mappings are populated with write faults, so every page
+  // gets its own physical page instead of the shared zero page.
+  void *memory = mmap(nullptr, sizeof(ArrayT),
+                      PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+  if (memory != MAP_FAILED) {
+    // Best effort. Keeps the pages resident, but fails without CAP_IPC_LOCK
+    // once RLIMIT_MEMLOCK is exhausted, which is fine.
+    mlock(memory, sizeof(ArrayT));
+    return new (memory) ArrayT;
+  }
+#endif
+  // Oracle entries initialize their padding, which faults every page in right
+  // here.
+  return new ArrayT;
+}
+
+}  // namespace
+
+template <typename ArrayT>
+OraclePool<ArrayT> &OraclePool<ArrayT>::Global() {
+  // Leaked intentionally, channels may be released during static destruction.
+  static OraclePool *pool = new OraclePool;
+  return *pool;
+}
+
+template <typename ArrayT>
+ArrayT *OraclePool<ArrayT>::Acquire() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!free_arrays_.empty()) {
+      ArrayT *array = free_arrays_.back();
+      free_arrays_.pop_back();
+      return array;
+    }
+  }
+  return AllocatePrefaulted<ArrayT>();
+}
+
+template <typename ArrayT>
+void OraclePool<ArrayT>::Release(ArrayT *array) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  free_arrays_.push_back(array);
+}
+
+template <typename ArrayT>
+void OraclePool<ArrayT>::Reserve(size_t count) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  while (free_arrays_.size() < count) {
+    free_arrays_.push_back(AllocatePrefaulted<ArrayT>());
+  }
+}
+
+template class OraclePool<PaddedOracleArray>;
+template class OraclePool<ColoredPaddedOracleArray>;
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#ifndef DEMOS_ORACLE_POOL_H_
+#define DEMOS_ORACLE_POOL_H_
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// OraclePool hands out the ~1 MB backing store of CacheSideChannel's oracle.
+// `ArrayT` is one of the BasicPaddedOracleArray types; each has its own pool.
+//
+// Allocating a fresh oracle array costs a heap allocation and one page
+// fault per page (258 of them) on first touch, which used to be paid for
+// every leaked byte. The pool instead:
+//   - maps new arrays with MAP_POPULATE and mlock()s them where the platform
+//     and resource limits allow it, so they are backed by distinct physical
+//     pages before the first measurement;
+//   - keeps released arrays and hands them out again, so in steady state
+//     acquiring an oracle is a mutex-protected pop from a vector.
+//
+// Arrays are never returned to the operating system.
+//
+// Implemented in oracle_pool.cc for PaddedOracleArray and
+// ColoredPaddedOracleArray.
+template <typename ArrayT>
+class OraclePool {
+ public:
+  static OraclePool &Global();
+
+  // Returns a ready-to-use array. Reuses a released one if available.
+  ArrayT *Acquire();
+  // Gives the array back for later reuse.
+  void Release(ArrayT *array);
+  // Makes sure at least `count` arrays are available without allocating.
+  void Reserve(size_t count);
+
+ private:
+  OraclePool() = default;
+
+  std::mutex mutex_;
+  std::vector<ArrayT *> free_arrays_;
+};
+
+// Deleter for std::unique_ptr that returns the array to the global pool.
+template <typename ArrayT>
+struct OracleArrayReleaser {
+  void operator()(ArrayT *array) const {
+    OraclePool<ArrayT>::Global().Release(array);
+  }
+};
+
+#endif  // DEMOS_ORACLE_POOL_H_
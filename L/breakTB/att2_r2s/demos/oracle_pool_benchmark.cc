@@ -0,0 +1,95 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "asm/measurereadlatency.h"
+#include "cache_sidechannel.h"
+#include "instr.h"
+
+namespace {
+
+// Number of simulated bytes, matching the length of the usual secret.
+constexpr int kBytes = 16;
+
+using Clock = std::chrono::steady_clock;
+
+// Keeps the legacy probe pass from being optimized away.
+volatile uint64_t latency_sink;
+
+double Microseconds(Clock::duration duration) {
+  return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+void Report(const char *name, std::vector<double> samples) {
+  std::sort(samples.begin(), samples.end());
+  std::cout << std::left << std::setw(16) << name << std::right << std::fixed
+            << std::setprecision(1) << "median " << std::setw(9)
+            << samples[samples.size() / 2] << " us   max " << std::setw(9)
+            << samples.back() << " us" << std::endl;
+}
+
+// What each LeakByte paid before oracles were pooled: a fresh heap-allocated
+// array, faulted in page by page, followed by the first flush and probe pass.
+double LegacyFirstIteration() {
+  auto start = Clock::now();
+  std::unique_ptr<PaddedOracleArray> array(new PaddedOracleArray);
+  for (BigByte &b : array->oracles_) {
+    FlushDataCacheLineNoBarrier(&b);
+  }
+  MemoryAndSpeculationBarrier();
+  for (size_t i = 0; i < 256; ++i) {
+    latency_sink =
+        MeasureReadLatency(&array->oracles_[((i * 167) + 13) & 0xFF]);
+  }
+  return Microseconds(Clock::now() - start);
+}
+
+void FirstIteration(CacheSideChannel &sidechannel) {
+  sidechannel.ResetScores();
+  sidechannel.FlushOracle();
+  sidechannel.RecomputeScores(0);
+}
+
+}  // namespace
+
+// Measures the latency of the first iteration of a LeakByte loop: allocating
+// the oracle (if any), flushing it and running one probe pass.
+int main() {
+  std::vector<double> legacy, pooled, reused;
+
+  for (int i = 0; i < kBytes; ++i) {
+    legacy.push_back(LegacyFirstIteration());
+  }
+
+  // A channel per byte, as before, but backed by the pool.
+  for (int i = 0; i < kBytes; ++i) {
+    auto start = Clock::now();
+    CacheSideChannel sidechannel;
+    FirstIteration(sidechannel);
+    pooled.push_back(Microseconds(Clock::now() - start));
+  }
+
+  // One channel for all bytes, as the demos do now.
+  CacheSideChannel sidechannel;
+  for (int i = 0; i < kBytes; ++i) {
+    auto start = Clock::now();
+    FirstIteration(sidechannel);
+    reused.push_back(Microseconds(Clock::now() - start));
+  }
+
+  Report("fresh_heap", legacy);
+  Report("pooled", pooled);
+  Report("reused", reused);
+}
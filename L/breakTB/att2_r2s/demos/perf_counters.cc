@@ -0,0 +1,258 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#include "perf_counters.h"
+
+#include "compiler_specifics.h"
+
+#if SAFESIDE_X64 || SAFESIDE_IA32
+#include "cpu_features.h"
+#include "instr.h"
+#endif
+
+#if SAFESIDE_LINUX
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace {
+
+#if SAFESIDE_LINUX
+// Whether the raw Intel events below mean what we think: an Intel CPU with
+// architectural performance monitoring version 3 (Nehalem) or later. Other
+// vendors assign the same event numbers to other events.
+bool HasIntelRawEvents() {
+#  if SAFESIDE_X64 || SAFESIDE_IA32
+  uint32_t regs[4];
+  Cpuid(0, 0, regs);
+  // "GenuineIntel", spelled out in EBX, EDX, ECX.
+  if (regs[1] != 0x756e6547 || regs[3] != 0x49656e69 ||
+      regs[2] != 0x6c65746e) {
+    return false;
+  }
+  Cpuid(0xa, 0, regs);
+  return (regs[0] & 0xff) >= 3;
+#  else
+  return false;
+#  endif
+}
+
+// Fills `attr` for `event`. Returns false if the event can't be counted on
+// this CPU.
+bool EventAttributes(PerfEvent event, perf_event_attr *attr) {
+  switch (event) {
+    case PerfEvent::kBranchMisses:
+      attr->type = PERF_TYPE_HARDWARE;
+      attr->config = PERF_COUNT_HW_BRANCH_MISSES;
+      return true;
+    case PerfEvent::kConditionalBranchMisses:
+      // Event 0xc5, umask 0x01. Ice Lake and later count only taken
+      // conditional branches with this umask.
+      attr->type = PERF_TYPE_RAW;
+      attr->config = 0x01c5;
+      return HasIntelRawEvents();
+    case PerfEvent::kL1dReadMisses:
+      attr->type = PERF_TYPE_HW_CACHE;
+      attr->config = PERF_COUNT_HW_CACHE_L1D |
+                     (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                     (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+      return true;
+    case PerfEvent::kMachineClears:
+      // Event 0xc3, umask 0x01.
+      attr->type = PERF_TYPE_RAW;
+      attr->config = 0x01c3;
+      return HasIntelRawEvents();
+  }
+  return false;
+}
+
+#endif
+
+}  // namespace
+
+#if SAFESIDE_LINUX && (SAFESIDE_X64 || SAFESIDE_IA32)
+// Follows the protocol in linux/perf_event.h: retry while the kernel updates
+// the page, and add the count the kernel has accumulated while the event
+// wasn't on the PMU.
+uint64_t ReadPerfEventWithRdpmc(const void *mmap_page) {
+  auto *page = static_cast<const perf_event_mmap_page *>(mmap_page);
+  uint32_t sequence;
+  uint64_t count;
+  do {
+    sequence = page->lock;
+    asm volatile("" ::: "memory");
+    count = page->offset;
+    uint32_t index = page->index;
+    if (page->cap_user_rdpmc && index != 0) {
+      int shift = 64 - page->pmc_width;
+      int64_t value = static_cast<int64_t>(__rdpmc(index - 1) << shift);
+      count += value >> shift;
+    }
+    asm volatile("" ::: "memory");
+  } while (page->lock != sequence);
+  return count;
+}
+#endif
+
+const char *PerfEventName(PerfEvent event) {
+  switch (event) {
+    case PerfEvent::kBranchMisses:
+      return "branch_misses";
+    case PerfEvent::kConditionalBranchMisses:
+      return "conditional_branch_misses";
+    case PerfEvent::kL1dReadMisses:
+      return "l1d_read_misses";
+    case PerfEvent::kMachineClears:
+      return "machine_clears";
+  }
+  return "unknown";
+}
+
+PerfCounterGroup::PerfCounterGroup() {
+#if SAFESIDE_LINUX
+  int leader = -1;
+  int first_errno = 0;
+  for (size_t i = 0; i < kPerfEvents; ++i) {
+    PerfEvent event = static_cast<PerfEvent>(i);
+    perf_event_attr attr = {};
+    attr.size = sizeof(attr);
+    if (!EventAttributes(event, &attr)) {
+      continue;
+    }
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    int fd = syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+    if (fd < 0) {
+      if (first_errno == 0) {
+        first_errno = errno;
+      }
+      continue;
+    }
+    if (leader < 0) {
+      leader = fd;
+    }
+    void *page = mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED,
+                      fd, 0);
+    events_.push_back({event, fd, page == MAP_FAILED ? nullptr : page});
+  }
+
+  if (events_.empty()) {
+    error_ = std::string("perf_event_open failed: ") +
+             (first_errno == 0 ? "no event applies to this CPU"
+                               : strerror(first_errno));
+    return;
+  }
+
+#  if SAFESIDE_X64 || SAFESIDE_IA32
+  uses_rdpmc_ = true;
+  for (const Event &event : events_) {
+    auto *page = static_cast<const perf_event_mmap_page *>(event.page);
+    if (page == nullptr || !page->cap_user_rdpmc) {
+      uses_rdpmc_ = false;
+    }
+  }
+#  endif
+#else
+  error_ = "perf_event_open requires Linux";
+#endif
+}
+
+PerfCounterGroup::~PerfCounterGroup() {
+#if SAFESIDE_LINUX
+  // Members before the leader.
+  for (auto it = events_.rbegin(); it != events_.rend(); ++it) {
+    if (it->page != nullptr) {
+      munmap(it->page, sysconf(_SC_PAGESIZE));
+    }
+    close(it->fd);
+  }
+#endif
+}
+
+bool PerfCounterGroup::Counts(PerfEvent event) const {
+  for (const Event &counted : events_) {
+    if (counted.event == event) {
+      return true;
+    }
+  }
+  return false;
+}
+
+PerfCounts PerfCounterGroup::Read() const {
+  PerfCounts counts;
+#if SAFESIDE_LINUX
+  if (events_.empty()) {
+    return counts;
+  }
+
+#  if SAFESIDE_X64 || SAFESIDE_IA32
+  if (uses_rdpmc_) {
+    for (const Event &event : events_) {
+      counts.values[static_cast<size_t>(event.event)] =
+          ReadPerfEventWithRdpmc(event.page);
+    }
+    return counts;
+  }
+#  endif
+
+  // PERF_FORMAT_GROUP: the number of events, then their values in the order
+  // they joined the group.
+  uint64_t buffer[1 + kPerfEvents];
+  if (read(events_[0].fd, buffer, sizeof(buffer)) <= 0) {
+    return counts;
+  }
+  for (size_t i = 0; i < events_.size() && i < buffer[0]; ++i) {
+    counts.values[static_cast<size_t>(events_[i].event)] = buffer[1 + i];
+  }
+#endif
+  return counts;
+}
+
+const char *ExperimentPhaseName(ExperimentPhase phase) {
+  switch (phase) {
+    case ExperimentPhase::kTrain:
+      return "train";
+    case ExperimentPhase::kTrigger:
+      return "trigger";
+    case ExperimentPhase::kProbe:
+      return "probe";
+  }
+  return "unknown";
+}
+
+void PhaseCounters::Mark(ExperimentPhase phase) {
+  PerfCounts now = group_.Read();
+  if (running_) {
+    AddSinceMark(now);
+  }
+  phase_ = phase;
+  marked_[static_cast<size_t>(phase)] = true;
+  running_ = true;
+  start_ = now;
+}
+
+void PhaseCounters::Stop() {
+  if (running_) {
+    AddSinceMark(group_.Read());
+    running_ = false;
+  }
+}
+
+void PhaseCounters::AddSinceMark(const PerfCounts &now) {
+  PerfCounts &counts = counts_[static_cast<size_t>(phase_)];
+  for (size_t i = 0; i < kPerfEvents; ++i) {
+    counts.values[i] += now.values[i] - start_.values[i];
+  }
+}
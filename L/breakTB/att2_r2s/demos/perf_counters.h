@@ -0,0 +1,206 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#ifndef DEMOS_PERF_COUNTERS_H_
+#define DEMOS_PERF_COUNTERS_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "trace.h"
+
+// Hardware events that tell why a run of an experiment failed: whether the
+// victim branch was mispredicted at all, and whether the oracle lines were
+// lost or the speculation was squashed early.
+enum class PerfEvent {
+  // Mispredicted branches of any kind, the generic perf "branch-misses".
+  kBranchMisses,
+  // Retired mispredicted conditional branches, BR_MISP_RETIRED.CONDITIONAL.
+  // Intel only.
+  kConditionalBranchMisses,
+  // L1 data cache read misses.
+  kL1dReadMisses,
+  // Pipeline flushes other than branch mispredictions, e.g. memory ordering
+  // violations and self-modifying code, MACHINE_CLEARS.COUNT. Intel only.
+  kMachineClears,
+};
+
+constexpr size_t kPerfEvents = 4;
+
+// "branch_misses", "conditional_branch_misses", "l1d_read_misses" or
+// "machine_clears".
+const char *PerfEventName(PerfEvent event);
+
+// Counts of every PerfEvent, indexed by the enum value. Events that aren't
+// counted stay zero.
+struct PerfCounts {
+  std::array<uint64_t, kPerfEvents> values = {};
+
+  uint64_t operator[](PerfEvent event) const {
+    return values[static_cast<size_t>(event)];
+  }
+
+  PerfCounts &operator+=(const PerfCounts &other) {
+    for (size_t i = 0; i < kPerfEvents; ++i) {
+      values[i] += other.values[i];
+    }
+    return *this;
+  }
+};
+
+// A perf_event group counting the PerfEvents in user space on the thread
+// that created it. Reads take RDPMC where the kernel allows it and one read()
+// system call otherwise.
+//
+// The PMU is often missing, e.g. in virtual machines, or perf events are
+// forbidden by perf_event_paranoid. The group then counts nothing, Read
+// returns zeros and error() tells why. Events the CPU doesn't have are left
+// out of the group, the others are still counted.
+class PerfCounterGroup {
+ public:
+  PerfCounterGroup();
+  ~PerfCounterGroup();
+
+  PerfCounterGroup(const PerfCounterGroup &) = delete;
+  PerfCounterGroup &operator=(const PerfCounterGroup &) = delete;
+
+  // True iff at least one event is counted.
+  bool available() const { return !events_.empty(); }
+  // Why no event is counted. Empty if available.
+  const std::string &error() const { return error_; }
+
+  bool Counts(PerfEvent event) const;
+  // True iff reads take RDPMC instead of a system call.
+  bool uses_rdpmc() const { return uses_rdpmc_; }
+
+  // Current counts since the group was created. Must be called on the thread
+  // that created the group.
+  PerfCounts Read() const;
+
+ private:
+  struct Event {
+    PerfEvent event;
+    int fd;
+    // The mmapped perf_event_mmap_page of `fd`, or nullptr.
+    void *page;
+  };
+
+  std::vector<Event> events_;
+  std::string error_;
+  bool uses_rdpmc_ = false;
+};
+
+// Reads the event behind `mmap_page`, its mmapped perf_event_mmap_page, with
+// RDPMC. The event must count the calling thread and the kernel must allow
+// user-space RDPMC for it (cap_user_rdpmc). Linux on x86 only.
+uint64_t ReadPerfEventWithRdpmc(const void *mmap_page);
+
+// Phases of a run of an experiment. Demos mark where each begins with
+// MarkPhase. Where the mispredicted branch is the last iteration of the
+// training loop it can't be separated from it without changing the branch
+// history, and the trigger is never marked but counted in kTrain.
+enum class ExperimentPhase {
+  // Mistraining the predictor.
+  kTrain,
+  // Causing the misprediction or fault that leaks the secret.
+  kTrigger,
+  // Reading the secret back from the side channel.
+  kProbe,
+};
+
+constexpr size_t kExperimentPhases = 3;
+
+static_assert(static_cast<int>(ExperimentPhase::kProbe) ==
+                  static_cast<int>(TracePhase::kProbe),
+              "MarkPhase passes ExperimentPhases on as TracePhases");
+
+// "train", "trigger" or "probe".
+const char *ExperimentPhaseName(ExperimentPhase phase);
+
+// Accumulates the events of a PerfCounterGroup per ExperimentPhase over any
+// number of runs:
+//
+//     PhaseCounters counters(group);
+//     {
+//       PhaseCounters::Scope scope(&counters);
+//       demo->run(context);
+//     }
+//     counters.counts(ExperimentPhase::kProbe)[PerfEvent::kL1dReadMisses]
+//
+// Marks outside of a Scope cost a thread-local load and a branch.
+class PhaseCounters {
+ public:
+  explicit PhaseCounters(const PerfCounterGroup &group) : group_(group) {}
+
+  // Adds the events since the last Mark to the phase that it started and
+  // starts `phase`.
+  void Mark(ExperimentPhase phase);
+  // Adds the events since the last Mark to the phase that it started. Events
+  // until the next Mark aren't counted.
+  void Stop();
+
+  const PerfCounts &counts(ExperimentPhase phase) const {
+    return counts_[static_cast<size_t>(phase)];
+  }
+  // Whether `phase` was marked at all. The counts of a phase that wasn't are
+  // zero, but not because it caused no events.
+  bool marked(ExperimentPhase phase) const {
+    return marked_[static_cast<size_t>(phase)];
+  }
+  const PerfCounterGroup &group() const { return group_; }
+
+  // MarkPhase and StopPhases on this thread go to `counters` while the scope
+  // exists. Scopes don't nest.
+  class Scope {
+   public:
+    explicit Scope(PhaseCounters *counters) { active_ = counters; }
+    ~Scope() { active_ = nullptr; }
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+  };
+
+  static PhaseCounters *active() { return active_; }
+
+ private:
+  // Adds `now` minus the counts at the last Mark to the current phase.
+  void AddSinceMark(const PerfCounts &now);
+
+  const PerfCounterGroup &group_;
+  std::array<PerfCounts, kExperimentPhases> counts_;
+  std::array<bool, kExperimentPhases> marked_ = {};
+  ExperimentPhase phase_ = ExperimentPhase::kTrain;
+  bool running_ = false;
+  PerfCounts start_;
+
+  // Inline so that the constant initializer is visible to every MarkPhase
+  // and no TLS wrapper is called.
+  static inline thread_local PhaseCounters *active_ = nullptr;
+};
+
+// Starts `phase` of the current run.
+inline void MarkPhase(ExperimentPhase phase) {
+  SAFESIDE_TRACE_MARK(static_cast<TracePhase>(phase));
+  if (PhaseCounters *counters = PhaseCounters::active()) {
+    counters->Mark(phase);
+  }
+}
+
+// Ends the last phase of the current run. Called by RunExperiment.
+inline void StopPhases() {
+  SAFESIDE_TRACE_STOP_MARKS();
+  if (PhaseCounters *counters = PhaseCounters::active()) {
+    counters->Stop();
+  }
+}
+
+#endif  // DEMOS_PERF_COUNTERS_H_
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#include "perf_counters.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace {
+
+int failures = 0;
+
+void Expect(bool condition, const char *what) {
+  if (!condition) {
+    std::cout << "Failed: " << what << std::endl;
+    ++failures;
+  }
+}
+
+// Volatile so that the branches on it aren't if-converted.
+volatile unsigned sink = 0;
+
+// Branches on a pseudo-random bit, mispredicting about half of the time.
+void MispredictBranches(int count) {
+  unsigned state = 12345;
+  for (int i = 0; i < count; ++i) {
+    state = state * 1103515245 + 12345;
+    if ((state >> 16) & 1) {
+      sink = sink + 1;
+    } else {
+      sink = sink - 1;
+    }
+  }
+}
+
+}  // namespace
+
+// Checks that phases get the events caused in them and none of the events
+// outside of them. Where the host has no PMU, checks that the group says why
+// and counts nothing.
+int main(int argc, char* argv[]) {
+  Expect(std::string(PerfEventName(PerfEvent::kMachineClears)) ==
+             "machine_clears",
+         "event names");
+  Expect(std::string(ExperimentPhaseName(ExperimentPhase::kProbe)) == "probe",
+         "phase names");
+
+  PerfCounterGroup group;
+  PhaseCounters counters(group);
+  {
+    PhaseCounters::Scope scope(&counters);
+    MarkPhase(ExperimentPhase::kTrain);
+    MispredictBranches(100000);
+    MarkPhase(ExperimentPhase::kProbe);
+    StopPhases();
+    // Not counted.
+    MispredictBranches(100000);
+  }
+  // Not counted either.
+  MarkPhase(ExperimentPhase::kTrigger);
+  MispredictBranches(100000);
+  StopPhases();
+
+  const PerfCounts &train = counters.counts(ExperimentPhase::kTrain);
+  const PerfCounts &trigger = counters.counts(ExperimentPhase::kTrigger);
+  const PerfCounts &probe = counters.counts(ExperimentPhase::kProbe);
+  Expect(counters.marked(ExperimentPhase::kTrain) &&
+             counters.marked(ExperimentPhase::kProbe),
+         "phases marked in the scope");
+  Expect(!counters.marked(ExperimentPhase::kTrigger),
+         "phase marked outside of the scope");
+  if (!group.available()) {
+    std::cout << "No hardware events: " << group.error() << std::endl;
+    Expect(!group.error().empty(), "error of an unavailable group");
+    Expect(train[PerfEvent::kBranchMisses] == 0 &&
+               probe[PerfEvent::kBranchMisses] == 0,
+           "no counts without events");
+  } else if (group.Counts(PerfEvent::kBranchMisses)) {
+    std::cout << "Reading with " << (group.uses_rdpmc() ? "rdpmc" : "read()")
+              << std::endl;
+    // 50000 expected in the training; a bit of the loop overhead in the
+    // probe; nothing in the trigger, which was marked outside of the scope.
+    Expect(train[PerfEvent::kBranchMisses] > 25000, "misses in the phase");
+    Expect(probe[PerfEvent::kBranchMisses] < 1000,
+           "no misses after the phase stopped");
+    Expect(trigger[PerfEvent::kBranchMisses] == 0,
+           "no misses outside of the scope");
+  }
+
+  bool pass = failures == 0;
+  std::cout << (pass ? "pass" : "fail") << std::endl;
+  return !pass;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "asm/measurereadlatency.h"
+#include "instr.h"
+#include "timing_array.h"
+#include "utils.h"
+
+namespace {
+
+constexpr int kPasses = 2000;
+
+using Clock = std::chrono::steady_clock;
+using Latencies = std::array<uint64_t, TimingArray::kRealElements>;
+
+// The probe pass as it was before the batched kernel: one call per element.
+void ProbeEachElement(TimingArray &ta, Latencies &latencies) {
+  for (size_t i = 0; i < ta.size(); ++i) {
+    latencies[i] = MeasureReadLatency(&ta[i]);
+  }
+}
+
+void ProbeBatched(TimingArray &ta, Latencies &latencies) {
+  ta.ProbeAll(latencies);
+}
+
+// Brings the whole array into the cache, so the pass cost is mostly the
+// timing overhead rather than memory latency.
+void WarmUp(TimingArray &ta) {
+  for (size_t i = 0; i < ta.size(); ++i) {
+    ForceRead(&ta[i]);
+  }
+}
+
+void FlushAll(TimingArray &ta) {
+  ta.FlushFromCache();
+}
+
+template <typename Probe, typename Prepare>
+void Report(const char *name, TimingArray &ta, Probe probe, Prepare prepare) {
+  std::vector<double> pass_ns;
+  std::vector<uint64_t> median_latencies;
+  Latencies latencies;
+
+  for (int n = 0; n < kPasses; ++n) {
+    prepare(ta);
+    auto start = Clock::now();
+    probe(ta, latencies);
+    pass_ns.push_back(
+        std::chrono::duration<double, std::nano>(Clock::now() - start)
+            .count());
+    std::nth_element(latencies.begin(), latencies.begin() + 128,
+                     latencies.end());
+    median_latencies.push_back(latencies[128]);
+  }
+
+  std::sort(pass_ns.begin(), pass_ns.end());
+  std::sort(median_latencies.begin(), median_latencies.end());
+  std::cout << std::left << std::setw(18) << name << std::right << std::fixed
+            << std::setprecision(0) << "pass median " << std::setw(8)
+            << pass_ns[kPasses / 2] << " ns  p95 " << std::setw(8)
+            << pass_ns[kPasses * 95 / 100] << " ns  median read "
+            << median_latencies[kPasses / 2] << std::endl;
+}
+
+}  // namespace
+
+// Compares the cost of a full 256-element probe pass made of individual
+// MeasureReadLatency calls with one made by a single MeasureReadLatencyBatch
+// call, with the array in cache and flushed. The median read latency column
+// checks that both measure the same thing.
+int main() {
+  TimingArray ta;
+
+  Report("each/cached", ta, ProbeEachElement, WarmUp);
+  Report("batched/cached", ta, ProbeBatched, WarmUp);
+  Report("each/flushed", ta, ProbeEachElement, FlushAll);
+  Report("batched/flushed", ta, ProbeBatched, FlushAll);
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#include "quantile_estimator.h"
+
+#include <algorithm>
+
+P2QuantileEstimator::P2QuantileEstimator(double quantile)
+    : quantile_(quantile) {
+  Reset();
+}
+
+void P2QuantileEstimator::Reset() {
+  count_ = 0;
+  heights_.fill(0);
+  positions_ = {1, 2, 3, 4, 5};
+  desired_positions_ = {1, 1 + 2 * quantile_, 1 + 4 * quantile_,
+                        3 + 2 * quantile_, 5};
+  increments_ = {0, quantile_ / 2, quantile_, (1 + quantile_) / 2, 1};
+}
+
+void P2QuantileEstimator::Add(double value) {
+  // The first five values initialize the markers.
+  if (count_ < 5) {
+    heights_[count_++] = value;
+    if (count_ == 5) {
+      std::sort(heights_.begin(), heights_.end());
+    }
+    return;
+  }
+  ++count_;
+
+  // Find the cell containing the value, extending the extremes if needed.
+  int cell;
+  if (value < heights_[0]) {
+    heights_[0] = value;
+    cell = 0;
+  } else if (value >= heights_[4]) {
+    heights_[4] = value;
+    cell = 3;
+  } else {
+    cell = 0;
+    while (value >= heights_[cell + 1]) {
+      ++cell;
+    }
+  }
+
+  for (int i = cell + 1; i < 5; ++i) {
+    positions_[i] += 1;
+  }
+  for (int i = 0; i < 5; ++i) {
+    desired_positions_[i] += increments_[i];
+  }
+
+  // Move the three inner markers by at most one position each.
+  for (int i = 1; i < 4; ++i) {
+    double offset = desired_positions_[i] - positions_[i];
+    if ((offset >= 1 && positions_[i + 1] - positions_[i] > 1) ||
+        (offset <= -1 && positions_[i - 1] - positions_[i] < -1)) {
+      double d = offset > 0 ? 1 : -1;
+      double parabolic =
+          heights_[i] +
+          d / (positions_[i + 1] - positions_[i - 1]) *
+              ((positions_[i] - positions_[i - 1] + d) *
+                   (heights_[i + 1] - heights_[i]) /
+                   (positions_[i + 1] - positions_[i]) +
+               (positions_[i + 1] - positions_[i] - d) *
+                   (heights_[i] - heights_[i - 1]) /
+                   (positions_[i] - positions_[i - 1]));
+      if (heights_[i - 1] < parabolic && parabolic < heights_[i + 1]) {
+        heights_[i] = parabolic;
+      } else {
+        // Fall back to linear interpolation towards the neighbor.
+        int j = i + static_cast<int>(d);
+        heights_[i] += d * (heights_[j] - heights_[i]) /
+                       (positions_[j] - positions_[i]);
+      }
+      positions_[i] += d;
+    }
+  }
+}
+
+double P2QuantileEstimator::Estimate() const {
+  if (count_ == 0) {
+    return 0;
+  }
+  if (count_ < 5) {
+    std::array<double, 5> values = heights_;
+    std::sort(values.begin(), values.begin() + count_);
+    return values[static_cast<size_t>(quantile_ * (count_ - 1))];
+  }
+  return heights_[2];
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#ifndef DEMOS_QUANTILE_ESTIMATOR_H_
+#define DEMOS_QUANTILE_ESTIMATOR_H_
+
+#include <array>
+#include <cstdint>
+
+// Estimates one quantile of a stream of values in constant memory with the P²
+// algorithm of Jain and Chlamtac[1]. Five markers track the minimum, the
+// maximum, the target quantile and the two quantiles halfway to either end;
+// each new value moves the markers towards their ideal positions with a
+// piecewise-parabolic interpolation.
+//
+// Adding a value is O(1) and never allocates, so the estimator can be fed from
+// inside measurement loops.
+//
+// [1] R. Jain and I. Chlamtac, "The P² algorithm for dynamic calculation of
+//   quantiles and histograms without storing observations", CACM 28(10), 1985.
+class P2QuantileEstimator {
+ public:
+  // `quantile` must be in (0, 1), e.g. 0.5 for the median.
+  explicit P2QuantileEstimator(double quantile);
+
+  void Add(double value);
+
+  // Current estimate. Exact while fewer than five values have been added,
+  // zero if none has.
+  double Estimate() const;
+
+  uint64_t count() const { return count_; }
+
+  // Forgets all values added so far.
+  void Reset();
+
+ private:
+  double quantile_;
+  uint64_t count_;
+  // Marker heights and actual and desired marker positions (1-based).
+  std::array<double, 5> heights_;
+  std::array<double, 5> positions_;
+  std::array<double, 5> desired_positions_;
+  std::array<double, 5> increments_;
+};
+
+#endif  // DEMOS_QUANTILE_ESTIMATOR_H_
@@ -0,0 +1,53 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#include "quantile_estimator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+// Feeds latency-like streams (a hard minimum and a long right tail) into the
+// estimator and checks that its estimate ranks within two percentiles of the
+// requested quantile.
+int main(int argc, char* argv[]) {
+  const double quantiles[] = {0.1, 0.5, 0.9};
+  const int values = 20000;
+  int failures = 0;
+
+  for (double quantile : quantiles) {
+    for (int trial = 0; trial < 10; ++trial) {
+      P2QuantileEstimator estimator(quantile);
+      std::vector<double> stream;
+      for (int n = 0; n < values; ++n) {
+        // Exponential tail on top of a fixed minimum latency.
+        double uniform = (rand() + 1.0) / (RAND_MAX + 2.0);
+        double value = 40 - 15 * std::log(uniform);
+        stream.push_back(value);
+        estimator.Add(value);
+      }
+
+      double estimate = estimator.Estimate();
+      std::sort(stream.begin(), stream.end());
+      double rank = (std::lower_bound(stream.begin(), stream.end(), estimate) -
+                     stream.begin()) / static_cast<double>(values);
+      if (std::abs(rank - quantile) > 0.02) {
+        std::cout << "Quantile " << quantile << " estimated as " << estimate
+                  << ", which ranks at " << rank << std::endl;
+        ++failures;
+      }
+    }
+  }
+
+  bool pass = failures == 0;
+  std::cout << (pass ? "pass" : "fail") << std::endl;
+  return !pass;
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+// Measures the cost of one Ret2specLeakByte iteration -- flushing the oracle,
+// the ReturnsTrue/ReturnsFalse recursions with their stack flushing and the
+// scoring -- in the same-address-space configuration, in native timer ticks,
+// with the default recursion depth and with the depth measured for this host.
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <vector>
+
+// ret2spec_common.h relies on these.
+#include "cache_sidechannel.h"
+#include "experiment.h"
+#include "ret2spec_common.h"
+#include "utils.h"
+
+namespace {
+
+constexpr int kIterations = 2000;
+
+void NopFunction() {}
+
+void ReturnsFalseRecursion() {
+  ReturnsFalse(recursion_depth);
+}
+
+void Report(CacheSideChannel &sidechannel) {
+  ExperimentBudget budget;
+  budget.max_runs = 1;
+  std::vector<uint64_t> ticks;
+  for (int i = 0; i < kIterations; ++i) {
+    ticks.push_back(Ret2specLeakByte(sidechannel, budget).elapsed_cycles);
+  }
+
+  std::sort(ticks.begin(), ticks.end());
+  std::cout << "depth " << recursion_depth << " iteration median "
+            << ticks[kIterations / 2] << " p95 "
+            << ticks[kIterations * 95 / 100] << std::endl;
+}
+
+}  // namespace
+
+int main() {
+  return_true_base_case = NopFunction;
+  return_false_base_case = ReturnsFalseRecursion;
+#if SAFESIDE_LINUX
+  PinToTheFirstCore();
+#endif
+
+  CacheSideChannel sidechannel;
+  Report(sidechannel);
+  UseMeasuredRecursionDepth();
+  Report(sidechannel);
+}
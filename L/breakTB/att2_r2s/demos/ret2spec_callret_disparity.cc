@@ -12,6 +12,7 @@
 #include <iostream>
 
 #include "cache_sidechannel.h"
+#include "experiment.h"
 #include "instr.h"
 #include "local_content.h"
 #include "utils.h"
@@ -59,11 +60,13 @@ static void Speculation() {
   }
 }
 
-static char LeakByte() {
-  CacheSideChannel sidechannel;
+static ExperimentOutcome LeakByte(CacheSideChannel &sidechannel,
+                                  const ExperimentBudget &budget) {
+  sidechannel.ResetScores();
   oracle_ptr = &sidechannel.GetOracle(); // Save the pointer to global storage.
 
-  for (int run = 0;; ++run) {
+  ExperimentLoop loop(budget);
+  while (true) {
     sidechannel.FlushOracle();
 
 #if SAFESIDE_ARM64 || SAFESIDE_PPC
@@ -89,23 +92,24 @@ static char LeakByte() {
     std::pair<bool, char> result =
         sidechannel.AddHitAndRecomputeScores();
 
-    if (result.first) {
-      return result.second;
-    }
-
-    if (run > 100000) {
-      std::cerr << "Does not converge " << result.second << std::endl;
-      exit(EXIT_FAILURE);
+    if (loop.Done(result)) {
+      return loop.Finish(sidechannel);
     }
   }
 }
 
 int main() {
+  CacheSideChannel sidechannel;
   std::cout << "Leaking the string: ";
   std::cout.flush();
   for (size_t i = 0; i < strlen(private_data); ++i) {
     current_offset = i; // Saving the index to the global storage.
-    std::cout << LeakByte();
+    ExperimentOutcome outcome = LeakByte(sidechannel, ExperimentBudget());
+    if (!outcome.converged) {
+      std::cerr << "Does not converge " << outcome.value << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    std::cout << outcome.value;
     std::cout.flush();
   }
   std::cout << "\nDone!\n";
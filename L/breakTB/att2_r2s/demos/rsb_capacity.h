@@ -0,0 +1,50 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#ifndef DEMOS_RSB_CAPACITY_H_
+#define DEMOS_RSB_CAPACITY_H_
+
+#include <vector>
+
+// Characterizes the return stack buffer (RSB) of the current core by timing
+// call chains of growing depth. Every frame of a chain is a separate function
+// instantiated at compile time, so each return has its own address and
+// target. Up to the RSB capacity all returns are predicted by the RSB; the
+// returns of deeper frames underflow it and, unless the CPU falls back to
+// another predictor, mispredict. The knee of the cost per frame is the
+// capacity estimate.
+
+// Deepest chain measured.
+constexpr int kMaxRsbSweepDepth = 96;
+
+struct RsbSweepPoint {
+  int depth;
+  // Median native timer ticks of one call of the chain, all returns included.
+  double ticks;
+  // Ticks added by the deepest frame compared to the chain one shorter.
+  double marginal_ticks;
+  // Estimated fraction of the chain's returns that were predicted, from how
+  // much the chain costs more than predicted frames alone would. 1 if the
+  // sweep shows no knee.
+  double hit_rate;
+};
+
+// Measures chains of depth 1 to kMaxRsbSweepDepth.
+std::vector<RsbSweepPoint> SweepRsbDepths();
+
+// Depth after which frames become markedly more expensive than the shallow
+// ones, or 0 if the sweep shows no such knee (e.g. because underflowed returns
+// are predicted from the BTB).
+int EstimateRsbCapacity(const std::vector<RsbSweepPoint> &sweep);
+
+// EstimateRsbCapacity of a fresh sweep, persisted in the calibration cache
+// (see calibration_cache.h) under the identity of the current CPU.
+int RsbCapacity();
+
+#endif  // DEMOS_RSB_CAPACITY_H_
@@ -0,0 +1,43 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+// Characterizes the return stack buffer of this host (see rsb_capacity.h):
+// prints "<depth> <ticks per chain call> <marginal ticks> <hit rate>" per
+// chain depth, then the estimated capacity, which it also stores in the
+// calibration cache for the ret2spec demos to size their recursion with.
+
+#include <iomanip>
+#include <iostream>
+
+#include "calibration_cache.h"
+#include "rsb_capacity.h"
+#include "utils.h"
+
+int main() {
+#if SAFESIDE_LINUX
+  PinToTheFirstCore();
+#endif
+
+  std::vector<RsbSweepPoint> sweep = SweepRsbDepths();
+  std::cout << std::fixed << std::setprecision(2);
+  for (const RsbSweepPoint &point : sweep) {
+    std::cout << std::setw(3) << point.depth << " " << std::setw(9)
+              << point.ticks << " " << std::setw(8) << point.marginal_ticks
+              << " " << point.hit_rate << std::endl;
+  }
+
+  int capacity = EstimateRsbCapacity(sweep);
+  StoreCalibration("rsb_capacity", capacity);
+  if (capacity == 0) {
+    std::cout << "No knee up to depth " << kMaxRsbSweepDepth
+              << ", RSB capacity unknown." << std::endl;
+  } else {
+    std::cout << "Estimated RSB capacity " << capacity << std::endl;
+  }
+}
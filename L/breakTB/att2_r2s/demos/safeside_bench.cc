@@ -0,0 +1,312 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+// Measures how fast and how reliably the registered demos leak, so that
+// changes to the support library can be compared run over run.
+//
+// Usage: safeside_bench [--repetitions=N] [--max-runs=N] [--output=FILE]
+//                       [--baseline=FILE] [demo...]
+//
+// Runs every selected demo (all registered ones by default) N times in this
+// process, pinned to the first core, and reports per demo:
+//   - median and p95 runs-to-converge over all leaked bytes,
+//   - median wall time per recovered byte over the repetitions,
+//   - the byte error rate (wrong or unconverged bytes) with a 95% Wilson
+//     score interval,
+// followed by the cost of one probe pass (RecomputeScores of a flushed oracle)
+// and one flush pass (FlushOracle of a cached oracle) of the shared
+// CacheSideChannel.
+//
+// The results are written as JSON lines to FILE (safeside_bench.json by
+// default, nothing if empty). With --baseline, the same metrics of an earlier
+// result file are printed next to the current ones.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "compiler_specifics.h"
+#include "demo_registry.h"
+#include "experiment.h"
+#include "leak_metrics.h"
+#include "timer_backend.h"
+#include "utils.h"
+
+namespace {
+
+// Nearest-rank percentile of `values`, which must not be empty.
+template <typename T>
+T Percentile(std::vector<T> values, double percentile) {
+  std::sort(values.begin(), values.end());
+  size_t rank = static_cast<size_t>(std::ceil(percentile * values.size()));
+  return values[rank == 0 ? 0 : rank - 1];
+}
+
+// Collects the outcome of every byte over all repetitions of one demo.
+class BenchDemoContext : public DemoContext {
+ public:
+  std::vector<int> runs;
+  std::vector<double> ns_per_byte;
+  uint64_t bytes = 0;
+  uint64_t errors = 0;
+
+  void Clear() {
+    runs.clear();
+    ns_per_byte.clear();
+    bytes = 0;
+    errors = 0;
+  }
+
+ protected:
+  void OnBeginLeak(const std::string &expected) override {
+    expected_ = expected;
+    recovered_ = 0;
+    start_ = std::chrono::steady_clock::now();
+  }
+
+  void OnByte(const ExperimentOutcome &outcome) override {
+    size_t index = recovered_++;
+    runs.push_back(outcome.runs);
+    if (!outcome.converged || index >= expected_.size() ||
+        outcome.value != expected_[index]) {
+      ++errors;
+    }
+  }
+
+  void OnEndLeak() override {
+    double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start_)
+                    .count();
+    // Bytes the demo never got to because an earlier one didn't converge
+    // count as errors too.
+    if (recovered_ < expected_.size()) {
+      errors += expected_.size() - recovered_;
+    }
+    bytes += std::max(expected_.size(), recovered_);
+    if (recovered_ > 0) {
+      ns_per_byte.push_back(ns / recovered_);
+    }
+  }
+
+ private:
+  std::string expected_;
+  size_t recovered_ = 0;
+  std::chrono::steady_clock::time_point start_;
+};
+
+// One line of the result file: a name and numeric metrics.
+struct Result {
+  std::string name;
+  std::map<std::string, double> metrics;
+
+  std::string Json() const {
+    std::ostringstream out;
+    out << std::setprecision(6) << "{\"name\": \"" << name << "\"";
+    for (const auto &metric : metrics) {
+      out << ", \"" << metric.first << "\": " << metric.second;
+    }
+    out << "}";
+    return out.str();
+  }
+};
+
+// Reads a file written by Result::Json. Only understands that format.
+std::map<std::string, Result> ReadResults(const std::string &path) {
+  std::map<std::string, Result> results;
+  std::ifstream in(path);
+  std::string line;
+  while (std::getline(in, line)) {
+    Result result;
+    size_t position = 0;
+    while ((position = line.find('"', position)) != std::string::npos) {
+      size_t end = line.find('"', position + 1);
+      if (end == std::string::npos) {
+        break;
+      }
+      std::string key = line.substr(position + 1, end - position - 1);
+      size_t value = line.find_first_not_of(": ", end + 1);
+      if (value == std::string::npos) {
+        break;
+      }
+      if (line[value] == '"') {
+        size_t value_end = line.find('"', value + 1);
+        result.name = line.substr(value + 1, value_end - value - 1);
+        position = value_end + 1;
+      } else {
+        result.metrics[key] = strtod(line.c_str() + value, nullptr);
+        position = line.find_first_of(",}", value);
+      }
+    }
+    if (!result.name.empty()) {
+      results[result.name] = result;
+    }
+  }
+  return results;
+}
+
+Result BenchmarkDemo(const Demo &demo, int repetitions, int max_runs,
+                     BenchDemoContext &context) {
+  context.Clear();
+  context.set_max_runs(max_runs);
+  for (int i = 0; i < repetitions; ++i) {
+    demo.run(context);
+  }
+
+  Result result;
+  result.name = demo.name;
+  auto interval = WilsonInterval(context.errors, context.bytes);
+  result.metrics["bytes"] = context.bytes;
+  result.metrics["error_rate"] =
+      context.bytes == 0 ? 0 : static_cast<double>(context.errors) /
+                                   context.bytes;
+  result.metrics["error_rate_ci_low"] = interval.first;
+  result.metrics["error_rate_ci_high"] = interval.second;
+  if (!context.runs.empty()) {
+    result.metrics["runs_median"] = Percentile(context.runs, 0.5);
+    result.metrics["runs_p95"] = Percentile(context.runs, 0.95);
+  }
+  if (!context.ns_per_byte.empty()) {
+    result.metrics["ns_per_byte_median"] =
+        Percentile(context.ns_per_byte, 0.5);
+  }
+  return result;
+}
+
+// Median cost of `pass` in native timer ticks and nanoseconds. `prepare` sets
+// up the cache state before every sample, outside of the timed region.
+template <typename Prepare, typename Pass>
+Result BenchmarkPass(const char *name, Prepare prepare, Pass pass) {
+  constexpr int kIterations = 1000;
+  const TimerBackend &timer = NativeTimerBackend();
+  std::vector<uint64_t> ticks;
+  std::vector<double> nanoseconds;
+  for (int i = 0; i < kIterations; ++i) {
+    prepare();
+    auto start_time = std::chrono::steady_clock::now();
+    uint64_t start = timer.Now();
+    pass();
+    ticks.push_back(timer.Now() - start);
+    nanoseconds.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              std::chrono::steady_clock::now() - start_time)
+                              .count());
+  }
+  Result result;
+  result.name = name;
+  result.metrics["cycles_median"] = Percentile(ticks, 0.5);
+  result.metrics["ns_median"] = Percentile(nanoseconds, 0.5);
+  return result;
+}
+
+void PrintResult(const Result &result, const Result *baseline) {
+  std::cout << result.name << ":\n";
+  for (const auto &metric : result.metrics) {
+    std::cout << "  " << std::left << std::setw(20) << metric.first
+              << std::right << std::setw(14) << metric.second;
+    if (baseline != nullptr) {
+      auto it = baseline->metrics.find(metric.first);
+      if (it != baseline->metrics.end()) {
+        std::cout << "  (baseline " << it->second << ")";
+      }
+    }
+    std::cout << "\n";
+  }
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  int repetitions = 5;
+  int max_runs = ExperimentBudget().max_runs;
+  std::string output = "safeside_bench.json";
+  std::string baseline_path;
+  std::vector<const Demo *> selected;
+  for (int i = 1; i < argc; ++i) {
+    std::string argument = argv[i];
+    std::string value;
+    if (FlagValue(argument, "repetitions", &value)) {
+      repetitions = atoi(value.c_str());
+    } else if (FlagValue(argument, "max-runs", &value)) {
+      max_runs = atoi(value.c_str());
+    } else if (FlagValue(argument, "output", &value)) {
+      output = value;
+    } else if (FlagValue(argument, "baseline", &value)) {
+      baseline_path = value;
+    } else {
+      const Demo *demo = FindDemo(argument);
+      if (demo == nullptr) {
+        std::cerr << "Unknown demo " << argument << std::endl;
+        return EXIT_FAILURE;
+      }
+      selected.push_back(demo);
+    }
+  }
+  if (selected.empty()) {
+    for (const Demo &demo : RegisteredDemos()) {
+      selected.push_back(&demo);
+    }
+  }
+
+#if SAFESIDE_LINUX
+  PinToTheFirstCore();
+#endif
+
+  std::vector<Result> results;
+  BenchDemoContext context;
+  for (const Demo *demo : selected) {
+    results.push_back(BenchmarkDemo(*demo, repetitions, max_runs, context));
+  }
+
+  // Each pass is timed in the cache state the demos run it in: the probe
+  // reads a flushed oracle and the flush evicts a cached one.
+  CacheSideChannel &sidechannel = context.sidechannel();
+  results.push_back(BenchmarkPass(
+      "probe_pass", [&sidechannel] { sidechannel.FlushOracle(); },
+      [&sidechannel] { sidechannel.RecomputeScores(0); }));
+  results.push_back(BenchmarkPass(
+      "flush_pass",
+      [&sidechannel] {
+        for (const BigByte &entry : sidechannel.GetOracle()) {
+          ForceRead(&entry);
+        }
+      },
+      [&sidechannel] { sidechannel.FlushOracle(); }));
+  sidechannel.ResetScores();
+
+  std::map<std::string, Result> baseline;
+  if (!baseline_path.empty()) {
+    baseline = ReadResults(baseline_path);
+    if (baseline.empty()) {
+      std::cerr << "No results in " << baseline_path << std::endl;
+    }
+  }
+  for (const Result &result : results) {
+    auto it = baseline.find(result.name);
+    PrintResult(result, it == baseline.end() ? nullptr : &it->second);
+  }
+
+  if (!output.empty()) {
+    std::ofstream out(output, std::ios::trunc);
+    for (const Result &result : results) {
+      out << result.Json() << "\n";
+    }
+    if (!out) {
+      std::cerr << "Writing " << output << " failed." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+}
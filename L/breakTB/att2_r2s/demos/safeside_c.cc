@@ -0,0 +1,273 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#include "safeside_c.h"
+
+#include <array>
+#include <cstring>
+#include <new>
+#include <utility>
+
+#include "asm/measurereadlatency.h"
+#include "cache_sidechannel.h"
+#include "instr.h"
+#include "scorer.h"
+#include "timer_backend.h"
+#include "timing_array.h"
+#include "utils.h"
+
+namespace {
+
+static_assert(sizeof(CacheSideChannel) <=
+                  sizeof(SafesideCacheSideChannel::storage),
+              "raise SAFESIDE_CACHE_SIDE_CHANNEL_STORAGE_BYTES");
+static_assert(alignof(CacheSideChannel) <=
+                  alignof(SafesideCacheSideChannel),
+              "SafesideCacheSideChannel is not aligned enough");
+static_assert(sizeof(TimingArray) <= sizeof(SafesideTimingArray::storage),
+              "raise SAFESIDE_TIMING_ARRAY_STORAGE_BYTES");
+static_assert(alignof(TimingArray) <= alignof(SafesideTimingArray),
+              "SafesideTimingArray is not aligned enough");
+
+static_assert(TimingArray::kRealElements == 256, "latencies are 256 entries");
+
+// The entry for character c must be at a fixed stride from the first one.
+static_assert(sizeof(std::array<BigByte, 256>) == 256 * sizeof(BigByte),
+              "the oracle is not a plain array");
+
+CacheSideChannel &Channel(SafesideCacheSideChannel *channel) {
+  return *std::launder(
+      reinterpret_cast<CacheSideChannel *>(channel->storage.bytes));
+}
+
+const CacheSideChannel &Channel(const SafesideCacheSideChannel *channel) {
+  return *std::launder(
+      reinterpret_cast<const CacheSideChannel *>(channel->storage.bytes));
+}
+
+TimingArray &Array(SafesideTimingArray *array) {
+  return *std::launder(reinterpret_cast<TimingArray *>(array->storage.bytes));
+}
+
+const TimingArray &Array(const SafesideTimingArray *array) {
+  return *std::launder(
+      reinterpret_cast<const TimingArray *>(array->storage.bytes));
+}
+
+// SafesideTimer and SafesideScorer are never defined; pointers to them are
+// pointers to the C++ objects.
+const TimerBackend &Timer(const SafesideTimer *timer) {
+  return *reinterpret_cast<const TimerBackend *>(timer);
+}
+
+const SafesideTimer *CTimer(const TimerBackend *timer) {
+  return reinterpret_cast<const SafesideTimer *>(timer);
+}
+
+const Scorer &ScorerOf(const SafesideScorer *scorer) {
+  return *reinterpret_cast<const Scorer *>(scorer);
+}
+
+const SafesideScorer *CScorer(const Scorer *scorer) {
+  return reinterpret_cast<const SafesideScorer *>(scorer);
+}
+
+// Latencies are passed as plain arrays across the C interface.
+const std::array<uint64_t, 256> &LatencyArray(const uint64_t *latencies) {
+  return *reinterpret_cast<const std::array<uint64_t, 256> *>(latencies);
+}
+
+std::array<uint64_t, 256> &LatencyArray(uint64_t *latencies) {
+  return *reinterpret_cast<std::array<uint64_t, 256> *>(latencies);
+}
+
+}  // namespace
+
+extern "C" {
+
+void SafesideMemoryAndSpeculationBarrier(void) {
+  MemoryAndSpeculationBarrier();
+}
+
+void SafesideFlushFromDataCache(const void *start, const void *end) {
+  FlushFromDataCache(start, end);
+}
+
+void SafesideFlushLines(const void *const *addresses, size_t count) {
+  FlushLines(addresses, count);
+}
+
+void SafesideMeasureReadLatencyBatch(const void *const *addresses,
+                                     uint64_t *latencies, size_t count) {
+  MeasureReadLatencyBatch(addresses, latencies, count);
+}
+
+const SafesideTimer *SafesideFindTimer(const char *name) {
+  return CTimer(FindTimerBackend(name));
+}
+
+const SafesideTimer *SafesideNativeTimer(void) {
+  return CTimer(&NativeTimerBackend());
+}
+
+const SafesideTimer *SafesideDefaultTimer(void) {
+  return CTimer(&DefaultTimerBackend());
+}
+
+const char *SafesideTimerName(const SafesideTimer *timer) {
+  return Timer(timer).name();
+}
+
+bool SafesideTimerAvailable(const SafesideTimer *timer) {
+  return Timer(timer).Available();
+}
+
+uint64_t SafesideTimerNow(const SafesideTimer *timer) {
+  return Timer(timer).Now();
+}
+
+uint64_t SafesideTimerMeasureReadLatency(const SafesideTimer *timer,
+                                         const void *address) {
+  return Timer(timer).MeasureReadLatency(address);
+}
+
+const SafesideScorer *SafesideFindScorer(const char *name) {
+  static const ListSortScorer list_sort;
+  static const HistogramScorer histogram;
+  static const SelectionScorer selection;
+  for (const Scorer *scorer : {static_cast<const Scorer *>(&list_sort),
+                               static_cast<const Scorer *>(&histogram),
+                               static_cast<const Scorer *>(&selection)}) {
+    if (strcmp(scorer->name(), name) == 0) {
+      return CScorer(scorer);
+    }
+  }
+  return nullptr;
+}
+
+const SafesideScorer *SafesideDefaultScorer(void) {
+  return CScorer(&DefaultScorer());
+}
+
+const char *SafesideScorerName(const SafesideScorer *scorer) {
+  return ScorerOf(scorer).name();
+}
+
+uint64_t SafesideScorerMedianLatency(const SafesideScorer *scorer,
+                                     const uint64_t latencies[256]) {
+  return ScorerOf(scorer).MedianLatency(LatencyArray(latencies));
+}
+
+void SafesideCacheSideChannelInit(SafesideCacheSideChannel *channel) {
+  new (channel->storage.bytes) CacheSideChannel;
+}
+
+void SafesideCacheSideChannelDestroy(SafesideCacheSideChannel *channel) {
+  Channel(channel).~CacheSideChannel();
+}
+
+const unsigned char *SafesideCacheSideChannelOracle(
+    const SafesideCacheSideChannel *channel) {
+  return reinterpret_cast<const unsigned char *>(
+      Channel(channel).GetOracle().data());
+}
+
+size_t SafesideCacheSideChannelOracleStride(void) {
+  return sizeof(BigByte);
+}
+
+void SafesideCacheSideChannelFlushOracle(
+    const SafesideCacheSideChannel *channel) {
+  Channel(channel).FlushOracle();
+}
+
+bool SafesideCacheSideChannelRecomputeScores(SafesideCacheSideChannel *channel,
+                                             char safe_offset_char,
+                                             char *value) {
+  std::pair<bool, char> result =
+      Channel(channel).RecomputeScores(safe_offset_char);
+  *value = result.second;
+  return result.first;
+}
+
+bool SafesideCacheSideChannelAddHitAndRecomputeScores(
+    SafesideCacheSideChannel *channel, char *value) {
+  std::pair<bool, char> result = Channel(channel).AddHitAndRecomputeScores();
+  *value = result.second;
+  return result.first;
+}
+
+void SafesideCacheSideChannelResetScores(SafesideCacheSideChannel *channel) {
+  Channel(channel).ResetScores();
+}
+
+void SafesideCacheSideChannelSetTimer(SafesideCacheSideChannel *channel,
+                                      const SafesideTimer *timer) {
+  Channel(channel).set_timer_backend(Timer(timer));
+}
+
+void SafesideCacheSideChannelSetScorer(SafesideCacheSideChannel *channel,
+                                       const SafesideScorer *scorer) {
+  Channel(channel).set_scorer(ScorerOf(scorer));
+}
+
+double SafesideCacheSideChannelConfidence(
+    const SafesideCacheSideChannel *channel) {
+  return Channel(channel).confidence();
+}
+
+int SafesideCacheSideChannelRuns(const SafesideCacheSideChannel *channel) {
+  return Channel(channel).runs();
+}
+
+const int *SafesideCacheSideChannelScores(
+    const SafesideCacheSideChannel *channel) {
+  return Channel(channel).scores().data();
+}
+
+void SafesideTimingArrayInit(SafesideTimingArray *array) {
+  new (array->storage.bytes) TimingArray;
+}
+
+void SafesideTimingArrayDestroy(SafesideTimingArray *array) {
+  Array(array).~TimingArray();
+}
+
+size_t SafesideTimingArraySize(const SafesideTimingArray *array) {
+  return Array(array).size();
+}
+
+int *SafesideTimingArrayElement(SafesideTimingArray *array, size_t i) {
+  return &Array(array)[i];
+}
+
+void SafesideTimingArrayFlushFromCache(SafesideTimingArray *array) {
+  Array(array).FlushFromCache();
+}
+
+int SafesideTimingArrayFindFirstCachedElementIndex(SafesideTimingArray *array) {
+  return Array(array).FindFirstCachedElementIndex();
+}
+
+int SafesideTimingArrayFindFirstCachedElementIndexAfter(
+    SafesideTimingArray *array, int start_after) {
+  return Array(array).FindFirstCachedElementIndexAfter(start_after);
+}
+
+void SafesideTimingArrayProbeAll(SafesideTimingArray *array,
+                                 uint64_t latencies[256]) {
+  Array(array).ProbeAll(LatencyArray(latencies));
+}
+
+uint64_t SafesideTimingArrayCachedReadLatencyThreshold(
+    const SafesideTimingArray *array) {
+  return Array(array).cached_read_latency_threshold();
+}
+
+}  // extern "C"
@@ -0,0 +1,172 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#ifndef DEMOS_SAFESIDE_C_H_
+#define DEMOS_SAFESIDE_C_H_
+
+// C interface to the support library, for experiments written in C.
+//
+// The objects are constructed in storage the caller provides -- typically a
+// global or a stack variable of the Safeside* storage types below -- and no
+// function allocates memory after the object is initialized. Each function
+// is a direct call into the same code the C++ demos use: the oracle is the
+// page-strided, pool-allocated one of CacheSideChannel, probes are one call
+// into the batched latency kernel and flushes go out as one batch.
+//
+// Example:
+//
+//     static SafesideCacheSideChannel channel;
+//     SafesideCacheSideChannelInit(&channel);
+//     const unsigned char *oracle = SafesideCacheSideChannelOracle(&channel);
+//     size_t stride = SafesideCacheSideChannelOracleStride();
+//     char value;
+//     do {
+//       SafesideCacheSideChannelFlushOracle(&channel);
+//       SafesideForceRead(oracle + stride * (unsigned char)secret);
+//     } while (!SafesideCacheSideChannelAddHitAndRecomputeScores(&channel,
+//                                                                &value));
+//     SafesideCacheSideChannelDestroy(&channel);
+//
+// Functions on one object must not be called concurrently.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Storage big and aligned enough for the C++ object; safeside_c.cc checks
+// both at compile time. The contents are private to the library.
+#define SAFESIDE_CACHE_SIDE_CHANNEL_STORAGE_BYTES 4096
+#define SAFESIDE_TIMING_ARRAY_STORAGE_BYTES 4096
+
+typedef struct SafesideCacheSideChannel {
+  union {
+    unsigned char bytes[SAFESIDE_CACHE_SIDE_CHANNEL_STORAGE_BYTES];
+    long double align_long_double;
+    uint64_t align_uint64;
+    void *align_pointer;
+  } storage;
+} SafesideCacheSideChannel;
+
+typedef struct SafesideTimingArray {
+  union {
+    unsigned char bytes[SAFESIDE_TIMING_ARRAY_STORAGE_BYTES];
+    long double align_long_double;
+    uint64_t align_uint64;
+    void *align_pointer;
+  } storage;
+} SafesideTimingArray;
+
+// Timer backends and scorers are process-wide singletons, see
+// timer_backend.h and scorer.h.
+typedef struct SafesideTimer SafesideTimer;
+typedef struct SafesideScorer SafesideScorer;
+
+// Cache and speculation primitives, see utils.h and instr.h.
+
+// Reads a byte from `address` to bring it into the cache.
+static inline void SafesideForceRead(const void *address) {
+  (void)*(const volatile char *)address;
+}
+void SafesideMemoryAndSpeculationBarrier(void);
+// Flushes [start, end) from the data cache, followed by a barrier.
+void SafesideFlushFromDataCache(const void *start, const void *end);
+// Flushes the lines of addresses[0..count) as one batch with a single trailing
+// barrier.
+void SafesideFlushLines(const void *const *addresses, size_t count);
+// Measures the read latency of addresses[0..count), in order, with one call
+// into the native timer's batched kernel.
+void SafesideMeasureReadLatencyBatch(const void *const *addresses,
+                                     uint64_t *latencies, size_t count);
+
+// Timer selection.
+
+// The backend called `name`, or NULL if there is none.
+const SafesideTimer *SafesideFindTimer(const char *name);
+const SafesideTimer *SafesideNativeTimer(void);
+// The backend named by $SAFESIDE_TIMER if it is set and available, otherwise
+// the native one.
+const SafesideTimer *SafesideDefaultTimer(void);
+const char *SafesideTimerName(const SafesideTimer *timer);
+// Must be true before the timer is used.
+bool SafesideTimerAvailable(const SafesideTimer *timer);
+uint64_t SafesideTimerNow(const SafesideTimer *timer);
+uint64_t SafesideTimerMeasureReadLatency(const SafesideTimer *timer,
+                                         const void *address);
+
+// Scorers.
+
+// "list_sort", "histogram" or "selection"; NULL for any other name.
+const SafesideScorer *SafesideFindScorer(const char *name);
+const SafesideScorer *SafesideDefaultScorer(void);
+const char *SafesideScorerName(const SafesideScorer *scorer);
+uint64_t SafesideScorerMedianLatency(const SafesideScorer *scorer,
+                                     const uint64_t latencies[256]);
+
+// CacheSideChannel, see cache_sidechannel.h.
+
+// Takes its oracle from the process-wide pool. Must be paired with
+// SafesideCacheSideChannelDestroy.
+void SafesideCacheSideChannelInit(SafesideCacheSideChannel *channel);
+void SafesideCacheSideChannelDestroy(SafesideCacheSideChannel *channel);
+// The entry for character c is at
+// oracle + c * SafesideCacheSideChannelOracleStride().
+const unsigned char *SafesideCacheSideChannelOracle(
+    const SafesideCacheSideChannel *channel);
+size_t SafesideCacheSideChannelOracleStride(void);
+void SafesideCacheSideChannelFlushOracle(
+    const SafesideCacheSideChannel *channel);
+// Return whether the decision rule accepted a character, and store it (or the
+// best character so far) to *value.
+bool SafesideCacheSideChannelRecomputeScores(SafesideCacheSideChannel *channel,
+                                             char safe_offset_char,
+                                             char *value);
+bool SafesideCacheSideChannelAddHitAndRecomputeScores(
+    SafesideCacheSideChannel *channel, char *value);
+void SafesideCacheSideChannelResetScores(SafesideCacheSideChannel *channel);
+// The timer and the scorer must be available and stay alive as long as the
+// channel does.
+void SafesideCacheSideChannelSetTimer(SafesideCacheSideChannel *channel,
+                                      const SafesideTimer *timer);
+void SafesideCacheSideChannelSetScorer(SafesideCacheSideChannel *channel,
+                                       const SafesideScorer *scorer);
+double SafesideCacheSideChannelConfidence(
+    const SafesideCacheSideChannel *channel);
+int SafesideCacheSideChannelRuns(const SafesideCacheSideChannel *channel);
+// Hit counts of the current byte, indexed by character; 256 entries, valid
+// until the next call on the channel.
+const int *SafesideCacheSideChannelScores(
+    const SafesideCacheSideChannel *channel);
+
+// TimingArray, see timing_array.h.
+
+void SafesideTimingArrayInit(SafesideTimingArray *array);
+void SafesideTimingArrayDestroy(SafesideTimingArray *array);
+size_t SafesideTimingArraySize(const SafesideTimingArray *array);
+// Element i of the array; reading it brings it into the cache.
+int *SafesideTimingArrayElement(SafesideTimingArray *array, size_t i);
+void SafesideTimingArrayFlushFromCache(SafesideTimingArray *array);
+// Return the first element read from the cache, or -1 if there is none.
+int SafesideTimingArrayFindFirstCachedElementIndex(SafesideTimingArray *array);
+int SafesideTimingArrayFindFirstCachedElementIndexAfter(
+    SafesideTimingArray *array, int start_after);
+// Stores the read latency of element i to latencies[i], for all 256 elements.
+void SafesideTimingArrayProbeAll(SafesideTimingArray *array,
+                                 uint64_t latencies[256]);
+uint64_t SafesideTimingArrayCachedReadLatencyThreshold(
+    const SafesideTimingArray *array);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // DEMOS_SAFESIDE_C_H_
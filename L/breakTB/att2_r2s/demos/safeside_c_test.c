@@ -0,0 +1,116 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+// Built as C, so it also checks that safeside_c.h is a C header.
+
+#include "safeside_c.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+static void Expect(bool condition, const char *what) {
+  if (!condition) {
+    printf("Failed: %s\n", what);
+    ++failures;
+  }
+}
+
+// Reads `value`'s oracle entry architecturally until the channel converges.
+static bool LeakArchitecturalRead(SafesideCacheSideChannel *channel,
+                                  unsigned char value, char *leaked) {
+  const unsigned char *oracle = SafesideCacheSideChannelOracle(channel);
+  size_t stride = SafesideCacheSideChannelOracleStride();
+  SafesideCacheSideChannelResetScores(channel);
+  for (int run = 0; run < 10000; ++run) {
+    SafesideCacheSideChannelFlushOracle(channel);
+    SafesideForceRead(oracle + stride * value);
+    if (SafesideCacheSideChannelAddHitAndRecomputeScores(channel, leaked)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Checks the timer and scorer lookups, that a channel in caller-provided
+// storage finds architecturally read oracle entries with every scorer, and
+// that the timing array finds its cached element.
+int main(void) {
+  const SafesideTimer *native = SafesideNativeTimer();
+  Expect(SafesideTimerAvailable(native), "the native timer is available");
+  Expect(SafesideFindTimer(SafesideTimerName(native)) == native,
+         "the native timer is found by name");
+  Expect(SafesideFindTimer("no_such_timer") == NULL, "unknown timer");
+  uint64_t start = SafesideTimerNow(native);
+  Expect(SafesideTimerNow(native) >= start, "the native timer advances");
+
+  uint64_t latencies[256];
+  for (int i = 0; i < 256; ++i) {
+    latencies[i] = 255 - i;
+  }
+  const char *scorer_names[] = {"list_sort", "histogram", "selection"};
+  for (int i = 0; i < 3; ++i) {
+    const SafesideScorer *scorer = SafesideFindScorer(scorer_names[i]);
+    Expect(scorer != NULL && strcmp(SafesideScorerName(scorer),
+                                    scorer_names[i]) == 0,
+           "the scorer is found by name");
+    if (scorer != NULL) {
+      Expect(SafesideScorerMedianLatency(scorer, latencies) == 128,
+             "the scorer computes the median");
+    }
+  }
+  Expect(SafesideFindScorer("no_such_scorer") == NULL, "unknown scorer");
+
+  static SafesideCacheSideChannel channel;
+  SafesideCacheSideChannelInit(&channel);
+  SafesideCacheSideChannelSetTimer(&channel, native);
+  const char *secret = "C!";
+  for (int i = 0; i < 3; ++i) {
+    SafesideCacheSideChannelSetScorer(&channel,
+                                      SafesideFindScorer(scorer_names[i]));
+    for (const char *c = secret; *c != '\0'; ++c) {
+      char leaked = 0;
+      Expect(LeakArchitecturalRead(&channel, (unsigned char)*c, &leaked) &&
+                 leaked == *c,
+             "the channel finds the read entry");
+      Expect(SafesideCacheSideChannelScores(&channel)[(unsigned char)*c] > 0,
+             "the read entry has a score");
+      Expect(SafesideCacheSideChannelRuns(&channel) > 0,
+             "the runs are counted");
+    }
+  }
+  SafesideCacheSideChannelDestroy(&channel);
+
+  static SafesideTimingArray array;
+  SafesideTimingArrayInit(&array);
+  Expect(SafesideTimingArraySize(&array) == 256, "timing array size");
+  int found_first_time = 0;
+  for (int n = 0; n < 1000; ++n) {
+    int element = (n * 37) & 0xff;
+    SafesideTimingArrayFlushFromCache(&array);
+    SafesideForceRead(SafesideTimingArrayElement(&array, element));
+    if (SafesideTimingArrayFindFirstCachedElementIndex(&array) == element) {
+      ++found_first_time;
+    }
+  }
+  Expect(found_first_time > 850, "the timing array finds the cached element");
+  SafesideTimingArrayFlushFromCache(&array);
+  SafesideForceRead(SafesideTimingArrayElement(&array, 7));
+  SafesideTimingArrayProbeAll(&array, latencies);
+  Expect(latencies[7] <=
+             SafesideTimingArrayCachedReadLatencyThreshold(&array),
+         "the probed element is cached");
+  SafesideTimingArrayDestroy(&array);
+
+  if (failures == 0) {
+    printf("pass\n");
+  }
+  return failures != 0;
+}
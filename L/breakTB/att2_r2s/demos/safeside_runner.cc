@@ -0,0 +1,548 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+// Runs registered demos and prints one JSON object per line for each run.
+//
+// Usage: safeside_runner [--list] [--schedule=core0|cores] [--jobs=N]
+//                        [--repeat=N] [--max-runs=N]
+//                        [--deadline-ms=[DEMO:]N]... [--perf-counters]
+//                        [--trace=FILE] [demo...]
+//
+// Without demo names, runs every registered demo in registration order;
+// --repeat runs each of them N times.
+//
+// --max-runs limits the runs per byte (100000 by default). --deadline-ms
+// limits the wall time of every demo, or with a DEMO: prefix of that demo
+// only; the prefixed form can be repeated and wins over the plain one. A demo
+// stops at the first byte that doesn't converge within its budget.
+//
+// --perf-counters counts hardware events per experiment phase, see
+// perf_counters.h.
+//
+// --trace writes the spans of all runs to FILE as a Chrome trace. It needs a
+// build configured with -DSAFESIDE_TRACE=ON and --schedule=core0.
+//
+// --schedule=core0 (the default) runs the demos one after another in this
+// process, pinned to the first core like the cross-address-space demos pin
+// themselves. All runs share one DemoContext, so the oracle and the
+// TimingArray threshold are set up once.
+//
+// --schedule=cores runs up to --jobs demos at a time, each in a process of
+// its own pinned to a different physical core. Cores are chosen by
+// IndependentCpus, so no two jobs share SMT siblings or an L2 cache; they do
+// share the LLC. Results are printed as the runs finish.
+//
+// Every result has the fields:
+//   demo              name of the demo
+//   expected          bytes the demo tries to leak
+//   recovered         bytes it actually leaked
+//   matching_bytes    positions where recovered equals expected
+//   converged         whether every byte converged
+//   runs_to_converge  runs each byte took
+//   elapsed_cycles    native timer ticks spent in the experiment loops
+//   wall_ns           wall time of the whole demo
+//   ns_per_byte       wall_ns divided by the number of recovered bytes
+// and these optional fields:
+//   partial_scores    if a byte didn't converge and the demo scores with a
+//                     CacheSideChannel, the scores of all 256 values for that
+//                     byte
+//   cpu               with --schedule=cores, the CPU the demo ran on
+//   perf_counters     with --perf-counters, the events each phase ("train",
+//                     "trigger", "probe") caused over all runs, e.g.
+//                     {"train": {"branch_misses": 812, ...}, ...}, or null if
+//                     no event can be counted on the host; a phase the demo
+//                     never marks is null
+//   trace             in builds with SAFESIDE_TRACE, the count and the mean,
+//                     minimum, maximum and total nanoseconds of the spans of
+//                     each traced phase, e.g.
+//                     {"flush": {"count": 16, "mean_ns": 2210.5, ...}, ...}
+//   error             why the demo died; such a result has only `demo`, `cpu`
+//                     and `error`
+// The last line summarizes the suite: `schedule`, `cpus`, `runs` and
+// `wall_ns`.
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "compiler_specifics.h"
+#include "cpu_topology.h"
+#include "demo_registry.h"
+#include "perf_counters.h"
+#include "trace.h"
+#include "utils.h"
+
+#if SAFESIDE_LINUX
+#include <sched.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <deque>
+#endif
+
+namespace {
+
+std::string JsonString(const std::string &value) {
+  std::string result = "\"";
+  for (char c : value) {
+    switch (c) {
+      case '"':
+        result += "\\\"";
+        break;
+      case '\\':
+        result += "\\\\";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20 ||
+            static_cast<unsigned char>(c) >= 0x7F) {
+          char escaped[8];
+          snprintf(escaped, sizeof(escaped), "\\u%04x",
+                   static_cast<unsigned char>(c));
+          result += escaped;
+        } else {
+          result += c;
+        }
+    }
+  }
+  return result + "\"";
+}
+
+std::string IntListJson(const std::vector<int> &values) {
+  std::ostringstream out;
+  out << "[";
+  for (size_t i = 0; i < values.size(); ++i) {
+    out << (i == 0 ? "" : ", ") << values[i];
+  }
+  out << "]";
+  return out.str();
+}
+
+// Formats the events counted per phase as a JSON object, or null if no event
+// is counted.
+std::string PhaseCountersJson(const PhaseCounters &counters) {
+  if (!counters.group().available()) {
+    return "null";
+  }
+  std::ostringstream out;
+  out << "{";
+  for (size_t phase = 0; phase < kExperimentPhases; ++phase) {
+    ExperimentPhase experiment_phase = static_cast<ExperimentPhase>(phase);
+    out << (phase == 0 ? "" : ", ")
+        << JsonString(ExperimentPhaseName(experiment_phase)) << ": ";
+    if (!counters.marked(experiment_phase)) {
+      out << "null";
+      continue;
+    }
+    const PerfCounts &counts = counters.counts(experiment_phase);
+    out << "{";
+    const char *separator = "";
+    for (size_t event = 0; event < kPerfEvents; ++event) {
+      if (counters.group().Counts(static_cast<PerfEvent>(event))) {
+        out << separator
+            << JsonString(PerfEventName(static_cast<PerfEvent>(event)))
+            << ": " << counts.values[event];
+        separator = ", ";
+      }
+    }
+    out << "}";
+  }
+  out << "}";
+  return out.str();
+}
+
+// Formats the statistics of the traced phases that have spans as a JSON
+// object.
+std::string TraceStatsJson(
+    const std::array<TracePhaseStats, kTracePhases> &stats) {
+  std::ostringstream out;
+  out << "{";
+  const char *separator = "";
+  for (size_t phase = 0; phase < kTracePhases; ++phase) {
+    const TracePhaseStats &phase_stats = stats[phase];
+    if (phase_stats.count == 0) {
+      continue;
+    }
+    out << separator
+        << JsonString(TracePhaseName(static_cast<TracePhase>(phase)))
+        << ": {\"count\": " << phase_stats.count
+        << ", \"mean_ns\": " << phase_stats.mean_ns()
+        << ", \"min_ns\": " << phase_stats.min_ns
+        << ", \"max_ns\": " << phase_stats.max_ns
+        << ", \"total_ns\": " << phase_stats.total_ns << "}";
+    separator = ", ";
+  }
+  out << "}";
+  return out.str();
+}
+
+// Collects what a demo leaked and how long it took.
+class RecordingDemoContext : public DemoContext {
+ public:
+  // Runs `demo` and, unless `group` is null, counts its events per phase.
+  void Run(const Demo &demo, const PerfCounterGroup *group) {
+    phase_counters_.reset(group == nullptr ? nullptr
+                                           : new PhaseCounters(*group));
+    PhaseCounters::Scope scope(phase_counters_.get());
+    trace_start_ = TraceNow();
+    demo.run(*this);
+    trace_end_ = TraceNow();
+  }
+
+  // Formats the result of the last demo as a single-line JSON object. `cpu`
+  // is included unless negative.
+  std::string Json(const char *demo, int cpu = -1) const {
+    size_t matching_bytes = 0;
+    for (size_t i = 0; i < recovered_.size() && i < expected_.size(); ++i) {
+      if (recovered_[i] == expected_[i]) {
+        ++matching_bytes;
+      }
+    }
+
+    std::ostringstream out;
+    out << "{\"demo\": " << JsonString(demo);
+    if (cpu >= 0) {
+      out << ", \"cpu\": " << cpu;
+    }
+    out << ", \"expected\": " << JsonString(expected_)
+        << ", \"recovered\": " << JsonString(recovered_)
+        << ", \"matching_bytes\": " << matching_bytes
+        << ", \"converged\": " << (converged_ ? "true" : "false")
+        << ", \"runs_to_converge\": " << IntListJson(runs_)
+        << ", \"elapsed_cycles\": " << elapsed_cycles_
+        << ", \"wall_ns\": " << wall_ns_ << ", \"ns_per_byte\": "
+        << (recovered_.empty() ? 0 : wall_ns_ / recovered_.size());
+    if (!partial_scores_.empty()) {
+      out << ", \"partial_scores\": " << IntListJson(partial_scores_);
+    }
+    if (phase_counters_) {
+      out << ", \"perf_counters\": " << PhaseCountersJson(*phase_counters_);
+    }
+    if (kTraceEnabled) {
+      out << ", \"trace\": "
+          << TraceStatsJson(TraceStats(trace_start_, trace_end_));
+    }
+    out << "}";
+    return out.str();
+  }
+
+ protected:
+  void OnBeginLeak(const std::string &expected) override {
+    expected_ = expected;
+    recovered_.clear();
+    runs_.clear();
+    converged_ = true;
+    elapsed_cycles_ = 0;
+    partial_scores_.clear();
+    start_ = std::chrono::steady_clock::now();
+  }
+
+  void OnByte(const ExperimentOutcome &outcome) override {
+    recovered_ += outcome.value;
+    runs_.push_back(outcome.runs);
+    elapsed_cycles_ += outcome.elapsed_cycles;
+    if (!outcome.converged) {
+      converged_ = false;
+      partial_scores_ = outcome.scores;
+    }
+  }
+
+  void OnEndLeak() override {
+    wall_ns_ = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now() - start_)
+                   .count();
+  }
+
+ private:
+  std::string expected_;
+  std::string recovered_;
+  std::vector<int> runs_;
+  bool converged_ = true;
+  uint64_t elapsed_cycles_ = 0;
+  std::vector<int> partial_scores_;
+  std::chrono::steady_clock::time_point start_;
+  uint64_t wall_ns_ = 0;
+  std::unique_ptr<PhaseCounters> phase_counters_;
+  uint64_t trace_start_ = 0;
+  uint64_t trace_end_ = 0;
+};
+
+// Budgets set on the command line.
+struct Limits {
+  int max_runs = ExperimentBudget().max_runs;
+  // Zero means no deadline.
+  std::chrono::nanoseconds deadline{0};
+  std::map<std::string, std::chrono::nanoseconds> demo_deadlines;
+  // Not budgets: whether to count hardware events per phase, and where to
+  // write the Chrome trace, if anywhere.
+  bool perf_counters = false;
+  std::string trace_file;
+
+  void ApplyTo(DemoContext &context, const Demo &demo) const {
+    context.set_max_runs(max_runs);
+    auto it = demo_deadlines.find(demo.name);
+    context.set_deadline(it == demo_deadlines.end() ? deadline : it->second);
+  }
+};
+
+uint64_t NanosecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+void RunOnFirstCore(const std::vector<const Demo *> &queue,
+                    const Limits &limits) {
+  std::vector<int> cpus;
+#if SAFESIDE_LINUX
+  PinToTheFirstCore();
+  cpus.push_back(sched_getcpu());
+#endif
+  auto start = std::chrono::steady_clock::now();
+  std::unique_ptr<PerfCounterGroup> group;
+  if (limits.perf_counters) {
+    group.reset(new PerfCounterGroup);
+  }
+  RecordingDemoContext context;
+  for (const Demo *demo : queue) {
+    limits.ApplyTo(context, *demo);
+    context.Run(*demo, group.get());
+    // Flushed right away, so that no output is buffered when the next demo
+    // forks.
+    std::cout << context.Json(demo->name) << std::endl;
+  }
+  if (!limits.trace_file.empty()) {
+    std::ofstream trace(limits.trace_file);
+    WriteChromeTrace(trace);
+    if (!trace) {
+      std::cerr << "Writing " << limits.trace_file << " failed." << std::endl;
+    }
+  }
+  std::cout << "{\"schedule\": \"core0\", \"cpus\": " << IntListJson(cpus)
+            << ", \"runs\": " << queue.size()
+            << ", \"wall_ns\": " << NanosecondsSince(start) << "}"
+            << std::endl;
+}
+
+#if SAFESIDE_LINUX
+struct Job {
+  pid_t pid;
+  const Demo *demo;
+  int cpu;
+  // Read end of the pipe the job writes its result to.
+  int result_fd;
+};
+
+// Runs `demo` in a child process pinned to `cpu`. The child writes its JSON
+// result, a few hundred bytes that fit into the pipe buffer, and exits.
+Job StartJob(const Demo *demo, int cpu, const Limits &limits) {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    std::cerr << "Creating a pipe failed." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  pid_t pid = fork();
+  if (pid < 0) {
+    std::cerr << "Fork failed." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (pid == 0) {
+    close(fds[0]);
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+      _exit(EXIT_FAILURE);
+    }
+    // Opened in the child, since the events of the thread that opens the
+    // group are counted.
+    std::unique_ptr<PerfCounterGroup> group;
+    if (limits.perf_counters) {
+      group.reset(new PerfCounterGroup);
+    }
+    RecordingDemoContext context;
+    limits.ApplyTo(context, *demo);
+    context.Run(*demo, group.get());
+    std::string line = context.Json(demo->name, cpu);
+    const char *data = line.data();
+    size_t remaining = line.size();
+    while (remaining > 0) {
+      ssize_t written = write(fds[1], data, remaining);
+      if (written <= 0) {
+        _exit(EXIT_FAILURE);
+      }
+      data += written;
+      remaining -= written;
+    }
+    // Skips static destructors and stdio flushing of the parent's state.
+    _exit(EXIT_SUCCESS);
+  }
+  close(fds[1]);
+  return {pid, demo, cpu, fds[0]};
+}
+
+// Reads the result of a finished job, or describes how it died.
+std::string FinishJob(const Job &job, int status) {
+  std::string result;
+  char buffer[4096];
+  ssize_t length;
+  while ((length = read(job.result_fd, buffer, sizeof(buffer))) > 0) {
+    result.append(buffer, length);
+  }
+  close(job.result_fd);
+  if (WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS &&
+      !result.empty()) {
+    return result;
+  }
+
+  std::ostringstream error;
+  if (WIFSIGNALED(status)) {
+    error << "killed by signal " << WTERMSIG(status);
+  } else {
+    error << "exited with status " << WEXITSTATUS(status);
+  }
+  return "{\"demo\": " + JsonString(job.demo->name) +
+         ", \"cpu\": " + std::to_string(job.cpu) +
+         ", \"error\": " + JsonString(error.str()) + "}";
+}
+
+void RunOnIndependentCores(const std::vector<const Demo *> &queue,
+                           size_t max_jobs, const Limits &limits) {
+  std::vector<int> cpus = IndependentCpus();
+  if (cpus.empty()) {
+    std::cerr << "Reading the CPU topology failed." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (max_jobs > 0 && cpus.size() > max_jobs) {
+    cpus.resize(max_jobs);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::deque<int> idle_cpus(cpus.begin(), cpus.end());
+  std::map<pid_t, Job> running;
+  size_t next = 0;
+  while (next < queue.size() || !running.empty()) {
+    while (next < queue.size() && !idle_cpus.empty()) {
+      int cpu = idle_cpus.front();
+      idle_cpus.pop_front();
+      // Nothing may be buffered when forking, or the child would print it
+      // again.
+      std::cout.flush();
+      Job job = StartJob(queue[next++], cpu, limits);
+      running.emplace(job.pid, job);
+    }
+
+    int status;
+    pid_t pid = waitpid(-1, &status, 0);
+    auto it = running.find(pid);
+    if (it == running.end()) {
+      continue;
+    }
+    std::cout << FinishJob(it->second, status) << std::endl;
+    idle_cpus.push_back(it->second.cpu);
+    running.erase(it);
+  }
+  std::cout << "{\"schedule\": \"cores\", \"cpus\": " << IntListJson(cpus)
+            << ", \"runs\": " << queue.size()
+            << ", \"wall_ns\": " << NanosecondsSince(start) << "}"
+            << std::endl;
+}
+#endif
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  std::vector<const Demo *> selected;
+  std::string schedule = "core0";
+  size_t max_jobs = 0;
+  int repeat = 1;
+  Limits limits;
+  for (int i = 1; i < argc; ++i) {
+    std::string argument = argv[i];
+    std::string value;
+    if (argument == "--list") {
+      for (const Demo &demo : RegisteredDemos()) {
+        std::cout << demo.name << std::endl;
+      }
+      return EXIT_SUCCESS;
+    } else if (FlagValue(argument, "schedule", &value)) {
+      schedule = value;
+    } else if (FlagValue(argument, "jobs", &value)) {
+      max_jobs = strtoul(value.c_str(), nullptr, 10);
+    } else if (FlagValue(argument, "repeat", &value)) {
+      repeat = atoi(value.c_str());
+    } else if (FlagValue(argument, "max-runs", &value)) {
+      limits.max_runs = atoi(value.c_str());
+    } else if (FlagValue(argument, "deadline-ms", &value)) {
+      size_t colon = value.find(':');
+      std::chrono::milliseconds deadline(
+          atoi(value.c_str() + (colon == std::string::npos ? 0 : colon + 1)));
+      if (colon == std::string::npos) {
+        limits.deadline = deadline;
+      } else {
+        limits.demo_deadlines[value.substr(0, colon)] = deadline;
+      }
+    } else if (argument == "--perf-counters") {
+      limits.perf_counters = true;
+    } else if (FlagValue(argument, "trace", &value)) {
+      limits.trace_file = value;
+    } else {
+      const Demo *demo = FindDemo(argument);
+      if (demo == nullptr) {
+        std::cerr << "Unknown demo " << argument << ", see --list"
+                  << std::endl;
+        return EXIT_FAILURE;
+      }
+      selected.push_back(demo);
+    }
+  }
+  if (selected.empty()) {
+    for (const Demo &demo : RegisteredDemos()) {
+      selected.push_back(&demo);
+    }
+  }
+
+  if (!limits.trace_file.empty() && (!kTraceEnabled || schedule != "core0")) {
+    std::cerr << "--trace needs a build with SAFESIDE_TRACE and "
+              << "--schedule=core0" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (limits.perf_counters) {
+    PerfCounterGroup group;
+    if (!group.available()) {
+      std::cerr << "Not counting hardware events: " << group.error()
+                << std::endl;
+    }
+  }
+
+  std::vector<const Demo *> queue;
+  for (int i = 0; i < repeat; ++i) {
+    queue.insert(queue.end(), selected.begin(), selected.end());
+  }
+
+  if (schedule == "core0") {
+    RunOnFirstCore(queue, limits);
+#if SAFESIDE_LINUX
+  } else if (schedule == "cores") {
+    RunOnIndependentCores(queue, max_jobs, limits);
+#endif
+  } else {
+    std::cerr << "Unknown or unsupported schedule " << schedule << std::endl;
+    return EXIT_FAILURE;
+  }
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#include "scorer.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <list>
+#include <new>
+
+namespace {
+
+constexpr size_t kMedianIndex = 128;
+
+// Free-list node allocator for std::list. Nodes released by one list are
+// handed out again to the next one on the same thread, so a list of a fixed
+// size reaches the heap only while the free list is warming up.
+//
+// The allocator is stateless and all instances compare equal, which is what
+// std::list::sort requires to splice nodes between its scratch lists.
+template <typename T>
+class NodePoolAllocator {
+ public:
+  using value_type = T;
+
+  NodePoolAllocator() = default;
+  template <typename U>
+  NodePoolAllocator(const NodePoolAllocator<U> &) {}
+
+  T *allocate(size_t n) {
+    static_assert(sizeof(T) >= sizeof(FreeNode), "node too small");
+    if (n == 1 && free_list_ != nullptr) {
+      FreeNode *node = free_list_;
+      free_list_ = node->next;
+      return reinterpret_cast<T *>(node);
+    }
+    return static_cast<T *>(::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T *p, size_t n) {
+    if (n != 1) {
+      ::operator delete(p);
+      return;
+    }
+    FreeNode *node = reinterpret_cast<FreeNode *>(p);
+    node->next = free_list_;
+    free_list_ = node;
+  }
+
+ private:
+  struct FreeNode {
+    FreeNode *next;
+  };
+
+  static thread_local FreeNode *free_list_;
+};
+
+template <typename T>
+thread_local typename NodePoolAllocator<T>::FreeNode *
+    NodePoolAllocator<T>::free_list_ = nullptr;
+
+template <typename T, typename U>
+bool operator==(const NodePoolAllocator<T> &, const NodePoolAllocator<U> &) {
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const NodePoolAllocator<T> &, const NodePoolAllocator<U> &) {
+  return false;
+}
+
+}  // namespace
+
+uint64_t ListSortScorer::MedianLatency(
+    const std::array<uint64_t, 256> &latencies) const {
+  std::list<uint64_t, NodePoolAllocator<uint64_t>> sorted_latencies(
+      latencies.begin(), latencies.end());
+  // We have to use the std::list::sort implementation, see the class comment.
+  sorted_latencies.sort();
+  return *std::next(sorted_latencies.begin(), kMedianIndex);
+}
+
+uint64_t HistogramScorer::MedianLatency(
+    const std::array<uint64_t, 256> &latencies) const {
+  uint64_t fastest = latencies[0];
+  for (uint64_t latency : latencies) {
+    fastest = std::min(fastest, latency);
+  }
+
+  std::array<uint16_t, kBins> histogram = {};
+  for (uint64_t latency : latencies) {
+    ++histogram[std::min<uint64_t>(latency - fastest, kBins - 1)];
+  }
+
+  // The last bin also collects everything above it, so landing there means we
+  // don't know the exact value.
+  size_t seen = 0;
+  for (size_t bin = 0; bin < kBins - 1; ++bin) {
+    seen += histogram[bin];
+    if (seen > kMedianIndex) {
+      return fastest + bin;
+    }
+  }
+  return ListSortScorer().MedianLatency(latencies);
+}
+
+uint64_t SelectionScorer::MedianLatency(
+    const std::array<uint64_t, 256> &latencies) const {
+  std::array<uint64_t, 256> scratch = latencies;
+  std::nth_element(scratch.begin(), scratch.begin() + kMedianIndex,
+                   scratch.end());
+  return scratch[kMedianIndex];
+}
+
+const Scorer &DefaultScorer() {
+  static const ListSortScorer scorer;
+  return scorer;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#ifndef DEMOS_SCORER_H_
+#define DEMOS_SCORER_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Scorer computes the reference latency that CacheSideChannel uses to tell
+// cache hits from cache misses in one probe pass over the 256-entry oracle.
+// The reference is the median read latency of the pass, i.e. the value that
+// would be at index 128 after sorting the latencies in ascending order.
+//
+// `RecomputeScores` asks the scorer for the median on every iteration of every
+// `LeakByte` loop, so implementations must not allocate in steady state.
+//
+// Implementations are stateless and may be shared between any number of
+// CacheSideChannel instances.
+class Scorer {
+ public:
+  virtual ~Scorer() = default;
+
+  // Returns the median of `latencies`.
+  virtual uint64_t MedianLatency(
+      const std::array<uint64_t, 256> &latencies) const = 0;
+
+  // Short human-readable name of the engine, used by benchmarks.
+  virtual const char *name() const = 0;
+};
+
+// Sorts the latencies with `std::list::sort`, the only sorting routine that
+// we know not to disturb the AMD memory disambiguation predictor.
+// Invocations of std::sort, std::stable_sort, std::nth_element and
+// std::partial_sort, when compiled with optimizations, intervene with the
+// neural network based AMD memory disambiguation dynamic predictor and the
+// Spectre v4 example fails on AMD Ryzen 5 PRO 2400G.
+//
+// List nodes come from a per-thread free list, so after the first call no
+// node is allocated on the heap. This is the default engine.
+class ListSortScorer : public Scorer {
+ public:
+  uint64_t MedianLatency(
+      const std::array<uint64_t, 256> &latencies) const override;
+  const char *name() const override { return "list_sort"; }
+};
+
+// Builds a histogram with one-cycle-wide bins starting at the fastest read
+// of the pass and walks it until half of the reads are accounted for. The
+// result is exact; passes so noisy that the median is more than `kBins`
+// cycles above the fastest read fall back to ListSortScorer.
+//
+// Only uses counting, no comparison sort, but has not been validated against
+// the Spectre v4 example on AMD hardware.
+class HistogramScorer : public Scorer {
+ public:
+  static constexpr size_t kBins = 1024;
+
+  uint64_t MedianLatency(
+      const std::array<uint64_t, 256> &latencies) const override;
+  const char *name() const override { return "histogram"; }
+};
+
+// Runs std::nth_element on a stack copy of the latencies. Usually the fastest
+// engine, but it breaks the Spectre v4 example on AMD (see ListSortScorer), so
+// only use it on hosts where that does not matter.
+class SelectionScorer : public Scorer {
+ public:
+  uint64_t MedianLatency(
+      const std::array<uint64_t, 256> &latencies) const override;
+  const char *name() const override { return "selection"; }
+};
+
+// Returns the engine that CacheSideChannel uses unless told otherwise.
+const Scorer &DefaultScorer();
+
+#endif  // DEMOS_SCORER_H_
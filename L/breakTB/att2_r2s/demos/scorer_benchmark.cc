@@ -0,0 +1,95 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <vector>
+
+#include "scorer.h"
+
+namespace {
+
+constexpr int kPasses = 64;
+constexpr int kCallsPerEngine = 200000;
+
+using Latencies = std::array<uint64_t, 256>;
+
+// The median computation CacheSideChannel::RecomputeScores used before the
+// Scorer engines existed: a fresh heap-allocated list per call, copied into a
+// fresh vector. Kept here only as the baseline.
+uint64_t HeapListMedian(const Latencies &latencies) {
+  std::list<uint64_t> sorted_latencies_list(latencies.begin(), latencies.end());
+  sorted_latencies_list.sort();
+  std::vector<uint64_t> sorted_latencies(sorted_latencies_list.begin(),
+                                         sorted_latencies_list.end());
+  return sorted_latencies[128];
+}
+
+// Produces latencies shaped like one probe pass: mostly cache misses spread
+// around a few hundred cycles, two cache hits and the occasional interrupted
+// read.
+Latencies SyntheticProbePass() {
+  Latencies latencies;
+  for (uint64_t &latency : latencies) {
+    latency = 220 + rand() % 80;
+    if (rand() % 64 == 0) {
+      latency += 2000 + rand() % 10000;
+    }
+  }
+  latencies[rand() & 0xFF] = 40 + rand() % 10;
+  latencies[rand() & 0xFF] = 40 + rand() % 10;
+  return latencies;
+}
+
+template <typename MedianFn>
+void Run(const char *name, const std::vector<Latencies> &passes,
+         MedianFn median) {
+  uint64_t sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kCallsPerEngine; ++i) {
+    sink += median(passes[i % passes.size()]);
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  double ns_per_call =
+      std::chrono::duration<double, std::nano>(elapsed).count() /
+      kCallsPerEngine;
+  std::cout << std::left << std::setw(16) << name << std::right
+            << std::setw(10) << std::fixed << std::setprecision(1)
+            << ns_per_call << " ns/call  (checksum " << sink << ")"
+            << std::endl;
+}
+
+}  // namespace
+
+// Compares the cost of the median engines used by
+// CacheSideChannel::RecomputeScores, in nanoseconds per call.
+int main() {
+  srand(1);
+  std::vector<Latencies> passes;
+  for (int i = 0; i < kPasses; ++i) {
+    passes.push_back(SyntheticProbePass());
+  }
+
+  Run("heap_list", passes, HeapListMedian);
+
+  ListSortScorer list_sort;
+  HistogramScorer histogram;
+  SelectionScorer selection;
+  for (const Scorer *scorer :
+       std::array<const Scorer *, 3>{&list_sort, &histogram, &selection}) {
+    Run(scorer->name(), passes, [scorer](const Latencies &latencies) {
+      return scorer->MedianLatency(latencies);
+    });
+  }
+}
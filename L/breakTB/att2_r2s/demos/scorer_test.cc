@@ -0,0 +1,53 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#include "scorer.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <iostream>
+
+// Checks that every engine returns exactly the median that a full sort yields,
+// including for passes whose median is beyond the histogram range.
+int main(int argc, char* argv[]) {
+  ListSortScorer list_sort;
+  HistogramScorer histogram;
+  SelectionScorer selection;
+  const std::array<const Scorer *, 3> scorers = {
+      &list_sort, &histogram, &selection};
+
+  const int attempts = 1000;
+  int failures = 0;
+
+  for (int n = 0; n < attempts; ++n) {
+    std::array<uint64_t, 256> latencies;
+    // Every tenth pass spreads the latencies far wider than the histogram.
+    uint64_t spread = (n % 10 == 0) ? 100000 : 400;
+    for (uint64_t &latency : latencies) {
+      latency = 30 + rand() % spread;
+    }
+
+    std::array<uint64_t, 256> sorted = latencies;
+    std::sort(sorted.begin(), sorted.end());
+
+    for (const Scorer *scorer : scorers) {
+      uint64_t median = scorer->MedianLatency(latencies);
+      if (median != sorted[128]) {
+        std::cout << scorer->name() << " returned " << median
+                  << " instead of " << sorted[128] << std::endl;
+        ++failures;
+      }
+    }
+  }
+
+  bool pass = failures == 0;
+  std::cout << (pass ? "pass" : "fail") << std::endl;
+  return !pass;
+}
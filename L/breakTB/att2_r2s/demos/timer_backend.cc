@@ -0,0 +1,317 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#include "timer_backend.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#include "asm/measurereadlatency.h"
+#include "compiler_specifics.h"
+#include "cpu_features.h"
+#include "instr.h"
+#include "perf_counters.h"
+#include "utils.h"
+
+#if SAFESIDE_LINUX || SAFESIDE_MAC
+#include <time.h>
+#endif
+
+#if SAFESIDE_LINUX && (SAFESIDE_X64 || SAFESIDE_IA32)
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+uint64_t TimerBackend::MeasureReadLatency(const void *address) const {
+  MemoryAndSpeculationBarrier();
+  uint64_t start = Now();
+  MemoryAndSpeculationBarrier();
+  ForceRead(address);
+  MemoryAndSpeculationBarrier();
+  return Now() - start;
+}
+
+namespace {
+
+class NativeTimer : public TimerBackend {
+ public:
+  const char *name() const override {
+#if SAFESIDE_X64 || SAFESIDE_IA32
+    return "rdtsc_lfence";
+#else
+    return "native";
+#endif
+  }
+
+  bool Available() const override { return true; }
+
+  uint64_t Now() const override {
+#if SAFESIDE_X64 || SAFESIDE_IA32
+    return __rdtsc();
+#elif SAFESIDE_ARM64 && SAFESIDE_GNUC
+    uint64_t count;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(count));
+    return count;
+#elif SAFESIDE_PPC && SAFESIDE_GNUC
+    return __builtin_ppc_get_timebase();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+  }
+
+  uint64_t MeasureReadLatency(const void *address) const override {
+    return ::MeasureReadLatency(address);
+  }
+};
+
+#if SAFESIDE_X64 || SAFESIDE_IA32
+class RdtscpTimer : public TimerBackend {
+ public:
+  const char *name() const override { return "rdtscp"; }
+
+  bool Available() const override { return GetCpuFeatures().rdtscp; }
+
+  uint64_t Now() const override {
+    unsigned int aux;
+    return __rdtscp(&aux);
+  }
+
+  // RDTSCP waits for all earlier instructions, including the read, to
+  // execute; the LFENCE after it keeps later instructions from starting
+  // before the timestamp is taken.
+  uint64_t MeasureReadLatency(const void *address) const override {
+    unsigned int aux;
+    _mm_mfence();
+    uint64_t start = __rdtscp(&aux);
+    _mm_lfence();
+    ForceRead(address);
+    uint64_t end = __rdtscp(&aux);
+    _mm_lfence();
+    return end - start;
+  }
+};
+#endif
+
+#if (SAFESIDE_X64 || SAFESIDE_IA32) && SAFESIDE_GNUC
+class RdpruTimer : public TimerBackend {
+ public:
+  const char *name() const override { return "rdpru"; }
+
+  bool Available() const override { return GetCpuFeatures().rdpru; }
+
+  uint64_t Now() const override {
+    // RDPRU with ECX = 1 reads APERF. Spelled out as bytes for assemblers
+    // that don't know the mnemonic.
+    uint32_t low, high;
+    asm volatile(".byte 0x0f, 0x01, 0xfd" : "=a"(low), "=d"(high) : "c"(1));
+    return (static_cast<uint64_t>(high) << 32) | low;
+  }
+};
+#endif
+
+#if SAFESIDE_LINUX && (SAFESIDE_X64 || SAFESIDE_IA32)
+// Reads the cycle counter of a perf event directly with RDPMC. Every thread
+// opens its own event, which counts only that thread, on first use. On a
+// thread where that fails, Now() falls back to NativeTimerBackend() so that
+// its intervals stay consistent.
+class PerfRdpmcTimer : public TimerBackend {
+ public:
+  const char *name() const override { return "perf_rdpmc"; }
+
+  bool Available() const override { return ThreadEvent().page != nullptr; }
+
+  uint64_t Now() const override {
+    const perf_event_mmap_page *page = ThreadEvent().page;
+    if (page == nullptr) {
+      return NativeTimerBackend().Now();
+    }
+    return ReadPerfEventWithRdpmc(page);
+  }
+
+ private:
+  // Cycle counter event of one thread.
+  struct Event {
+    ~Event() {
+      if (page != nullptr) {
+        munmap(page, sysconf(_SC_PAGESIZE));
+      }
+    }
+
+    bool opened = false;
+    perf_event_mmap_page *page = nullptr;
+  };
+
+  static const Event &ThreadEvent() {
+    thread_local Event event;
+    if (!event.opened) {
+      event.opened = true;
+      event.page = OpenCycleEvent();
+    }
+    return event;
+  }
+
+  // Returns the mmapped page of a new cycle counter event of the calling
+  // thread, or nullptr if the event can't be opened or read with RDPMC.
+  static perf_event_mmap_page *OpenCycleEvent() {
+    perf_event_attr attr = {};
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    int fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fd < 0) {
+      return nullptr;
+    }
+    void *page = mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED,
+                      fd, 0);
+    close(fd);
+    if (page == MAP_FAILED) {
+      return nullptr;
+    }
+    auto *info = static_cast<perf_event_mmap_page *>(page);
+    if (!info->cap_user_rdpmc || info->index == 0) {
+      munmap(page, sysconf(_SC_PAGESIZE));
+      return nullptr;
+    }
+    return info;
+  }
+};
+#endif
+
+// A thread spinning on a counter increment. The counter advances at a rate
+// set by the store-to-load forwarding loop, roughly one tick per few cycles,
+// independent of any architectural timer.
+class CountingThreadTimer : public TimerBackend {
+ public:
+  ~CountingThreadTimer() override {
+    if (thread_.joinable()) {
+      stop_.store(true, std::memory_order_relaxed);
+      thread_.join();
+    }
+  }
+
+  const char *name() const override { return "counting_thread"; }
+
+  bool Available() const override {
+    if (std::thread::hardware_concurrency() < 2) {
+      return false;
+    }
+    std::call_once(start_once_, [this] {
+      thread_ = std::thread([this] {
+        while (!stop_.load(std::memory_order_relaxed)) {
+          counter_.store(counter_.load(std::memory_order_relaxed) + 1,
+                         std::memory_order_relaxed);
+        }
+      });
+      // Wait until the thread is counting.
+      while (counter_.load(std::memory_order_relaxed) == 0) {
+      }
+    });
+    return true;
+  }
+
+  uint64_t Now() const override {
+    return counter_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  mutable std::once_flag start_once_;
+  mutable std::thread thread_;
+  mutable std::atomic<uint64_t> counter_{0};
+  mutable std::atomic<bool> stop_{false};
+};
+
+class ClockGettimeTimer : public TimerBackend {
+ public:
+  const char *name() const override { return "clock_gettime"; }
+
+  bool Available() const override { return true; }
+
+  uint64_t Now() const override {
+#if SAFESIDE_LINUX || SAFESIDE_MAC
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+  }
+};
+
+}  // namespace
+
+const TimerBackend &NativeTimerBackend() {
+  static NativeTimer timer;
+  return timer;
+}
+
+std::vector<const TimerBackend *> AllTimerBackends() {
+#if SAFESIDE_X64 || SAFESIDE_IA32
+  static RdtscpTimer rdtscp;
+#endif
+#if (SAFESIDE_X64 || SAFESIDE_IA32) && SAFESIDE_GNUC
+  static RdpruTimer rdpru;
+#endif
+#if SAFESIDE_LINUX && (SAFESIDE_X64 || SAFESIDE_IA32)
+  static PerfRdpmcTimer perf_rdpmc;
+#endif
+  static CountingThreadTimer counting_thread;
+  static ClockGettimeTimer clock_gettime_timer;
+
+  return {
+    &NativeTimerBackend(),
+#if SAFESIDE_X64 || SAFESIDE_IA32
+    &rdtscp,
+#endif
+#if (SAFESIDE_X64 || SAFESIDE_IA32) && SAFESIDE_GNUC
+    &rdpru,
+#endif
+#if SAFESIDE_LINUX && (SAFESIDE_X64 || SAFESIDE_IA32)
+    &perf_rdpmc,
+#endif
+    &counting_thread,
+    &clock_gettime_timer,
+  };
+}
+
+const TimerBackend *FindTimerBackend(const std::string &name) {
+  for (const TimerBackend *timer : AllTimerBackends()) {
+    if (name == timer->name()) {
+      return timer;
+    }
+  }
+  return nullptr;
+}
+
+const TimerBackend &DefaultTimerBackend() {
+  static const TimerBackend *timer = [] {
+    const char *name = getenv("SAFESIDE_TIMER");
+    if (name == nullptr) {
+      return &NativeTimerBackend();
+    }
+    const TimerBackend *found = FindTimerBackend(name);
+    if (found == nullptr || !found->Available()) {
+      std::cerr << "Timer backend " << name
+                << " is unknown or unavailable, using "
+                << NativeTimerBackend().name() << std::endl;
+      return &NativeTimerBackend();
+    }
+    return found;
+  }();
+  return *timer;
+}
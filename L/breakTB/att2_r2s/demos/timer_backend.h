@@ -0,0 +1,76 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#ifndef DEMOS_TIMER_BACKEND_H_
+#define DEMOS_TIMER_BACKEND_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// TimerBackend is a source of timestamps for cache timing measurements.
+//
+// The assembly MeasureReadLatency (asm/measurereadlatency_*) is one fixed
+// choice per architecture. On some hosts another timer is preferable: RDTSC
+// may be trapped or coarse under virtualization, RDPRU/RDPMC count actual core
+// cycles regardless of frequency, and a counting thread works where no
+// hardware counter is readable from user space at all.
+//
+// Timestamps are in backend-specific ticks and only differences are
+// meaningful. Backends are stateless from the caller's point of view and may
+// be shared between threads, except where noted.
+class TimerBackend {
+ public:
+  virtual ~TimerBackend() = default;
+
+  // Short name used to select the backend, e.g. in $SAFESIDE_TIMER.
+  virtual const char *name() const = 0;
+
+  // True iff the backend works on this host. Checks CPU features and, where
+  // needed, sets the backend up (e.g. opens a perf event). Must return true
+  // before any other method is called.
+  virtual bool Available() const = 0;
+
+  // Current timestamp, with no ordering guarantees.
+  virtual uint64_t Now() const = 0;
+
+  // Reads a byte from *address and returns how many ticks that took. The
+  // default implementation surrounds the read with full barriers; backends
+  // override it where a tighter sequence exists.
+  virtual uint64_t MeasureReadLatency(const void *address) const;
+};
+
+// The assembly MeasureReadLatency: MFENCE+LFENCE and RDTSC on x86, CNTVCT_EL0
+// on aarch64, the Time Base on ppc64le. Always available. Named "rdtsc_lfence"
+// on x86 and "native" elsewhere.
+const TimerBackend &NativeTimerBackend();
+
+// All backends compiled in for this platform, available or not, starting with
+// the native one:
+//   - rdtsc_lfence / native: see NativeTimerBackend.
+//   - rdtscp: RDTSCP followed by LFENCE. x86 with RDTSCP support.
+//   - rdpru: AMD RDPRU reading APERF, i.e. actual core cycles. x86 with GCC or
+//     Clang, on CPUs that advertise RDPRU.
+//   - perf_rdpmc: the perf_event cycle counter of the calling thread, read
+//     with RDPMC. Linux on x86, where the kernel allows user-space RDPMC (see
+//     /sys/bus/event_source/devices/cpu/rdpmc).
+//   - counting_thread: a second thread incrementing a shared counter. Needs a
+//     spare core; the thread runs until the process exits.
+//   - clock_gettime: CLOCK_MONOTONIC in nanoseconds (std::chrono::steady_clock
+//     outside of POSIX).
+std::vector<const TimerBackend *> AllTimerBackends();
+
+// Returns the backend called `name`, or nullptr if there is none.
+const TimerBackend *FindTimerBackend(const std::string &name);
+
+// The backend named by $SAFESIDE_TIMER if it is set and available, otherwise
+// NativeTimerBackend().
+const TimerBackend &DefaultTimerBackend();
+
+#endif  // DEMOS_TIMER_BACKEND_H_
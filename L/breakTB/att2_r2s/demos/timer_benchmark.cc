@@ -0,0 +1,149 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "instr.h"
+#include "timer_backend.h"
+#include "timing_array.h"
+#include "utils.h"
+
+namespace {
+
+constexpr int kCalls = 100000;
+constexpr int kSamples = 4000;
+// Minimum fraction of correctly classified reads for a usable backend.
+constexpr double kMinAccuracy = 0.95;
+
+using Clock = std::chrono::steady_clock;
+
+double Nanoseconds(Clock::duration duration) {
+  return std::chrono::duration<double, std::nano>(duration).count();
+}
+
+struct TimerReport {
+  double ns_per_tick;
+  double resolution_ns;
+  double overhead_ns;
+  uint64_t hit_ticks;
+  uint64_t miss_ticks;
+  double accuracy;
+};
+
+uint64_t Median(std::vector<uint64_t> values) {
+  std::nth_element(values.begin(), values.begin() + values.size() / 2,
+                   values.end());
+  return values[values.size() / 2];
+}
+
+TimerReport Measure(const TimerBackend &timer, TimingArray &ta) {
+  TimerReport report;
+
+  // Tick length, against the steady clock over ~20 ms.
+  auto wall_start = Clock::now();
+  uint64_t tick_start = timer.Now();
+  while (Clock::now() - wall_start < std::chrono::milliseconds(20)) {
+  }
+  uint64_t ticks = timer.Now() - tick_start;
+  double wall_ns = Nanoseconds(Clock::now() - wall_start);
+  report.ns_per_tick = ticks == 0 ? 0 : wall_ns / ticks;
+
+  // Resolution: the smallest non-zero step between consecutive readings.
+  // Overhead: the average cost of one reading.
+  uint64_t smallest_step = std::numeric_limits<uint64_t>::max();
+  uint64_t previous = timer.Now();
+  auto calls_start = Clock::now();
+  for (int i = 0; i < kCalls; ++i) {
+    uint64_t now = timer.Now();
+    if (now != previous) {
+      smallest_step = std::min(smallest_step, now - previous);
+    }
+    previous = now;
+  }
+  report.overhead_ns = Nanoseconds(Clock::now() - calls_start) / kCalls;
+  report.resolution_ns = smallest_step * report.ns_per_tick;
+
+  // Hit/miss separation on TimingArray elements.
+  std::vector<uint64_t> hits, misses;
+  for (int n = 0; n < kSamples; ++n) {
+    int i = n % ta.size();
+    ForceRead(&ta[i]);
+    hits.push_back(timer.MeasureReadLatency(&ta[i]));
+    FlushDataCacheLine(&ta[i]);
+    misses.push_back(timer.MeasureReadLatency(&ta[i]));
+  }
+  report.hit_ticks = Median(hits);
+  report.miss_ticks = Median(misses);
+
+  // Classify with a threshold halfway between the two medians.
+  uint64_t threshold = (report.hit_ticks + report.miss_ticks) / 2;
+  int correct = 0;
+  for (uint64_t hit : hits) {
+    correct += hit <= threshold;
+  }
+  for (uint64_t miss : misses) {
+    correct += miss > threshold;
+  }
+  report.accuracy = correct / (2.0 * kSamples);
+  return report;
+}
+
+}  // namespace
+
+// Reports the resolution, overhead and cache hit/miss separation of every
+// timer backend available on this host, and recommends the cheapest one that
+// still tells hits from misses reliably. Select it for the demos by setting
+// $SAFESIDE_TIMER.
+int main() {
+  TimingArray ta;
+  const TimerBackend *best = nullptr;
+  double best_overhead = 0;
+
+  std::cout << std::left << std::setw(16) << "backend" << std::right
+            << std::setw(10) << "ns/tick" << std::setw(14) << "resolution"
+            << std::setw(12) << "overhead" << std::setw(10) << "hit"
+            << std::setw(10) << "miss" << std::setw(10) << "accuracy"
+            << std::endl;
+
+  for (const TimerBackend *timer : AllTimerBackends()) {
+    if (!timer->Available()) {
+      std::cout << std::left << std::setw(16) << timer->name()
+                << "not available" << std::endl;
+      continue;
+    }
+
+    TimerReport report = Measure(*timer, ta);
+    std::cout << std::left << std::setw(16) << timer->name() << std::right
+              << std::fixed << std::setprecision(3) << std::setw(10)
+              << report.ns_per_tick << std::setprecision(1) << std::setw(11)
+              << report.resolution_ns << " ns" << std::setw(9)
+              << report.overhead_ns << " ns" << std::setw(10)
+              << report.hit_ticks << std::setw(10) << report.miss_ticks
+              << std::setprecision(3) << std::setw(10) << report.accuracy
+              << std::endl;
+
+    if (report.accuracy >= kMinAccuracy &&
+        (best == nullptr || report.overhead_ns < best_overhead)) {
+      best = timer;
+      best_overhead = report.overhead_ns;
+    }
+  }
+
+  if (best != nullptr) {
+    std::cout << "Recommended: SAFESIDE_TIMER=" << best->name() << std::endl;
+  } else {
+    std::cout << "No backend separates hits from misses reliably."
+              << std::endl;
+  }
+}
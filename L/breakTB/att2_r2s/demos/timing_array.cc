@@ -10,14 +10,60 @@
 #include "timing_array.h"
 
 #include <algorithm>
+#include <array>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <limits>
 #include <vector>
 
 #include "asm/measurereadlatency.h"
+#include "calibration_cache.h"
 #include "instr.h"
+#include "quantile_estimator.h"
+#include "trace.h"
 #include "utils.h"
 
+struct TimingArray::OnlineRecalibration {
+  // Quantiles tracked in either component.
+  static constexpr double kHitQuantile = 0.9;
+  static constexpr double kMissQuantile = 0.1;
+  // Hits and sampled misses that close a window.
+  static const uint64_t kWindowReads = 128;
+  // Only every kMissSampling-th miss is tracked. Misses outnumber hits by two
+  // orders of magnitude, so this keeps the overhead per probe pass low.
+  static const uint64_t kMissSampling = 8;
+
+  explicit OnlineRecalibration(uint64_t threshold)
+      : fast_center(threshold / 2.0), slow_center(threshold * 2.0) {}
+
+  // Streaming medians of the two components. A read belongs to the component
+  // whose center is closer, which doesn't depend on the threshold in effect;
+  // the calibrated threshold only places the centers initially.
+  double fast_center;
+  double slow_center;
+  P2QuantileEstimator hits{kHitQuantile};
+  P2QuantileEstimator misses{kMissQuantile};
+  uint64_t reads = 0;
+  uint64_t unsampled_misses = 0;
+  // Relative position of the threshold between the two quantiles, negative
+  // until the first window closed.
+  double position = -1;
+  // Ring buffer of the last windows. Window i is at i % kDriftHistoryLength.
+  std::array<ThresholdDriftSample, kDriftHistoryLength> history;
+  uint64_t windows = 0;
+};
+
+namespace {
+
+// Whether SAFESIDE_ONLINE_RECALIBRATION is set to anything but "0".
+bool OnlineRecalibrationFromEnvironment() {
+  const char *value = getenv("SAFESIDE_ONLINE_RECALIBRATION");
+  return value != nullptr && value[0] != '\0' && strcmp(value, "0") != 0;
+}
+
+}  // namespace
+
 TimingArray::TimingArray() {
   // Explicitly initialize the elements of the array.
   //
@@ -30,21 +76,100 @@ TimingArray::TimingArray() {
   // and unaccessed elements.
   for (int i = 0; i < size(); ++i) {
     ElementAt(i) = -1;
+    element_addresses_[i] = &ElementAt(i);
   }
 
   // Init the first time through, then keep for later instances.
-  static uint64_t threshold = FindCachedReadLatencyThreshold();
+  static uint64_t threshold = ComputeThreshold(Calibration::kCached);
   cached_read_latency_threshold_ = threshold;
+
+  static bool online = OnlineRecalibrationFromEnvironment();
+  set_online_recalibration(online);
 }
 
-void TimingArray::FlushFromCache() {
-  // We only need to flush the cache lines with elements on them.
-  for (int i = 0; i < size(); ++i) {
-    FlushDataCacheLineNoBarrier(&ElementAt(i));
+TimingArray::~TimingArray() = default;
+
+void TimingArray::set_online_recalibration(bool enabled) {
+  if (!enabled) {
+    online_recalibration_.reset();
+  } else if (!online_recalibration_) {
+    online_recalibration_.reset(
+        new OnlineRecalibration(cached_read_latency_threshold_));
   }
+}
 
-  // Wait for flushes to finish.
-  MemoryAndSpeculationBarrier();
+std::vector<TimingArray::ThresholdDriftSample>
+TimingArray::threshold_drift_history() const {
+  std::vector<ThresholdDriftSample> history;
+  if (!online_recalibration_) {
+    return history;
+  }
+  const OnlineRecalibration &online = *online_recalibration_;
+  uint64_t first = online.windows > kDriftHistoryLength
+                       ? online.windows - kDriftHistoryLength
+                       : 0;
+  for (uint64_t i = first; i < online.windows; ++i) {
+    history.push_back(online.history[i % kDriftHistoryLength]);
+  }
+  return history;
+}
+
+void TimingArray::TrackReadLatency(uint64_t read_latency) {
+  OnlineRecalibration &online = *online_recalibration_;
+  ++online.reads;
+  double latency = read_latency;
+  // Each center moves one tick towards the reads of its component, which
+  // tracks the component's median and ignores how far off outliers are.
+  if (latency < (online.fast_center + online.slow_center) / 2) {
+    online.fast_center += latency > online.fast_center ? 1 : -1;
+    online.hits.Add(latency);
+  } else {
+    online.slow_center += latency > online.slow_center ? 1 : -1;
+    if (++online.unsampled_misses == OnlineRecalibration::kMissSampling) {
+      online.unsampled_misses = 0;
+      online.misses.Add(latency);
+    }
+  }
+}
+
+void TimingArray::CloseRecalibrationWindow() {
+  OnlineRecalibration &online = *online_recalibration_;
+  if (online.hits.count() < OnlineRecalibration::kWindowReads ||
+      online.misses.count() < OnlineRecalibration::kWindowReads) {
+    return;
+  }
+
+  double hit = online.hits.Estimate();
+  double miss = online.misses.Estimate();
+  online.hits.Reset();
+  online.misses.Reset();
+  if (miss <= hit) {
+    // The two components overlap; the window tells us nothing useful.
+    return;
+  }
+
+  double threshold = cached_read_latency_threshold_;
+  if (online.position < 0) {
+    online.position =
+        std::min(std::max((threshold - hit) / (miss - hit), 0.05), 0.95);
+  } else {
+    // Move a quarter of the way to the new target per window.
+    double target = hit + online.position * (miss - hit);
+    threshold += (target - threshold) / 4;
+    cached_read_latency_threshold_ = static_cast<uint64_t>(threshold + 0.5);
+  }
+
+  online.history[online.windows % kDriftHistoryLength] = {
+      online.reads, static_cast<uint64_t>(hit), static_cast<uint64_t>(miss),
+      cached_read_latency_threshold_};
+  ++online.windows;
+}
+
+void TimingArray::FlushFromCache() {
+  SAFESIDE_TRACE_SPAN(TracePhase::kFlush);
+  // We only need to flush the cache lines with elements on them. FlushLines
+  // also waits for the flushes to finish.
+  FlushLines(element_addresses_);
 }
 
 int TimingArray::FindFirstCachedElementIndexAfter(int start_after) {
@@ -55,16 +180,31 @@ int TimingArray::FindFirstCachedElementIndexAfter(int start_after) {
 
   // Start at the element after `start_after`, wrapping around until we've
   // found a cached element or tried every element.
+  int found = -1;
   for (int i = 1; i <= size(); ++i) {
     int el = (start_after + i) % size();
     uint64_t read_latency = MeasureReadLatency(&ElementAt(el));
-    if (read_latency <= cached_read_latency_threshold_) {
-      return el;
+    bool cached = read_latency <= cached_read_latency_threshold_;
+    if (online_recalibration_) {
+      TrackReadLatency(read_latency);
+    }
+    if (cached) {
+      found = el;
+      break;
     }
   }
 
-  // Didn't find a cached element.
-  return -1;
+  // The threshold moves only after the probe pass, so that closing a window
+  // neither delays the reads nor disturbs the elements not read yet.
+  if (online_recalibration_) {
+    CloseRecalibrationWindow();
+  }
+  return found;
+}
+
+void TimingArray::ProbeAll(std::array<uint64_t, kRealElements> &latencies) {
+  MeasureReadLatencyBatch(element_addresses_.data(), latencies.data(),
+                          kRealElements);
 }
 
 int TimingArray::FindFirstCachedElementIndex() {
@@ -120,8 +260,7 @@ int TimingArray::FindFirstCachedElementIndex() {
 // observations from "Opportunities and Limits of Remote Timing Attacks"[1].
 //
 // [1] https://www.cs.rice.edu/~dwallach/pub/crosby-timing2009.pdf
-uint64_t TimingArray::FindCachedReadLatencyThreshold() {
-  const int iterations = 1000;
+uint64_t TimingArray::FindCachedReadLatencyThreshold(int iterations) {
   const int percentile = 10;
 
   // Accumulates the highest read latency seen in each iteration.
@@ -148,3 +287,36 @@ uint64_t TimingArray::FindCachedReadLatencyThreshold() {
   int index = (percentile / 100.0) * (max_read_latencies.size() - 1);
   return max_read_latencies[index];
 }
+
+namespace {
+
+// Name of the threshold in the calibration cache.
+const char kThresholdName[] = "timing_array_threshold";
+
+// Passes of a full calibration.
+const int kFullCalibrationIterations = 1000;
+
+// Passes of the probe validating a cached threshold. Much noisier than a full
+// calibration, but good enough to notice that the machine changed (frequency
+// scaling policy, memory configuration, virtualization, ...) in a way the
+// CPU identity doesn't capture.
+const int kValidationIterations = 50;
+
+}  // namespace
+
+uint64_t TimingArray::ComputeThreshold(Calibration calibration) {
+  uint64_t cached;
+  if (calibration == Calibration::kCached &&
+      LoadCalibration(kThresholdName, &cached)) {
+    // Accept the cached value if the probe lands within 25% of it.
+    uint64_t probe = FindCachedReadLatencyThreshold(kValidationIterations);
+    if (probe * 4 >= cached * 3 && probe * 4 <= cached * 5) {
+      return cached;
+    }
+  }
+
+  uint64_t threshold =
+      FindCachedReadLatencyThreshold(kFullCalibrationIterations);
+  StoreCalibration(kThresholdName, threshold);
+  return threshold;
+}
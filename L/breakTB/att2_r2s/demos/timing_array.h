@@ -13,6 +13,7 @@
 #include <array>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <vector>
 
 #include "hardware_constants.h"
@@ -70,7 +71,20 @@ class TimingArray {
   // comment on `elements_` below.
   static const size_t kRealElements = 256;
 
+  // How the cached read latency threshold is obtained.
+  enum class Calibration {
+    // Always measure from scratch.
+    kFull,
+    // Reuse the threshold stored for this CPU by an earlier process if a short
+    // probe confirms it still holds, otherwise measure from scratch. Either
+    // way, the threshold used is stored for later processes.
+    kCached,
+  };
+
+  // The first instance in a process calibrates with Calibration::kCached;
+  // later instances reuse its threshold.
   TimingArray();
+  ~TimingArray();
 
   TimingArray(TimingArray&) = delete;
   TimingArray& operator=(TimingArray&) = delete;
@@ -131,18 +145,79 @@ class TimingArray {
   // element read before returning -1 is `start_after`.
   int FindFirstCachedElementIndexAfter(int start_after);
 
+  // Measures the read latency of every element, in index order, and stores
+  // the latency of element i to latencies[i]. The whole pass is a single call
+  // into MeasureReadLatencyBatch, so it is cheaper than reading each element
+  // with MeasureReadLatency.
+  void ProbeAll(std::array<uint64_t, kRealElements> &latencies);
+
   // Returns the threshold value used by FindFirstCachedElementIndex to
   // identify reads that came from cache.
   uint64_t cached_read_latency_threshold() const {
     return cached_read_latency_threshold_;
   }
 
+  // Recomputes the threshold of this instance. Only needed by tests and
+  // benchmarks that want to measure calibration itself.
+  void Calibrate(Calibration calibration) {
+    cached_read_latency_threshold_ = ComputeThreshold(calibration);
+  }
+
+  // One window of online recalibration, see `set_online_recalibration`.
+  struct ThresholdDriftSample {
+    // Reads measured by FindFirstCachedElementIndex* since recalibration was
+    // enabled, at the end of the window.
+    uint64_t reads;
+    // 90th percentile of the reads of the fast component in the window.
+    uint64_t hit_latency;
+    // 10th percentile of the (sampled) reads of the slow component.
+    uint64_t miss_latency;
+    // Threshold in effect after the window.
+    uint64_t threshold;
+  };
+
+  // Maximum number of windows kept in the drift history.
+  static const size_t kDriftHistoryLength = 256;
+
+  // When enabled, FindFirstCachedElementIndex* feed the latencies they measure
+  // into two streaming quantile estimators -- one for the fast component of
+  // the reads, one for a sample of the slow component -- and move the
+  // threshold along with them, so that it follows frequency and turbo changes
+  // during long runs. Setting the SAFESIDE_ONLINE_RECALIBRATION environment
+  // variable to anything but 0 enables it in every new TimingArray.
+  //
+  // A read belongs to the component whose streaming median is closer. That
+  // doesn't depend on the threshold, so hits are still tracked after they
+  // drifted past it. The first window records where the calibrated threshold
+  // sits between the two estimates; every later window places the threshold
+  // at the same relative position between the fresh estimates, smoothed
+  // against the previous threshold. Tracking a read takes constant time and
+  // memory; windows close after the probe pass that filled them.
+  void set_online_recalibration(bool enabled);
+
+  // Windows of online recalibration, oldest first. Holds at most
+  // `kDriftHistoryLength` entries; older windows are dropped. Empty while
+  // online recalibration is disabled.
+  std::vector<ThresholdDriftSample> threshold_drift_history() const;
+
  private:
   // Convenience so we don't have (*this)[i] everywhere.
   ValueType& ElementAt(size_t i) { return (*this)[i]; }
 
   uint64_t cached_read_latency_threshold_;
-  uint64_t FindCachedReadLatencyThreshold();
+  uint64_t ComputeThreshold(Calibration calibration);
+  uint64_t FindCachedReadLatencyThreshold(int iterations);
+
+  // State of online recalibration, null while it is disabled.
+  struct OnlineRecalibration;
+  std::unique_ptr<OnlineRecalibration> online_recalibration_;
+  // Feeds one measured read into online recalibration.
+  void TrackReadLatency(uint64_t read_latency);
+  // Moves the threshold if enough reads were tracked since the last window.
+  void CloseRecalibrationWindow();
+
+  // Feeds synthetic reads in timing_array_test.
+  friend class TimingArrayTestPeer;
 
   // Define a struct that occupies one full cache line. Some compilers may not
   // support aligning at `kCacheLineBytes`, which is almost always greater than
@@ -170,6 +245,9 @@ class TimingArray {
   // the stack guard page. This is more likely on PowerPC where the page size
   // (and therefore our element stride) is 64K.
   std::vector<Element> elements_{1 + kRealElements + 1};
+
+  // Address of every element in index order, for ProbeAll and FlushFromCache.
+  std::array<const void *, kRealElements> element_addresses_;
 };
 
 #endif  // DEMOS_TIMING_ARRAY_H_
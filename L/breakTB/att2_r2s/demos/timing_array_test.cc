@@ -9,16 +9,109 @@
 
 #include "timing_array.h"
 
+#include <chrono>
+#include <cstring>
 #include <iostream>
+#include <vector>
 
 #include "instr.h"
 #include "utils.h"
 
+// Feeds synthetic reads into online recalibration, as one probe pass each.
+class TimingArrayTestPeer {
+ public:
+  static void Read(TimingArray &ta, uint64_t read_latency) {
+    ta.TrackReadLatency(read_latency);
+    ta.CloseRecalibrationWindow();
+  }
+};
+
+namespace {
+
+// Returns how long `ta.Calibrate(calibration)` takes, in milliseconds.
+double CalibrationMilliseconds(TimingArray &ta,
+                               TimingArray::Calibration calibration) {
+  auto start = std::chrono::steady_clock::now();
+  ta.Calibrate(calibration);
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+// Compares a from-scratch calibration with one served by the calibration
+// cache, which the former has just populated.
+int ReportCalibrationStartup() {
+  TimingArray ta;
+
+  double cold = CalibrationMilliseconds(ta, TimingArray::Calibration::kFull);
+  uint64_t cold_threshold = ta.cached_read_latency_threshold();
+  double warm = CalibrationMilliseconds(ta, TimingArray::Calibration::kCached);
+  uint64_t warm_threshold = ta.cached_read_latency_threshold();
+
+  std::cout << "Cold calibration: " << cold << " ms, threshold "
+            << cold_threshold << std::endl;
+  std::cout << "Warm calibration: " << warm << " ms, threshold "
+            << warm_threshold << std::endl;
+  return 0;
+}
+
+// Feeds synthetic reads through online recalibration: one hit per 64 reads,
+// first well below the calibrated threshold, then drifted past it. The
+// threshold must follow the hits back above them, even though every drifted
+// hit is slower than the threshold in effect when it is read.
+bool OnlineRecalibrationFollowsDriftedHits() {
+  TimingArray ta;
+  ta.set_online_recalibration(true);
+  uint64_t threshold = ta.cached_read_latency_threshold();
+  uint64_t spread = threshold / 4 + 1;
+
+  auto feed = [&](int reads, uint64_t hit_latency) {
+    for (int i = 0; i < reads; ++i) {
+      TimingArrayTestPeer::Read(ta, i % 64 == 0
+                                        ? hit_latency + rand() % spread
+                                        : 3 * threshold + rand() % spread);
+    }
+  };
+  feed(1 << 16, threshold / 4);
+  uint64_t drifted_hit = threshold + threshold / 4;
+  feed(1 << 20, drifted_hit);
+
+  uint64_t followed = ta.cached_read_latency_threshold();
+  std::vector<TimingArray::ThresholdDriftSample> history =
+      ta.threshold_drift_history();
+  bool ordered = true;
+  for (size_t i = 1; i < history.size(); ++i) {
+    ordered = ordered && history[i - 1].reads < history[i].reads;
+  }
+  std::cout << "Threshold after drift: " << threshold << " -> " << followed
+            << std::endl;
+  return followed >= drifted_hit + spread && followed < 3 * threshold &&
+         !history.empty() &&
+         history.size() <= TimingArray::kDriftHistoryLength && ordered &&
+         history.back().reads <= (1 << 16) + (1 << 20);
+}
+
+}  // namespace
+
 // Measure how often TimingArray is able to accurately determine which element
 // was read into cache and how often it positively identifies the *wrong*
 // element.
+//
+// With --calibration, instead reports cold- vs. warm-start calibration time.
+// With --online, runs with online recalibration and prints the drift history.
 int main(int argc, char* argv[]) {
+  if (argc > 1 && strcmp(argv[1], "--calibration") == 0) {
+    return ReportCalibrationStartup();
+  }
+  bool online = argc > 1 && strcmp(argv[1], "--online") == 0;
+
+  if (!OnlineRecalibrationFollowsDriftedHits()) {
+    std::cout << "Online recalibration didn't follow drifted hits"
+              << std::endl;
+    return 1;
+  }
+
   TimingArray ta;
+  ta.set_online_recalibration(online);
 
   std::cout << "Cached read latency threshold is "
             << ta.cached_read_latency_threshold() << std::endl;
@@ -56,6 +149,13 @@ int main(int argc, char* argv[]) {
             << successes << " of " << attempts << " times." << std::endl;
   std::cout << "False positives: " << false_positives << std::endl;
 
+  for (const TimingArray::ThresholdDriftSample &sample :
+       ta.threshold_drift_history()) {
+    std::cout << "After " << sample.reads << " reads: hit "
+              << sample.hit_latency << ", miss " << sample.miss_latency
+              << ", threshold " << sample.threshold << std::endl;
+  }
+
   // Expect most attempts to succeed and very few false positives.
   bool pass =
       successes > (attempts * 0.85) && false_positives < (attempts * 0.05);
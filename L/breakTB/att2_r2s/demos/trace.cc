@@ -0,0 +1,261 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "compiler_specifics.h"
+#include "instr.h"
+#include "timer_backend.h"
+
+namespace {
+
+struct Event {
+  uint64_t timestamp;
+  TracePhase phase;
+  bool begin;
+};
+
+// Events of one thread. Only that thread writes; readers copy the events and
+// drop those the writer may have overwritten while they copied.
+class Buffer {
+ public:
+  explicit Buffer(size_t thread)
+      : thread_(thread), events_(kTraceBufferEvents) {}
+
+  size_t thread() const { return thread_; }
+
+  void Record(TracePhase phase, bool begin) {
+    uint64_t recorded = recorded_.load(std::memory_order_relaxed);
+    events_[recorded % kTraceBufferEvents] = {TraceNow(), phase, begin};
+    recorded_.store(recorded + 1, std::memory_order_release);
+  }
+
+  // The events still in the buffer, oldest first.
+  std::vector<Event> Snapshot() const {
+    uint64_t end = recorded_.load(std::memory_order_acquire);
+    uint64_t begin = end > kTraceBufferEvents ? end - kTraceBufferEvents : 0;
+    std::vector<Event> events;
+    for (uint64_t i = begin; i < end; ++i) {
+      events.push_back(events_[i % kTraceBufferEvents]);
+    }
+    uint64_t now = recorded_.load(std::memory_order_acquire);
+    uint64_t overwritten =
+        now > kTraceBufferEvents ? now - kTraceBufferEvents : 0;
+    if (overwritten > begin) {
+      events.erase(events.begin(),
+                   events.begin() + std::min<uint64_t>(overwritten - begin,
+                                                       events.size()));
+    }
+    return events;
+  }
+
+  // The phase begun by the last TraceMark, unless it has been ended.
+  bool marked = false;
+  TracePhase marked_phase = TracePhase::kTrain;
+
+ private:
+  size_t thread_;
+  std::vector<Event> events_;
+  std::atomic<uint64_t> recorded_{0};
+};
+
+// A TraceNow timestamp and the steady_clock time it was taken at, to convert
+// timestamps to nanoseconds.
+struct TimeReference {
+  uint64_t timestamp;
+  std::chrono::steady_clock::time_point time;
+
+  static TimeReference Now() {
+    return {TraceNow(), std::chrono::steady_clock::now()};
+  }
+};
+
+std::mutex buffers_mutex;
+
+// Buffers of all threads that ever recorded, kept after the threads exit.
+std::vector<std::unique_ptr<Buffer>> &Buffers() {
+  static std::vector<std::unique_ptr<Buffer>> buffers;
+  return buffers;
+}
+
+// Taken when the first buffer is created.
+TimeReference first_reference;
+
+thread_local Buffer *thread_buffer = nullptr;
+
+Buffer &ThreadBuffer() {
+  if (thread_buffer == nullptr) {
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    if (Buffers().empty()) {
+      first_reference = TimeReference::Now();
+    }
+    Buffers().emplace_back(new Buffer(Buffers().size()));
+    thread_buffer = Buffers().back().get();
+  }
+  return *thread_buffer;
+}
+
+// TraceNow ticks per nanosecond since the first buffer was created. Waits
+// until 10 ms have passed since then, so that the ratio is precise enough.
+double TicksPerNanosecond() {
+  TimeReference now;
+  do {
+    now = TimeReference::Now();
+  } while (now.time - first_reference.time < std::chrono::milliseconds(10));
+  std::chrono::duration<double, std::nano> elapsed =
+      now.time - first_reference.time;
+  return (now.timestamp - first_reference.timestamp) / elapsed.count();
+}
+
+struct Span {
+  size_t thread;
+  TracePhase phase;
+  uint64_t begin;
+  uint64_t end;
+};
+
+// Pairs the begin and end events of every thread. Ends whose begin was
+// overwritten and begins that haven't ended are dropped.
+std::vector<Span> CollectSpans() {
+  std::lock_guard<std::mutex> lock(buffers_mutex);
+  std::vector<Span> spans;
+  for (const std::unique_ptr<Buffer> &buffer : Buffers()) {
+    std::vector<Event> open;
+    for (const Event &event : buffer->Snapshot()) {
+      if (event.begin) {
+        open.push_back(event);
+        continue;
+      }
+      auto match = std::find_if(
+          open.rbegin(), open.rend(),
+          [&](const Event &begin) { return begin.phase == event.phase; });
+      if (match == open.rend()) {
+        continue;
+      }
+      spans.push_back(
+          {buffer->thread(), event.phase, match->timestamp, event.timestamp});
+      // Spans begun within this one and never ended are dropped with it.
+      open.erase(std::prev(match.base()), open.end());
+    }
+  }
+  return spans;
+}
+
+}  // namespace
+
+const char *TracePhaseName(TracePhase phase) {
+  switch (phase) {
+    case TracePhase::kTrain:
+      return "train";
+    case TracePhase::kTrigger:
+      return "trigger";
+    case TracePhase::kProbe:
+      return "probe";
+    case TracePhase::kRun:
+      return "run";
+    case TracePhase::kFlush:
+      return "flush";
+    case TracePhase::kMeasure:
+      return "measure";
+    case TracePhase::kScore:
+      return "score";
+  }
+  return "unknown";
+}
+
+uint64_t TraceNow() {
+#if SAFESIDE_X64 || SAFESIDE_IA32
+  return __rdtsc();
+#else
+  return NativeTimerBackend().Now();
+#endif
+}
+
+void TraceBegin(TracePhase phase) {
+  ThreadBuffer().Record(phase, true);
+}
+
+void TraceEnd(TracePhase phase) {
+  ThreadBuffer().Record(phase, false);
+}
+
+void TraceMark(TracePhase phase) {
+  Buffer &buffer = ThreadBuffer();
+  if (buffer.marked) {
+    buffer.Record(buffer.marked_phase, false);
+  }
+  buffer.Record(phase, true);
+  buffer.marked = true;
+  buffer.marked_phase = phase;
+}
+
+void TraceStopMarks() {
+  Buffer &buffer = ThreadBuffer();
+  if (buffer.marked) {
+    buffer.Record(buffer.marked_phase, false);
+    buffer.marked = false;
+  }
+}
+
+std::array<TracePhaseStats, kTracePhases> TraceStats(uint64_t start,
+                                                      uint64_t end) {
+  std::array<TracePhaseStats, kTracePhases> stats;
+  std::vector<Span> spans = CollectSpans();
+  if (spans.empty()) {
+    return stats;
+  }
+  double ticks_per_ns = TicksPerNanosecond();
+  for (const Span &span : spans) {
+    if (span.begin < start || span.end >= end) {
+      continue;
+    }
+    double ns = (span.end - span.begin) / ticks_per_ns;
+    TracePhaseStats &phase = stats[static_cast<size_t>(span.phase)];
+    phase.min_ns = phase.count == 0 ? ns : std::min(phase.min_ns, ns);
+    phase.max_ns = std::max(phase.max_ns, ns);
+    phase.total_ns += ns;
+    ++phase.count;
+  }
+  return stats;
+}
+
+void WriteChromeTrace(std::ostream &out) {
+  std::vector<Span> spans = CollectSpans();
+  double ticks_per_us = spans.empty() ? 1 : TicksPerNanosecond() * 1000;
+  uint64_t origin = UINT64_MAX;
+  for (const Span &span : spans) {
+    origin = std::min(origin, span.begin);
+  }
+
+  // Complete ("X") events with timestamps and durations in microseconds.
+  out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+  std::ios::fmtflags flags = out.flags();
+  std::streamsize precision = out.precision();
+  out << std::fixed << std::setprecision(3);
+  for (size_t i = 0; i < spans.size(); ++i) {
+    const Span &span = spans[i];
+    out << (i == 0 ? "\n" : ",\n") << "{\"name\": \""
+        << TracePhaseName(span.phase) << "\", \"ph\": \"X\", \"pid\": 0, "
+        << "\"tid\": " << span.thread
+        << ", \"ts\": " << (span.begin - origin) / ticks_per_us
+        << ", \"dur\": " << (span.end - span.begin) / ticks_per_us << "}";
+  }
+  out.flags(flags);
+  out.precision(precision);
+  out << "\n]}\n";
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#ifndef DEMOS_TRACE_H_
+#define DEMOS_TRACE_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// Trace points in the support library and the experiment loops, showing where
+// each run spends its time. Configure with -DSAFESIDE_TRACE=ON to record them;
+// otherwise the SAFESIDE_TRACE_* macros expand to nothing and the traced code
+// compiles exactly as without them.
+//
+// Every thread records into a ring buffer of its own, with no lock and no
+// atomic read-modify-write. A buffer keeps the last kTraceBufferEvents events
+// of its thread.
+#ifndef SAFESIDE_TRACE
+#  define SAFESIDE_TRACE 0
+#endif
+
+constexpr bool kTraceEnabled = SAFESIDE_TRACE;
+constexpr size_t kTraceBufferEvents = size_t{1} << 16;
+
+enum class TracePhase : uint8_t {
+  // The ExperimentPhases marked by the demos, in the same order.
+  kTrain,
+  kTrigger,
+  kProbe,
+  // One run of RunExperiment.
+  kRun,
+  // Flushing the oracle or the timing array.
+  kFlush,
+  // Measuring the read latencies of the oracle.
+  kMeasure,
+  // Scoring the latencies and deciding whether the byte converged.
+  kScore,
+};
+
+constexpr size_t kTracePhases = 7;
+
+// "train", "trigger", "probe", "run", "flush", "measure" or "score".
+const char *TracePhaseName(TracePhase phase);
+
+// Timestamp of the trace events: the TSC on x86, the native timer elsewhere.
+uint64_t TraceNow();
+
+// Records the begin or end of `phase` on the calling thread.
+void TraceBegin(TracePhase phase);
+void TraceEnd(TracePhase phase);
+// Ends the phase begun by the last TraceMark on the calling thread, if it
+// hasn't been stopped, and begins `phase`.
+void TraceMark(TracePhase phase);
+// Ends the phase begun by the last TraceMark, if any.
+void TraceStopMarks();
+
+// Records `phase` for the lifetime of the span.
+class TraceSpan {
+ public:
+  explicit TraceSpan(TracePhase phase) : phase_(phase) { TraceBegin(phase); }
+  ~TraceSpan() { TraceEnd(phase_); }
+
+  TraceSpan(const TraceSpan &) = delete;
+  TraceSpan &operator=(const TraceSpan &) = delete;
+
+ private:
+  TracePhase phase_;
+};
+
+#if SAFESIDE_TRACE
+#  define SAFESIDE_TRACE_CONCAT_(a, b) a##b
+#  define SAFESIDE_TRACE_CONCAT(a, b) SAFESIDE_TRACE_CONCAT_(a, b)
+#  define SAFESIDE_TRACE_SPAN(phase) \
+  TraceSpan SAFESIDE_TRACE_CONCAT(trace_span_, __LINE__)(phase)
+#  define SAFESIDE_TRACE_BEGIN(phase) TraceBegin(phase)
+#  define SAFESIDE_TRACE_END(phase) TraceEnd(phase)
+#  define SAFESIDE_TRACE_MARK(phase) TraceMark(phase)
+#  define SAFESIDE_TRACE_STOP_MARKS() TraceStopMarks()
+#else
+#  define SAFESIDE_TRACE_SPAN(phase) static_cast<void>(0)
+#  define SAFESIDE_TRACE_BEGIN(phase) static_cast<void>(0)
+#  define SAFESIDE_TRACE_END(phase) static_cast<void>(0)
+#  define SAFESIDE_TRACE_MARK(phase) static_cast<void>(0)
+#  define SAFESIDE_TRACE_STOP_MARKS() static_cast<void>(0)
+#endif
+
+// Durations of the spans of one phase.
+struct TracePhaseStats {
+  uint64_t count = 0;
+  double total_ns = 0;
+  double min_ns = 0;
+  double max_ns = 0;
+
+  double mean_ns() const { return count == 0 ? 0 : total_ns / count; }
+};
+
+// Statistics of the spans of every phase, over all threads, that begin at
+// or after the TraceNow timestamp `start` and end before `end`. Spans nest,
+// e.g. "measure" and "score" within "probe", and each counts in full for its
+// own phase. Spans that were overwritten in the ring buffer are missing.
+std::array<TracePhaseStats, kTracePhases> TraceStats(
+    uint64_t start = 0, uint64_t end = UINT64_MAX);
+
+// Writes every span still in the buffers as Chrome trace event JSON, for
+// chrome://tracing or Perfetto. Events recorded while the buffers are read
+// may be missing.
+void WriteChromeTrace(std::ostream &out);
+
+#endif  // DEMOS_TRACE_H_
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#include "trace.h"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace {
+
+int failures = 0;
+
+void Expect(bool condition, const char *what) {
+  if (!condition) {
+    std::cout << "Failed: " << what << std::endl;
+    ++failures;
+  }
+}
+
+size_t Count(const std::string &text, const std::string &pattern) {
+  size_t count = 0;
+  for (size_t at = text.find(pattern); at != std::string::npos;
+       at = text.find(pattern, at + 1)) {
+    ++count;
+  }
+  return count;
+}
+
+}  // namespace
+
+// Records through the functions behind the SAFESIDE_TRACE_* macros, so that
+// it tests the same in builds with and without SAFESIDE_TRACE. Checks that
+// marks and spans pair up into the expected spans, that threads record
+// separately and that a wrapped-around buffer keeps only whole spans.
+int main(int argc, char* argv[]) {
+  uint64_t start = TraceNow();
+  for (int run = 0; run < 10; ++run) {
+    TraceSpan span(TracePhase::kRun);
+    TraceMark(TracePhase::kTrain);
+    TraceMark(TracePhase::kProbe);
+    {
+      TraceSpan measure(TracePhase::kMeasure);
+    }
+    TraceStopMarks();
+  }
+  std::thread([] { TraceSpan span(TracePhase::kFlush); }).join();
+  // Begun but never ended.
+  TraceBegin(TracePhase::kScore);
+  uint64_t end = TraceNow();
+
+  std::array<TracePhaseStats, kTracePhases> stats = TraceStats(start, end);
+  Expect(stats[static_cast<size_t>(TracePhase::kRun)].count == 10, "runs");
+  Expect(stats[static_cast<size_t>(TracePhase::kTrain)].count == 10,
+         "marked phases");
+  Expect(stats[static_cast<size_t>(TracePhase::kProbe)].count == 10,
+         "stopped phases");
+  Expect(stats[static_cast<size_t>(TracePhase::kMeasure)].count == 10,
+         "spans within marked phases");
+  Expect(stats[static_cast<size_t>(TracePhase::kFlush)].count == 1,
+         "spans of other threads");
+  Expect(stats[static_cast<size_t>(TracePhase::kScore)].count == 0,
+         "unended spans");
+  const TracePhaseStats &run = stats[static_cast<size_t>(TracePhase::kRun)];
+  Expect(run.min_ns <= run.mean_ns() && run.mean_ns() <= run.max_ns,
+         "run statistics");
+  TraceEnd(TracePhase::kScore);
+
+  std::ostringstream chrome;
+  WriteChromeTrace(chrome);
+  Expect(Count(chrome.str(), "\"name\": \"run\"") == 10, "Chrome trace runs");
+  Expect(Count(chrome.str(), "\"tid\": 1") == 1, "Chrome trace threads");
+
+  // Wraps around the buffer, overwriting the begin of the first span.
+  TraceBegin(TracePhase::kRun);
+  for (size_t i = 0; i < kTraceBufferEvents; ++i) {
+    TraceSpan span(TracePhase::kFlush);
+  }
+  TraceEnd(TracePhase::kRun);
+  stats = TraceStats();
+  Expect(stats[static_cast<size_t>(TracePhase::kRun)].count == 0,
+         "span whose begin was overwritten");
+  // The buffer keeps the end of the run and the flush events before it,
+  // starting with an end: kTraceBufferEvents / 2 - 1 spans. The flush span of
+  // the other thread is still in its own buffer.
+  Expect(stats[static_cast<size_t>(TracePhase::kFlush)].count ==
+             (kTraceBufferEvents / 2 - 1) + 1,
+         "spans in a full buffer");
+
+  bool pass = failures == 0;
+  std::cout << (pass ? "pass" : "fail") << std::endl;
+  return !pass;
+}
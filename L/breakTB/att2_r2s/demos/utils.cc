@@ -10,6 +10,7 @@
 
 #include "utils.h"
 
+#include <array>
 #include <cstddef>
 #include <iostream>
 #if SAFESIDE_LINUX
@@ -37,9 +38,19 @@ const void* StartOfNextCacheLine(const void* addr) {
 }  // namespace
 
 void FlushFromDataCache(const void *begin, const void *end) {
+  // Hand the lines to FlushLinesNoBarrier in batches, so that on CPUs with
+  // CLFLUSHOPT they are all in flight together.
+  const size_t kBatch = 64;
+  std::array<const void *, kBatch> lines;
+  size_t count = 0;
   for (; begin < end; begin = StartOfNextCacheLine(begin)) {
-    FlushDataCacheLineNoBarrier(begin);
+    lines[count++] = begin;
+    if (count == kBatch) {
+      FlushLinesNoBarrier(lines.data(), count);
+      count = 0;
+    }
   }
+  FlushLinesNoBarrier(lines.data(), count);
   MemoryAndSpeculationBarrier();
 }
 
@@ -61,9 +72,19 @@ void ExtendSpeculationWindow() {
 
 #if SAFESIDE_LINUX
 void PinToTheFirstCore() {
+  // The first core the process may run on. That is CPU 0 unless a scheduler
+  // such as safeside_runner already restricted the process to other cores.
+  cpu_set_t allowed;
+  int first = 0;
+  if (sched_getaffinity(getpid(), sizeof(allowed), &allowed) == 0) {
+    while (first < CPU_SETSIZE - 1 && !CPU_ISSET(first, &allowed)) {
+      ++first;
+    }
+  }
+
   cpu_set_t set;
   CPU_ZERO(&set);
-  CPU_SET(0, &set);
+  CPU_SET(first, &set);
   int res = sched_setaffinity(getpid(), sizeof(set), &set);
   if (res != 0) {
     std::cout << "CPU affinity setup failed." << std::endl;
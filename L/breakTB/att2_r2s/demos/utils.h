@@ -25,6 +25,8 @@ void ForceRead(const void *p) {
 // flushed values until they are fetched back to the cache.
 void FlushFromDataCache(const void *start, const void *end);
 #if SAFESIDE_LINUX
+// Pins the process to the first CPU of its current affinity mask, i.e. CPU 0
+// when it isn't restricted.
 void PinToTheFirstCore();
 #endif
 
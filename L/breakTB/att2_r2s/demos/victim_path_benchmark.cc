@@ -0,0 +1,22 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+// Measures the architectural cost of the code paths the demos attack (see
+// victim_paths.h), so that builds with different compiler mitigations can be
+// compared. Prints "<path> <native timer ticks per call>" per line.
+
+#include <iostream>
+
+#include "victim_paths.h"
+
+int main() {
+  for (const VictimPath &path : VictimPaths()) {
+    std::cout << path.name << " " << path.ticks_per_call() << std::endl;
+  }
+}
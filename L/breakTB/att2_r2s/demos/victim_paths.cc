@@ -0,0 +1,114 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#include "victim_paths.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#include "btb_experiment.h"
+// ret2spec_common.h relies on these.
+#include "cache_sidechannel.h"
+#include "experiment.h"
+#include "ret2spec_common.h"
+#include "timer_backend.h"
+
+namespace {
+
+constexpr int kSamples = 101;
+constexpr size_t kCallsPerSample = 4096;
+
+const char *accessor_public_data = "xxxxxxxxxxxxxxxx";
+const char *accessor_private_data = "It's a s3kr3t!!!";
+const LeakTarget accessor_target = {accessor_public_data,
+                                    accessor_private_data};
+
+volatile char sink;
+
+template <typename Sample>
+double MedianTicksPerCall(size_t calls, Sample sample) {
+  const TimerBackend &timer = NativeTimerBackend();
+  std::vector<double> ticks;
+  for (int i = 0; i < kSamples; ++i) {
+    uint64_t start = timer.Now();
+    sample();
+    ticks.push_back(static_cast<double>(timer.Now() - start) / calls);
+  }
+  std::nth_element(ticks.begin(), ticks.begin() + kSamples / 2, ticks.end());
+  return ticks[kSamples / 2];
+}
+
+double VirtualCall() {
+  // Mostly real accessors with the odd censoring one, so that the call stays
+  // indirect and well predicted, like in the victim loops.
+  RealDataAccessor<accessor_target> real_accessor;
+  CensoringDataAccessor<accessor_target> censoring_accessor;
+  std::vector<DataAccessor *> accessors(kCallsPerSample, &real_accessor);
+  accessors[kCallsPerSample / 2] = &censoring_accessor;
+
+  return MedianTicksPerCall(kCallsPerSample, [&] {
+    char value = 0;
+    for (size_t i = 0; i < kCallsPerSample; ++i) {
+      value ^=
+          accessors[i]->GetDataByte(i % strlen(accessor_public_data), false);
+    }
+    sink = value;
+  });
+}
+
+void Nop() {}
+
+double Recursion() {
+  void (*saved_base_case)() = return_true_base_case;
+  return_true_base_case = Nop;
+  constexpr int kRecursions = 16;
+  double ticks = MedianTicksPerCall(kRecursions * (recursion_depth + 1), [] {
+    for (int i = 0; i < kRecursions; ++i) {
+      ReturnsFalse(recursion_depth);
+    }
+  });
+  return_true_base_case = saved_base_case;
+  return ticks;
+}
+
+double StoreLoad() {
+  constexpr size_t kArrayLength = 64;
+  std::array<size_t *, kArrayLength> pointers;
+  size_t junk, local_offset;
+  const char *data = accessor_public_data;
+  size_t length = strlen(data);
+
+  return MedianTicksPerCall(kCallsPerSample, [&] {
+    char value = 0;
+    for (size_t n = 0; n < kCallsPerSample / kArrayLength; ++n) {
+      pointers.fill(&junk);
+      size_t local_pointer_index = n % kArrayLength;
+      pointers[local_pointer_index] = &local_offset;
+      for (size_t i = 0; i < kArrayLength; ++i) {
+        local_offset = length - 1;
+        // The store that the load of local_offset below must wait for.
+        pointers[i][0] = n % length;
+        value ^= data[local_offset];
+      }
+    }
+    sink = value;
+  });
+}
+
+}  // namespace
+
+const std::vector<VictimPath> &VictimPaths() {
+  static const std::vector<VictimPath> paths = {
+      {"virtual_call", "spectre_v1_btb_sa", VirtualCall},
+      {"recursion", "ret2spec_ca", Recursion},
+      {"store_load", "spectre_v4", StoreLoad},
+  };
+  return paths;
+}
@@ -0,0 +1,34 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under both the 3-Clause BSD License and the GPLv2, found in the
+ * LICENSE and LICENSE.GPL-2.0 files, respectively, in the root directory.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+ */
+
+#ifndef DEMOS_VICTIM_PATHS_H_
+#define DEMOS_VICTIM_PATHS_H_
+
+#include <vector>
+
+// The code paths the demos attack, stripped of flushing and side-channel
+// work, timed architecturally. Used to compare what compiler and runtime
+// mitigations cost on exactly these paths.
+struct VictimPath {
+  // virtual_call: a DataAccessor::GetDataByte call through a base pointer,
+  //   as in spectre_v1_btb_sa and spectre_v1_btb_ca.
+  // recursion: one call and return of the ReturnsFalse recursion of the
+  //   ret2spec demos.
+  // store_load: a store through a pointer followed by a load of the stored
+  //   offset, as in spectre_v4.
+  const char *name;
+  // Name of the registered demo that attacks this path.
+  const char *demo;
+  // Median native timer ticks per call.
+  double (*ticks_per_call)();
+};
+
+const std::vector<VictimPath> &VictimPaths();
+
+#endif  // DEMOS_VICTIM_PATHS_H_
